@@ -0,0 +1,202 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "raytracer.h"
+#include "parallel.h"
+
+// Rays/sec of the BVH against the linear sphere_list_hit_any loop
+// on random sphere clouds of increasing size, then the cost of keeping a
+// scene's dynamic objects' tree up to date each frame by refitting against
+// rebuilding the whole scene
+
+#define BVH_RAYS 200000
+#define LINEAR_WORK 30000000.0   // Ray-sphere tests budget for the linear loop
+#define VERIFY_RAYS 2000
+#define REFIT_STATIC 100000
+#define REFIT_FRAMES 20
+
+static uint32_t bench_rng = 0x12345678u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Scene* make_scene(int count, float* extent) {
+    Scene* scene = scene_create();
+    scene_add_material(scene, material_diffuse(vec3_new(0.5f, 0.5f, 0.5f)));
+    
+    // Keep the density constant as the count grows
+    *extent = cbrtf((float)count) * 2.0f;
+    for (int i = 0; i < count; i++) {
+        Vec3 c = vec3_new((bench_random() - 0.5f) * *extent,
+                          (bench_random() - 0.5f) * *extent,
+                          (bench_random() - 0.5f) * *extent);
+        scene_add_object(scene, sphere_create(c, 0.2f + bench_random() * 0.4f, 0));
+    }
+    return scene;
+}
+
+static Ray* make_rays(int count, float extent) {
+    Ray* rays = (Ray*)malloc(count * sizeof(Ray));
+    for (int i = 0; i < count; i++) {
+        Vec3 origin = vec3_mul(vec3_normalize(vec3_new(bench_random() - 0.5f, bench_random() - 0.5f, bench_random() - 0.5f)), extent);
+        Vec3 target = vec3_new((bench_random() - 0.5f) * extent,
+                               (bench_random() - 0.5f) * extent,
+                               (bench_random() - 0.5f) * extent);
+        rays[i] = ray_create(origin, vec3_sub(target, origin));
+    }
+    return rays;
+}
+
+// The closer of the linear hits on both lists, as scene_hit should find
+static int linear_scene_hit(Scene* scene, Ray ray, RayHit* hit) {
+    RayHit dynamic_hit;
+    int hit_static = sphere_list_hit_any(scene->scene, ray, 0.001f, 1e6f, hit);
+    float t_max = hit_static ? hit->t : 1e6f;
+    if (sphere_list_hit_any(scene->dynamic, ray, 0.001f, t_max, &dynamic_hit)) {
+        *hit = dynamic_hit;
+        return 1;
+    }
+    return hit_static;
+}
+
+// Move every dynamic object a little, as a frame of game movement would
+static void jitter_dynamic(Scene* scene) {
+    for (int i = 0; i < scene->dynamic->count; i++) {
+        Sphere sphere = scene->dynamic->spheres[i];
+        sphere.center = vec3_add(sphere.center, vec3_new((bench_random() - 0.5f) * 0.2f,
+                                                         (bench_random() - 0.5f) * 0.2f,
+                                                         (bench_random() - 0.5f) * 0.2f));
+        scene_set_dynamic(scene, i, sphere);
+    }
+}
+
+// Refitting should cost in proportion to the dynamic objects only, where a
+// rebuild pays for the static ones again every frame
+static int bench_refit() {
+    int dynamic_counts[] = {100, 1000, 10000};
+    int failures = 0;
+    
+    printf("\n%d static spheres, %d frames of moving dynamic ones\n", REFIT_STATIC, REFIT_FRAMES);
+    printf("%-8s %10s %12s %9s %7s\n", "dynamic", "refit ms", "rebuild ms", "speedup", "builds");
+    
+    for (int d = 0; d < (int)(sizeof(dynamic_counts) / sizeof(dynamic_counts[0])); d++) {
+        int count = dynamic_counts[d];
+        float extent;
+        Scene* scene = make_scene(REFIT_STATIC, &extent);
+        scene_build_bvh(scene);
+        for (int i = 0; i < count; i++) {
+            Vec3 c = vec3_new((bench_random() - 0.5f) * extent,
+                              (bench_random() - 0.5f) * extent,
+                              (bench_random() - 0.5f) * extent);
+            scene_add_dynamic(scene, sphere_create(c, 0.2f + bench_random() * 0.4f, 0));
+        }
+        scene_refit(scene);
+        int builds = scene->dynamic_builds;
+        
+        double refit_time = 0.0, rebuild_time = 0.0;
+        for (int f = 0; f < REFIT_FRAMES; f++) {
+            jitter_dynamic(scene);
+            double t0 = now_seconds();
+            scene_refit(scene);
+            refit_time += now_seconds() - t0;
+            
+            // What the frame would cost with everything in one rebuilt tree
+            t0 = now_seconds();
+            BVH* all = bvh_build(scene->scene, 1);
+            BVH* moving = bvh_build(scene->dynamic, 1);
+            rebuild_time += now_seconds() - t0;
+            bvh_free(all);
+            bvh_free(moving);
+        }
+        
+        // The refit trees must still find the closest hit
+        Ray* rays = make_rays(VERIFY_RAYS / 10, extent);
+        for (int i = 0; i < VERIFY_RAYS / 10; i++) {
+            RayHit a = {0}, b = {0};
+            int ha = linear_scene_hit(scene, rays[i], &a);
+            int hb = scene_hit(scene, rays[i], 0.001f, 1e6f, &b);
+            if (ha != hb || (ha && a.t != b.t)) failures++;
+        }
+        
+        printf("%-8d %10.3f %12.3f %8.1fx %7d\n", count, refit_time * 1000.0 / REFIT_FRAMES,
+               rebuild_time * 1000.0 / REFIT_FRAMES, rebuild_time / refit_time, scene->dynamic_builds - builds);
+        
+        free(rays);
+        scene_free(scene);
+    }
+    
+    if (failures) printf("Refit scene and linear hits disagree on %d rays\n", failures);
+    return failures;
+}
+
+int main() {
+    int sizes[] = {1000, 10000, 100000};
+    int failures = 0;
+    
+    printf("%-8s %10s %14s %14s %9s\n", "spheres", "build ms", "linear rays/s", "bvh rays/s", "speedup");
+    
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        int count = sizes[s];
+        float extent;
+        Scene* scene = make_scene(count, &extent);
+        Ray* rays = make_rays(BVH_RAYS, extent);
+        
+        double t0 = now_seconds();
+        BVH* bvh = bvh_build(scene->scene, parallel_cpu_count());
+        double build_time = now_seconds() - t0;
+        
+        int linear_rays = (int)(LINEAR_WORK / count);
+        if (linear_rays > BVH_RAYS) linear_rays = BVH_RAYS;
+        
+        float checksum = 0.0f;
+        RayHit hit;
+        t0 = now_seconds();
+        for (int i = 0; i < linear_rays; i++) {
+            if (sphere_list_hit_any(scene->scene, rays[i], 0.001f, 1e6f, &hit)) checksum += hit.t;
+        }
+        double linear_time = now_seconds() - t0;
+        
+        t0 = now_seconds();
+        for (int i = 0; i < BVH_RAYS; i++) {
+            if (bvh_hit(bvh, scene->scene, rays[i], 0.001f, 1e6f, &hit)) checksum += hit.t;
+        }
+        double bvh_time = now_seconds() - t0;
+        
+        // Both paths must agree on the closest hit
+        int verify = linear_rays < VERIFY_RAYS ? linear_rays : VERIFY_RAYS;
+        for (int i = 0; i < verify; i++) {
+            RayHit a = {0}, b = {0};
+            int ha = sphere_list_hit_any(scene->scene, rays[i], 0.001f, 1e6f, &a);
+            int hb = bvh_hit(bvh, scene->scene, rays[i], 0.001f, 1e6f, &b);
+            if (ha != hb || (ha && a.t != b.t)) failures++;
+        }
+        
+        double linear_rate = linear_rays / linear_time;
+        double bvh_rate = BVH_RAYS / bvh_time;
+        printf("%-8d %10.2f %14.0f %14.0f %8.1fx   (checksum %.1f)\n",
+               count, build_time * 1000.0, linear_rate, bvh_rate, bvh_rate / linear_rate, checksum);
+        
+        bvh_free(bvh);
+        free(rays);
+        scene_free(scene);
+    }
+    
+    if (failures) {
+        printf("BVH and linear hits disagree on %d rays\n", failures);
+        return 1;
+    }
+    return bench_refit() ? 1 : 0;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bench_scene.h"
+#include "parallel.h"
+#include "timer.h"
+
+// Low spp renders denoised against raw renders at higher spp, all measured
+// against a high spp reference: denoised, N spp should be as good as 4N spp
+// raw. Scrambled Sobol renders are far less noisy raw at 4N spp, so for
+// them denoised N spp is held to 2N spp raw. Then the filter's speed on a
+// 1080p frame:
+// one pixel at a time on one thread, SIMD on one thread and SIMD on every
+// CPU. The SIMD filter must give the scalar one's results.
+
+#define WIDTH 128
+#define HEIGHT 96
+#define REFERENCE_SPP 256
+#define BIG_WIDTH 1920
+#define BIG_HEIGHT 1080
+#define TIMING_RUNS 2
+
+// Raw noise at each spp, then what denoising makes of it
+static void measure(Scene* scene, Camera* camera, Image* image, Image* reference, DenoiseGuide* guide,
+                    Denoiser* denoiser, RenderSettings* settings, const int* spps, int count,
+                    double* raw_error, double* denoised_error) {
+    for (int s = 0; s < count; s++) {
+        settings->spp = spps[s];
+        render_scene(scene, camera, image, settings, NULL);
+        raw_error[s] = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+        DenoiseSettings denoise = denoise_settings_default(spps[s], settings->low_discrepancy);
+        denoise_image(denoiser, image, guide, &denoise);
+        denoised_error[s] = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+        printf("%3d spp %-11s raw rms %.5f  denoised rms %.5f\n", spps[s],
+               settings->low_discrepancy ? "Sobol" : "independent", raw_error[s], denoised_error[s]);
+    }
+}
+
+// The small render and its guide repeated over the big frame, for timing
+static void tile_up(Image* small, DenoiseGuide* small_guide, Image* big, DenoiseGuide* big_guide) {
+    for (int y = 0; y < BIG_HEIGHT; y++) {
+        for (int x = 0; x < BIG_WIDTH; x++) {
+            int i = y * BIG_WIDTH + x;
+            int j = (y % HEIGHT) * WIDTH + x % WIDTH;
+            big->pixels[i] = small->pixels[j];
+            big_guide->albedo_r[i] = small_guide->albedo_r[j];
+            big_guide->albedo_g[i] = small_guide->albedo_g[j];
+            big_guide->albedo_b[i] = small_guide->albedo_b[j];
+            big_guide->normal_x[i] = small_guide->normal_x[j];
+            big_guide->normal_y[i] = small_guide->normal_y[j];
+            big_guide->normal_z[i] = small_guide->normal_z[j];
+            big_guide->depth[i] = small_guide->depth[j];
+        }
+    }
+}
+
+static double time_denoise(Denoiser* denoiser, Image* source, Image* out, DenoiseGuide* guide,
+                           DenoiseSettings* settings, int scalar) {
+    double best = 1e9;
+    for (int run = 0; run < TIMING_RUNS; run++) {
+        memcpy(out->pixels, source->pixels, (size_t)source->width * source->height * sizeof(Color));
+        double start = timer_seconds();
+        if (scalar) {
+            denoise_image_scalar(denoiser, out, guide, settings);
+        } else {
+            denoise_image(denoiser, out, guide, settings);
+        }
+        double t = timer_seconds() - start;
+        if (t < best) best = t;
+    }
+    return best;
+}
+
+int main() {
+    Scene* scene = bench_scene_create();
+    Camera camera = bench_scene_camera(0.0f, WIDTH, HEIGHT);
+    Image* reference = image_create(WIDTH, HEIGHT);
+    Image* image = image_create(WIDTH, HEIGHT);
+    DenoiseGuide* guide = denoise_guide_create(WIDTH, HEIGHT);
+    Denoiser* denoiser = denoiser_create(WIDTH, HEIGHT);
+    RenderSettings settings = render_settings_default();
+    int ok = 1;
+    
+    bench_render_reference(scene, &camera, reference, RENDER_RECURSIVE, REFERENCE_SPP);
+    render_guide(scene, &camera, guide, &settings);
+    printf("%dx%d, reference %d spp\n", WIDTH, HEIGHT, REFERENCE_SPP);
+    
+    // Independent samples
+    settings.low_discrepancy = 0;
+    int spps[] = {1, 4, 16, 64};
+    double raw_error[4], denoised_error[4];
+    measure(scene, &camera, image, reference, guide, denoiser, &settings, spps, 4, raw_error, denoised_error);
+    for (int s = 0; s < 2; s++) {
+        // A little slack: both sides are noisy estimates
+        if (denoised_error[s] > raw_error[s + 1] * 1.1) {
+            printf("%d spp denoised is noisier than %d spp raw\n", spps[s], spps[s + 1]);
+            ok = 0;
+        }
+    }
+    
+    // Scrambled Sobol samples
+    int sobol_spps[] = {1, 2, 4, 8};
+    double sobol_raw[4], sobol_denoised[4];
+    settings.low_discrepancy = 1;
+    measure(scene, &camera, image, reference, guide, denoiser, &settings, sobol_spps, 4, sobol_raw, sobol_denoised);
+    for (int s = 0; s < 4; s += 2) {
+        if (sobol_denoised[s] > sobol_raw[s + 1] * 1.1) {
+            printf("%d spp Sobol denoised is noisier than %d spp raw\n", sobol_spps[s], sobol_spps[s + 1]);
+            ok = 0;
+        }
+    }
+    
+    // 1080p timing, and the SIMD filter against the scalar one
+    settings.spp = 4;
+    DenoiseSettings denoise = denoise_settings_default(settings.spp, settings.low_discrepancy);
+    render_scene(scene, &camera, image, &settings, NULL);
+    Image* big = image_create(BIG_WIDTH, BIG_HEIGHT);
+    Image* scalar_out = image_create(BIG_WIDTH, BIG_HEIGHT);
+    Image* simd_out = image_create(BIG_WIDTH, BIG_HEIGHT);
+    DenoiseGuide* big_guide = denoise_guide_create(BIG_WIDTH, BIG_HEIGHT);
+    Denoiser* big_denoiser = denoiser_create(BIG_WIDTH, BIG_HEIGHT);
+    tile_up(image, guide, big, big_guide);
+    
+    int cpus = parallel_cpu_count();
+    double scalar_time = time_denoise(big_denoiser, big, scalar_out, big_guide, &denoise, 1);
+    denoise.threads = 1;
+    double simd_time = time_denoise(big_denoiser, big, simd_out, big_guide, &denoise, 0);
+    denoise.threads = cpus;
+    double threaded_time = time_denoise(big_denoiser, big, simd_out, big_guide, &denoise, 0);
+    
+    float max_diff = 0.0f;
+    for (int i = 0; i < BIG_WIDTH * BIG_HEIGHT; i++) {
+        float d = fabsf(simd_out->pixels[i].r - scalar_out->pixels[i].r) +
+                  fabsf(simd_out->pixels[i].g - scalar_out->pixels[i].g) +
+                  fabsf(simd_out->pixels[i].b - scalar_out->pixels[i].b);
+        if (d > max_diff) max_diff = d;
+    }
+    
+    printf("%dx%d, %d passes (SIMD width %d)\n", BIG_WIDTH, BIG_HEIGHT, denoise.passes, DENOISE_SIMD_WIDTH);
+    printf("scalar, 1 thread   %8.2f ms\n", scalar_time * 1000.0);
+    printf("SIMD, 1 thread     %8.2f ms  %.2fx\n", simd_time * 1000.0, scalar_time / simd_time);
+    printf("SIMD, %2d threads   %8.2f ms  %.2fx  max difference %g\n", cpus, threaded_time * 1000.0,
+           scalar_time / threaded_time, max_diff);
+    if (max_diff > 1e-5f) {
+        printf("SIMD and scalar filters disagree\n");
+        ok = 0;
+    }
+    
+    denoiser_free(big_denoiser);
+    denoise_guide_free(big_guide);
+    image_free(simd_out);
+    image_free(scalar_out);
+    image_free(big);
+    denoiser_free(denoiser);
+    denoise_guide_free(guide);
+    image_free(image);
+    image_free(reference);
+    scene_free(scene);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "image.h"
+#include "timer.h"
+
+// MB/s of the image writers on a 4K frame against the old per-pixel stdio
+// writers, plus a check that the P3 and BMP bytes did not change
+
+#define WIDTH 3840
+#define HEIGHT 2160
+#define OUT_A "bin/bench_image_a.tmp"
+#define OUT_B "bin/bench_image_b.tmp"
+
+// The writers as they were: one fprintf / three fputc per pixel
+static int legacy_write_ppm(Image* img, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) return 0;
+    fprintf(file, "P3\n%d %d\n255\n", img->width, img->height);
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            Color c = image_get_pixel(img, x, y);
+            int r = (int)(c.r * 255.0f);
+            int g = (int)(c.g * 255.0f);
+            int b = (int)(c.b * 255.0f);
+            r = r > 255 ? 255 : (r < 0 ? 0 : r);
+            g = g > 255 ? 255 : (g < 0 ? 0 : g);
+            b = b > 255 ? 255 : (b < 0 ? 0 : b);
+            fprintf(file, "%d %d %d ", r, g, b);
+            if ((x + 1) % 5 == 0) {
+                fprintf(file, "\n");
+            }
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+static int legacy_write_bmp(Image* img, const char* filename) {
+    // Headers are identical to image_write_bmp for widths that need no row padding
+    FILE* file = fopen(filename, "wb");
+    if (!file) return 0;
+    unsigned char header[54] = {'B', 'M'};
+    unsigned int data_size = img->width * img->height * 3;
+    unsigned int file_size = 54 + data_size;
+    int height = -img->height;
+    memcpy(header + 2, &file_size, 4);
+    header[10] = 54;
+    header[14] = 40;
+    memcpy(header + 18, &img->width, 4);
+    memcpy(header + 22, &height, 4);
+    header[26] = 1;
+    header[28] = 24;
+    memcpy(header + 34, &data_size, 4);
+    header[38] = 0x13; header[39] = 0x0b;  // 2835 pixels per meter
+    header[42] = 0x13; header[43] = 0x0b;
+    fwrite(header, 1, 54, file);
+    for (int y = 0; y < img->height; y++) {
+        for (int x = 0; x < img->width; x++) {
+            Color c = image_get_pixel(img, x, y);
+            fputc((unsigned char)(c.b * 255.0f), file);
+            fputc((unsigned char)(c.g * 255.0f), file);
+            fputc((unsigned char)(c.r * 255.0f), file);
+        }
+    }
+    fclose(file);
+    return 1;
+}
+
+static long file_size(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) return -1;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size;
+}
+
+static int files_equal(const char* a, const char* b) {
+    FILE* fa = fopen(a, "rb");
+    FILE* fb = fopen(b, "rb");
+    int equal = fa && fb;
+    while (equal) {
+        int ca = fgetc(fa);
+        int cb = fgetc(fb);
+        if (ca != cb) equal = 0;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return equal;
+}
+
+static double run(const char* name, int (*writer)(Image*, const char*), Image* img, const char* filename) {
+    double start = timer_seconds();
+    writer(img, filename);
+    double seconds = timer_seconds() - start;
+    double mb = file_size(filename) / (1024.0 * 1024.0);
+    printf("%-14s %8.1f ms  %8.1f MB/s  (%.1f MB)\n", name, seconds * 1000.0, mb / seconds, mb);
+    return seconds;
+}
+
+int main() {
+    Image* img = image_create(WIDTH, HEIGHT);
+    for (int y = 0; y < HEIGHT; y++) {
+        for (int x = 0; x < WIDTH; x++) {
+            Color c = {(float)x / WIDTH, (float)y / HEIGHT, (float)((x ^ y) & 255) / 256.0f};
+            image_set_pixel(img, x, y, c);
+        }
+    }
+    
+    printf("%dx%d\n", WIDTH, HEIGHT);
+    int failures = 0;
+    
+    double before = run("legacy P3", legacy_write_ppm, img, OUT_A);
+    double after = run("P3", image_write_ppm, img, OUT_B);
+    printf("  %.1fx\n", before / after);
+    if (!files_equal(OUT_A, OUT_B)) failures++;
+    
+    before = run("legacy BMP", legacy_write_bmp, img, OUT_A);
+    after = run("BMP", image_write_bmp, img, OUT_B);
+    printf("  %.1fx\n", before / after);
+    if (!files_equal(OUT_A, OUT_B)) failures++;
+    
+    run("P6", image_write_ppm_binary, img, OUT_B);
+    
+    remove(OUT_A);
+    remove(OUT_B);
+    image_free(img);
+    
+    if (failures) {
+        printf("Writer output changed\n");
+        return 1;
+    }
+    return 0;
+}
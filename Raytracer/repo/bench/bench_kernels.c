@@ -0,0 +1,407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "raytracer.h"
+#include "renderer.h"
+#include "game.h"
+#include "image.h"
+#include "shade.h"
+#include "timer.h"
+
+// Micro-benchmarks of the hot kernels on procedural scenes of several sizes.
+// Every case is warmed up, then timed call by call; the median and p99 per
+// call go to stdout and to a JSON file (argv[1], default bin/bench_kernels.json)
+// meant to be diffed between builds.
+
+#define WARMUP_CALLS 3
+#define MIN_CALLS 15
+#define MAX_CALLS 2000
+#define TIME_PER_CASE 0.25
+#define DEFAULT_JSON "bin/bench_kernels.json"
+#define IMAGE_FILE "bin/bench_kernels.tmp"
+
+static uint32_t bench_rng = 0x1b873593u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static float bench_range(float min, float max) {
+    return min + (max - min) * bench_random();
+}
+
+static Ray random_ray(float spread) {
+    Vec3 origin = vec3_new(bench_range(-1.0f, 1.0f), bench_range(0.5f, 2.0f), 10.0f);
+    Vec3 dir = vec3_new(bench_range(-spread, spread), bench_range(-spread, spread * 0.5f), -1.0f);
+    return ray_create(origin, dir);
+}
+
+// Spheres scattered in a box in front of the rays, plus a large ground sphere
+static void add_random_spheres(Scene* scene, int count) {
+    int diffuse = scene_add_material(scene, material_diffuse(vec3_new(0.7f, 0.5f, 0.4f)));
+    int metal = scene_add_material(scene, material_metal(vec3_new(0.8f, 0.8f, 0.9f), 0.2f));
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, -1000.0f, 0.0f), 1000.0f, diffuse));
+    for (int i = 1; i < count; i++) {
+        float r = bench_range(0.05f, 0.4f);
+        Vec3 c = vec3_new(bench_range(-10.0f, 10.0f), bench_range(0.0f, 4.0f), bench_range(-20.0f, 0.0f));
+        scene_add_object(scene, sphere_create(c, r, bench_random() < 0.3f ? metal : diffuse));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Timing and reporting
+
+typedef struct {
+    FILE* json;
+    int result_count;
+    double* times;
+} BenchReport;
+
+static int compare_double(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// Time fn(ctx) call by call. ops is how many kernel invocations one call
+// makes, so per-op figures are comparable across batch sizes.
+static void bench_case(BenchReport* report, const char* kernel, const char* scene, long long ops,
+                       void (*fn)(void* ctx), void* ctx) {
+    for (int i = 0; i < WARMUP_CALLS; i++) {
+        fn(ctx);
+    }
+    
+    int calls = 0;
+    double start = timer_seconds();
+    while (calls < MAX_CALLS && (calls < MIN_CALLS || timer_seconds() - start < TIME_PER_CASE)) {
+        double t0 = timer_seconds();
+        fn(ctx);
+        report->times[calls++] = timer_seconds() - t0;
+    }
+    
+    qsort(report->times, calls, sizeof(double), compare_double);
+    double median = report->times[calls / 2];
+    int p99_index = (calls * 99 + 99) / 100 - 1;
+    if (p99_index >= calls) p99_index = calls - 1;
+    double p99 = report->times[p99_index];
+    double min = report->times[0];
+    double ns_per_op = median * 1e9 / ops;
+    
+    printf("%-28s %-22s %6d calls  median %10.3f us  p99 %10.3f us  %9.2f ns/op\n",
+           kernel, scene, calls, median * 1e6, p99 * 1e6, ns_per_op);
+    
+    if (report->json) {
+        fprintf(report->json, "%s\n    {\"kernel\": \"%s\", \"scene\": \"%s\", \"ops_per_call\": %lld, \"calls\": %d, "
+                "\"median_us\": %.3f, \"p99_us\": %.3f, \"min_us\": %.3f, \"ns_per_op\": %.3f}",
+                report->result_count ? "," : "", kernel, scene, ops, calls,
+                median * 1e6, p99 * 1e6, min * 1e6, ns_per_op);
+    }
+    report->result_count++;
+}
+
+// ---------------------------------------------------------------------------
+// Ray kernels
+
+#define RAY_BATCH 1024
+
+typedef struct {
+    Scene* scene;
+    Ray rays[RAY_BATCH];
+    int depth;
+    float checksum;
+} RayCase;
+
+static void run_sphere_hit(void* arg) {
+    RayCase* c = (RayCase*)arg;
+    Sphere sphere = c->scene->scene->spheres[1];
+    for (int i = 0; i < RAY_BATCH; i++) {
+        RayHit hit = {0};
+        if (sphere_hit(sphere, c->rays[i], 0.001f, 1e6f, &hit)) {
+            c->checksum += hit.t;
+        }
+    }
+}
+
+static void run_sphere_list_hit_any(void* arg) {
+    RayCase* c = (RayCase*)arg;
+    for (int i = 0; i < RAY_BATCH; i++) {
+        RayHit hit = {0};
+        if (sphere_list_hit_any(c->scene->scene, c->rays[i], 0.001f, 1e6f, &hit)) {
+            c->checksum += hit.t;
+        }
+    }
+}
+
+static void run_trace_ray(void* arg) {
+    RayCase* c = (RayCase*)arg;
+    for (int i = 0; i < RAY_BATCH; i++) {
+        Rng rng;
+        rng_seed(&rng, (uint32_t)i, 0, 0);
+        Color col = trace_ray(c->rays[i], c->scene, c->depth, &rng);
+        c->checksum += col.r + col.g + col.b;
+    }
+}
+
+static void bench_rays(BenchReport* report) {
+    static RayCase c;
+    int list_sizes[] = {16, 256, 4096};
+    char name[64];
+    
+    for (int s = 0; s < 3; s++) {
+        c.scene = scene_create();
+        add_random_spheres(c.scene, list_sizes[s]);
+        for (int i = 0; i < RAY_BATCH; i++) {
+            c.rays[i] = random_ray(0.6f);
+        }
+        // sphere_hit uses one small sphere aimed at by half the rays
+        Sphere* target = &c.scene->scene->spheres[1];
+        for (int i = 0; i < RAY_BATCH; i += 2) {
+            c.rays[i] = ray_create(c.rays[i].origin, vec3_sub(target->center, c.rays[i].origin));
+        }
+        
+        sprintf(name, "%d spheres", list_sizes[s]);
+        if (s == 0) {
+            bench_case(report, "sphere_hit", "1 sphere", RAY_BATCH, run_sphere_hit, &c);
+        }
+        bench_case(report, "sphere_list_hit_any", name, RAY_BATCH, run_sphere_list_hit_any, &c);
+        scene_free(c.scene);
+    }
+    
+    int trace_sizes[] = {256, 4096};
+    int depths[] = {1, 5, 10};
+    for (int s = 0; s < 2; s++) {
+        c.scene = scene_create();
+        add_random_spheres(c.scene, trace_sizes[s]);
+        scene_build_bvh(c.scene);
+        for (int i = 0; i < RAY_BATCH; i++) {
+            c.rays[i] = random_ray(0.6f);
+        }
+        for (int d = 0; d < 3; d++) {
+            c.depth = depths[d];
+            sprintf(name, "%d spheres, depth %d", trace_sizes[s], depths[d]);
+            bench_case(report, "trace_ray", name, RAY_BATCH, run_trace_ray, &c);
+        }
+        scene_free(c.scene);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Rasterizers and game update
+
+typedef struct {
+    Renderer* renderer;
+    GameState* game;
+    Humanoid humanoid;
+    Structure structure;
+    ProjectilePool projectiles;  // Template restored before every game_update
+    EnemyPool enemies;
+} GameCase;
+
+static void run_draw_sky(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    renderer_draw_sky_gothic(c->renderer, 12.0f);
+}
+
+static void run_draw_ground(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    renderer_draw_ground_gothic(c->renderer);
+}
+
+static void run_draw_sphere(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    renderer_draw_sphere(c->renderer, vec3_new(0.0f, 0.0f, 0.0f), 1.0f, 0xc04040, vec3_new(1.0f, 1.0f, 1.0f));
+}
+
+static void run_draw_humanoid(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    renderer_draw_humanoid_3d(c->renderer, &c->humanoid, 0x20c020);
+}
+
+static void run_draw_structure(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    renderer_draw_structure_3d(c->renderer, &c->structure);
+}
+
+static void run_draw_projectile(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    for (int i = 0; i < 100; i++) {
+        renderer_draw_projectile(c->renderer, vec3_new(i * 0.1f - 5.0f, 0.0f, 1.0f), 0xffcc00);
+    }
+}
+
+static void run_draw_game(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    renderer_clear(c->renderer, 0);
+    renderer_draw_game(c->renderer, c->game, c->game->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+}
+
+static void run_game_update(void* arg) {
+    GameCase* c = (GameCase*)arg;
+    GameState* game = c->game;
+    projectile_pool_copy(&game->projectiles, &c->projectiles);
+    enemy_pool_copy(&game->enemies, &c->enemies);
+    game_update(game, 1.0f / 60.0f);
+}
+
+// Grow the game to enemy_count enemies and projectile_count live projectiles
+static void populate_game(GameCase* c, int enemy_count, int projectile_count) {
+    GameState* game = c->game;
+    enemy_pool_clear(&c->enemies);
+    projectile_pool_clear(&c->projectiles);
+    for (int i = 0; i < enemy_count; i++) {
+        Vec3 pos = vec3_new(bench_range(-6.0f, 6.0f), 0.0f, bench_range(-6.0f, 6.0f));
+        enemy_pool_spawn(&c->enemies, pos, 0.5f, 1, (float)i);
+    }
+    for (int i = 0; i < projectile_count; i++) {
+        Vec3 pos = vec3_new(bench_range(-6.0f, 6.0f), 0.0f, bench_range(-6.0f, 6.0f));
+        Vec3 vel = vec3_new(bench_range(-15.0f, 15.0f), 0.0f, bench_range(-15.0f, 15.0f));
+        projectile_pool_spawn(&c->projectiles, pos, vel, bench_range(0.0f, 3.0f));
+    }
+    enemy_pool_copy(&game->enemies, &c->enemies);
+    projectile_pool_copy(&game->projectiles, &c->projectiles);
+}
+
+static void bench_game(BenchReport* report) {
+    static GameCase c;
+    int widths[] = {640, 1280, 1920};
+    int heights[] = {480, 720, 1080};
+    char name[64];
+    
+    c.game = game_create();
+    enemy_pool_init(&c.enemies);
+    projectile_pool_init(&c.projectiles);
+    c.humanoid = humanoid_create(vec3_new(0.0f, 0.0f, 0.0f), vec3_new(0.0f, 0.0f, -1.0f));
+    humanoid_compute_parts(&c.humanoid);
+    c.structure = (Structure){vec3_new(0.0f, 0.0f, 0.0f), vec3_new(2.0f, 3.0f, 1.0f), ARCH_WALL, 0.0f, 0};
+    
+    for (int s = 0; s < 3; s++) {
+        c.renderer = renderer_create(widths[s], heights[s]);
+        renderer_clear(c.renderer, 0);
+        sprintf(name, "%dx%d", widths[s], heights[s]);
+        
+        bench_case(report, "renderer_draw_sky_gothic", name, 1, run_draw_sky, &c);
+        bench_case(report, "renderer_draw_ground_gothic", name, 1, run_draw_ground, &c);
+        bench_case(report, "renderer_draw_sphere", name, 1, run_draw_sphere, &c);
+        bench_case(report, "renderer_draw_humanoid_3d", name, 1, run_draw_humanoid, &c);
+        bench_case(report, "renderer_draw_structure_3d", name, 1, run_draw_structure, &c);
+        bench_case(report, "renderer_draw_projectile", name, 100, run_draw_projectile, &c);
+        bench_case(report, "renderer_draw_game", name, 1, run_draw_game, &c);
+        renderer_free(c.renderer);
+    }
+    
+    int enemies[] = {5, 50, 200};
+    int projectiles[] = {50, 500, 2000};
+    for (int s = 0; s < 3; s++) {
+        populate_game(&c, enemies[s], projectiles[s]);
+        sprintf(name, "%d enemies, %d shots", enemies[s], projectiles[s]);
+        bench_case(report, "game_update", name, 1, run_game_update, &c);
+    }
+    
+    enemy_pool_free(&c.enemies);
+    projectile_pool_free(&c.projectiles);
+    game_free(c.game);
+}
+
+// ---------------------------------------------------------------------------
+// Span shading
+
+#define SHADE_BATCH 64
+
+typedef struct {
+    uint32_t color;
+    uint16_t shades[SHADE_BATCH];
+    uint32_t out[SHADE_BATCH];
+} ShadeCase;
+
+static void run_shade_span(void* arg) {
+    ShadeCase* c = (ShadeCase*)arg;
+    shade_span(c->color, c->shades, SHADE_BATCH, c->out);
+}
+
+static void run_shade_span_scalar(void* arg) {
+    ShadeCase* c = (ShadeCase*)arg;
+    shade_span_scalar(c->color, c->shades, SHADE_BATCH, c->out);
+}
+
+static void bench_shade(BenchReport* report) {
+    ShadeCase c;
+    uint32_t expected[SHADE_BATCH];
+    c.color = 0xC08040;
+    for (int i = 0; i < SHADE_BATCH; i++) {
+        c.shades[i] = shade_fixed(bench_random());
+    }
+    
+    // Every width must agree with the scalar path, including the tails
+    for (int count = 0; count <= SHADE_BATCH; count++) {
+        shade_span_scalar(c.color, c.shades, count, expected);
+        shade_span(c.color, c.shades, count, c.out);
+        if (memcmp(expected, c.out, count * sizeof(uint32_t)) != 0) {
+            printf("shade_span differs from shade_span_scalar at %d pixels\n", count);
+            exit(1);
+        }
+    }
+    
+    bench_case(report, "shade_span", "64 pixels", SHADE_BATCH, run_shade_span, &c);
+    bench_case(report, "shade_span_scalar", "64 pixels", SHADE_BATCH, run_shade_span_scalar, &c);
+}
+
+// ---------------------------------------------------------------------------
+// Image output
+
+static void run_write_ppm(void* arg) {
+    image_write_ppm((Image*)arg, IMAGE_FILE);
+}
+
+static void run_write_ppm_binary(void* arg) {
+    image_write_ppm_binary((Image*)arg, IMAGE_FILE);
+}
+
+static void bench_image(BenchReport* report) {
+    int widths[] = {256, 1920};
+    int heights[] = {256, 1080};
+    char name[64];
+    
+    for (int s = 0; s < 2; s++) {
+        Image* img = image_create(widths[s], heights[s]);
+        for (int i = 0; i < widths[s] * heights[s]; i++) {
+            img->pixels[i] = (Color){bench_random(), bench_random(), bench_random()};
+        }
+        sprintf(name, "%dx%d", widths[s], heights[s]);
+        bench_case(report, "image_write_ppm", name, 1, run_write_ppm, img);
+        bench_case(report, "image_write_ppm_binary", name, 1, run_write_ppm_binary, img);
+        image_free(img);
+    }
+    remove(IMAGE_FILE);
+}
+
+int main(int argc, char** argv) {
+    const char* json_path = argc > 1 ? argv[1] : DEFAULT_JSON;
+    
+    BenchReport report;
+    report.result_count = 0;
+    report.times = (double*)malloc(MAX_CALLS * sizeof(double));
+    report.json = fopen(json_path, "w");
+    if (!report.json) {
+        printf("Cannot write %s, JSON output disabled\n", json_path);
+    } else {
+        fprintf(report.json, "{\n  \"build\": {\"compiler\": \"%s\", \"sphere_simd_width\": %d, \"shade_simd_width\": %d},\n  \"results\": [",
+                __VERSION__, SPHERE_SIMD_WIDTH, SHADE_SIMD_WIDTH);
+    }
+    
+    bench_rays(&report);
+    bench_game(&report);
+    bench_shade(&report);
+    bench_image(&report);
+    
+    if (report.json) {
+        fprintf(report.json, "\n  ]\n}\n");
+        fclose(report.json);
+        printf("Wrote %d results to %s\n", report.result_count, json_path);
+    }
+    free(report.times);
+    return 0;
+}
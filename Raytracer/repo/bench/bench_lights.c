@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "bench_scene.h"
+#include "timer.h"
+
+// A scene lit only by one small emissive sphere, out of view, rendered with light
+// sampling (next-event estimation plus MIS) and with bounces alone, both
+// against a high spp reference. The figure of merit is the time to reach a
+// given noise level, error^2 * seconds, which light sampling should cut by
+// at least 10x. Both must converge to the same image, in either render mode.
+// All diffuse: light seen in a mirror is only found by bounces either way,
+// and its fireflies would drown the comparison.
+// Then shadow rays on a big random scene: the any-hit query against the
+// closest-hit one, which must agree on every ray.
+
+#define WIDTH 64
+#define HEIGHT 48
+#define REFERENCE_SPP 1024
+#define LIGHT_SPP 16
+#define BOUNCE_SPP 256
+#define SHADOW_SPHERES 100000
+#define SHADOW_RAYS 200000
+#define SHADOW_LENGTH 4.0f  // Mean length of the shadow rays
+
+static uint32_t bench_rng = 0x12345678u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static Scene* make_scene() {
+    Scene* scene = scene_create();
+    int ground = scene_add_material(scene, material_diffuse(vec3_new(0.5f, 0.5f, 0.5f)));
+    int diffuse = scene_add_material(scene, material_diffuse(vec3_new(0.7f, 0.3f, 0.3f)));
+    int green = scene_add_material(scene, material_diffuse(vec3_new(0.3f, 0.7f, 0.3f)));
+    int lamp = scene_add_material(scene, material_emissive(vec3_new(40.0f, 36.0f, 30.0f)));
+    
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, -100.5f, -1.0f), 100.0f, ground));
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, 0.0f, -1.0f), 0.5f, diffuse));
+    scene_add_object(scene, sphere_create(vec3_new(1.0f, 0.0f, -1.0f), 0.5f, green));
+    scene_add_object(scene, sphere_create(vec3_new(-1.0f, 0.0f, -1.0f), 0.5f, diffuse));
+    scene_add_object(scene, sphere_create(vec3_new(0.3f, 2.0f, 0.0f), 0.2f, lamp));
+    scene->sky_intensity = 0.0f;
+    scene_build_bvh(scene);
+    return scene;
+}
+
+// Render and return the seconds taken
+static double render(Scene* scene, Camera* camera, Image* image, RenderMode mode, int spp, int light_sampling) {
+    RenderSettings settings = render_settings_default();
+    RenderStats stats;
+    settings.mode = mode;
+    settings.spp = spp;
+    scene->light_sampling = light_sampling;
+    render_scene(scene, camera, image, &settings, &stats);
+    return stats.seconds;
+}
+
+static int bench_shadow_rays() {
+    Scene* scene = scene_create();
+    scene_add_material(scene, material_diffuse(vec3_new(0.5f, 0.5f, 0.5f)));
+    float extent = cbrtf((float)SHADOW_SPHERES) * 2.0f;
+    for (int i = 0; i < SHADOW_SPHERES; i++) {
+        Vec3 c = vec3_new((bench_random() - 0.5f) * extent, (bench_random() - 0.5f) * extent,
+                          (bench_random() - 0.5f) * extent);
+        scene_add_object(scene, sphere_create(c, 0.2f + bench_random() * 0.4f, 0));
+    }
+    scene_build_bvh(scene);
+    
+    // Segments from random points inside the cloud, like shadow rays from a
+    // hit to a light a few spheres away
+    Ray* rays = (Ray*)malloc(SHADOW_RAYS * sizeof(Ray));
+    float* lengths = (float*)malloc(SHADOW_RAYS * sizeof(float));
+    for (int i = 0; i < SHADOW_RAYS; i++) {
+        Vec3 from = vec3_new((bench_random() - 0.5f) * extent, (bench_random() - 0.5f) * extent,
+                             (bench_random() - 0.5f) * extent);
+        Vec3 direction = vec3_new(bench_random() - 0.5f, bench_random() - 0.5f, bench_random() - 0.5f);
+        lengths[i] = SHADOW_LENGTH * (0.5f + bench_random());
+        rays[i] = ray_create(from, direction);
+    }
+    
+    int closest_blocked = 0, any_blocked = 0, mismatches = 0;
+    double start = timer_seconds();
+    for (int i = 0; i < SHADOW_RAYS; i++) {
+        RayHit hit;
+        closest_blocked += scene_hit(scene, rays[i], 0.001f, lengths[i], &hit);
+    }
+    double closest_time = timer_seconds() - start;
+    start = timer_seconds();
+    for (int i = 0; i < SHADOW_RAYS; i++) {
+        any_blocked += scene_occluded(scene, rays[i], 0.001f, lengths[i]);
+    }
+    double any_time = timer_seconds() - start;
+    for (int i = 0; i < SHADOW_RAYS; i++) {
+        RayHit hit;
+        if (scene_hit(scene, rays[i], 0.001f, lengths[i], &hit) != scene_occluded(scene, rays[i], 0.001f, lengths[i])) {
+            mismatches++;
+        }
+    }
+    
+    printf("\nshadow rays, %d spheres, %.0f%% blocked\n", SHADOW_SPHERES, 100.0 * any_blocked / SHADOW_RAYS);
+    printf("closest hit  %8.2f Mrays/s\n", SHADOW_RAYS / closest_time / 1e6);
+    printf("any hit      %8.2f Mrays/s  %.2fx  %d mismatches\n", SHADOW_RAYS / any_time / 1e6,
+           closest_time / any_time, mismatches);
+    (void)closest_blocked;
+    
+    free(lengths);
+    free(rays);
+    scene_free(scene);
+    return mismatches == 0;
+}
+
+int main() {
+    Scene* scene = make_scene();
+    Camera camera = bench_scene_camera(0.0f, WIDTH, HEIGHT);
+    Image* reference = image_create(WIDTH, HEIGHT);
+    Image* image = image_create(WIDTH, HEIGHT);
+    int ok = 1;
+    
+    scene->light_sampling = 1;
+    bench_render_reference(scene, &camera, reference, RENDER_RECURSIVE, REFERENCE_SPP);
+    double reference_mean = bench_mean(reference->pixels, WIDTH * HEIGHT);
+    
+    double light_time = render(scene, &camera, image, RENDER_RECURSIVE, LIGHT_SPP, 1);
+    double light_error = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+    double bounce_time = render(scene, &camera, image, RENDER_RECURSIVE, BOUNCE_SPP, 0);
+    double bounce_error = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+    double bounce_mean = bench_mean(image->pixels, WIDTH * HEIGHT);
+    double wavefront_time = render(scene, &camera, image, RENDER_WAVEFRONT, LIGHT_SPP, 1);
+    double wavefront_error = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+    double wavefront_mean = bench_mean(image->pixels, WIDTH * HEIGHT);
+    
+    // Time to a fixed noise level goes as error^2 * seconds
+    double light_cost = light_error * light_error * light_time;
+    double bounce_cost = bounce_error * bounce_error * bounce_time;
+    printf("%dx%d, one small light, reference %d spp with light sampling (mean %.4f)\n",
+           WIDTH, HEIGHT, REFERENCE_SPP, reference_mean);
+    printf("bounces only     %4d spp  rms %.4f  %8.2f ms  mean %.4f\n", BOUNCE_SPP, bounce_error,
+           bounce_time * 1000.0, bounce_mean);
+    printf("light sampling   %4d spp  rms %.4f  %8.2f ms\n", LIGHT_SPP, light_error, light_time * 1000.0);
+    printf("  wavefront      %4d spp  rms %.4f  %8.2f ms  mean %.4f\n", LIGHT_SPP, wavefront_error,
+           wavefront_time * 1000.0, wavefront_mean);
+    printf("time to equal noise: %.1fx less with light sampling\n", bounce_cost / light_cost);
+    
+    if (bounce_cost < light_cost * 10.0) {
+        printf("Light sampling saved less than 10x\n");
+        ok = 0;
+    }
+    if (fabs(bounce_mean - reference_mean) > reference_mean * 0.05 ||
+        fabs(wavefront_mean - reference_mean) > reference_mean * 0.05) {
+        printf("Light sampling and bounces converge to different images\n");
+        ok = 0;
+    }
+    if (wavefront_error > light_error * 1.2) {
+        printf("Wavefront light sampling is noisier than recursive\n");
+        ok = 0;
+    }
+    
+    if (!bench_shadow_rays()) {
+        printf("Any-hit and closest-hit queries disagree\n");
+        ok = 0;
+    }
+    
+    image_free(image);
+    image_free(reference);
+    scene_free(scene);
+    return ok ? 0 : 1;
+}
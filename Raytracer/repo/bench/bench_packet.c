@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "raytracer.h"
+
+// Primary-hit throughput of single rays against 2x2, 4x2 and 4x4 packets
+// on a dense sphere field seen through a pinhole camera
+
+#define SPHERE_COUNT 50000
+#define IMAGE_SIZE 512
+#define REPEATS 3
+
+static uint32_t bench_rng = 0x2545f491u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static Ray primary_ray(int x, int y) {
+    float u = (x + 0.5f) / IMAGE_SIZE - 0.5f;
+    float v = 0.5f - (y + 0.5f) / IMAGE_SIZE;
+    return ray_create(vec3_new(0.0f, 0.0f, 40.0f), vec3_new(u, v, -1.0f));
+}
+
+int main() {
+    Scene* scene = scene_create();
+    scene_add_material(scene, material_diffuse(vec3_new(0.5f, 0.5f, 0.5f)));
+    for (int i = 0; i < SPHERE_COUNT; i++) {
+        Vec3 c = vec3_new((bench_random() - 0.5f) * 60.0f, (bench_random() - 0.5f) * 60.0f, -bench_random() * 60.0f);
+        scene_add_object(scene, sphere_create(c, 0.2f + bench_random() * 0.3f, 0));
+    }
+    scene_build_bvh(scene);
+    
+    int pixel_count = IMAGE_SIZE * IMAGE_SIZE;
+    float* reference = (float*)malloc(pixel_count * sizeof(float));
+    float checksum = 0.0f;
+    
+    double t0 = now_seconds();
+    for (int r = 0; r < REPEATS; r++) {
+        for (int y = 0; y < IMAGE_SIZE; y++) {
+            for (int x = 0; x < IMAGE_SIZE; x++) {
+                RayHit hit = {0};
+                scene_hit(scene, primary_ray(x, y), 0.001f, 1e6f, &hit);
+                reference[y * IMAGE_SIZE + x] = hit.hit ? hit.t : -1.0f;
+            }
+        }
+    }
+    double single_rate = (double)pixel_count * REPEATS / (now_seconds() - t0);
+    printf("%d spheres, %dx%d primary rays\n", SPHERE_COUNT, IMAGE_SIZE, IMAGE_SIZE);
+    printf("%-8s %10.2f Mrays/s\n", "single", single_rate * 1e-6);
+    
+    int shapes[3][2] = {{2, 2}, {4, 2}, {4, 4}};
+    int mismatches = 0;
+    for (int s = 0; s < 3; s++) {
+        int bw = shapes[s][0];
+        int bh = shapes[s][1];
+        
+        t0 = now_seconds();
+        for (int r = 0; r < REPEATS; r++) {
+            for (int by = 0; by < IMAGE_SIZE; by += bh) {
+                for (int bx = 0; bx < IMAGE_SIZE; bx += bw) {
+                    Ray rays[RAY_PACKET_MAX];
+                    RayHit hits[RAY_PACKET_MAX];
+                    RayPacket packet;
+                    for (int k = 0; k < bw * bh; k++) {
+                        rays[k] = primary_ray(bx + k % bw, by + k / bw);
+                    }
+                    ray_packet_init(&packet, rays, bw * bh);
+                    uint32_t mask = scene_hit_packet(scene, &packet, 0.001f, 1e6f, hits);
+                    
+                    for (int k = 0; k < bw * bh; k++) {
+                        float t = (mask & (1u << k)) ? hits[k].t : -1.0f;
+                        if (t != reference[(by + k / bw) * IMAGE_SIZE + bx + k % bw]) mismatches++;
+                        if (t > 0.0f) checksum += t;
+                    }
+                }
+            }
+        }
+        double rate = (double)pixel_count * REPEATS / (now_seconds() - t0);
+        printf("%dx%-6d %10.2f Mrays/s  %5.2fx\n", bw, bh, rate * 1e-6, rate / single_rate);
+    }
+    printf("checksum %.1f\n", checksum);
+    
+    free(reference);
+    scene_free(scene);
+    
+    if (mismatches) {
+        printf("Packet and single-ray hits disagree on %d rays\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
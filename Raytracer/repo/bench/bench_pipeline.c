@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "simulation.h"
+#include "renderer.h"
+#include "parallel.h"
+#include "timer.h"
+
+// The game loop with ticks run inline and on the simulation thread, over a
+// big crowd with one tick queued per frame and scripted input. Inline, a
+// frame costs a tick plus a draw; pipelined it should approach the larger
+// of the two given a second core (on one core it can only lose).
+// Both runs must end in the same game state, since each tick's input is
+// fixed when it is queued.
+
+#define WIDTH 1024
+#define HEIGHT 768
+#define ENEMY_COUNT 20000
+#define PROJECTILE_COUNT 2000
+#define ARENA_SIZE 60.0f
+#define FRAMES 120
+#define DT (1.0f / 60.0f)
+
+static uint32_t bench_rng;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static Vec3 arena_point() {
+    return vec3_new((bench_random() - 0.5f) * ARENA_SIZE, 0.0f, (bench_random() - 0.5f) * ARENA_SIZE);
+}
+
+static GameState* crowded_game() {
+    bench_rng = 0x3c6ef372u;
+    GameState* game = game_create();
+    enemy_pool_clear(&game->enemies);
+    for (int i = 0; i < ENEMY_COUNT; i++) {
+        enemy_pool_spawn(&game->enemies, arena_point(), 0.5f, 1, (float)i);
+    }
+    for (int i = 0; i < PROJECTILE_COUNT; i++) {
+        float angle = bench_random() * 6.2831853f;
+        Vec3 velocity = vec3_new(cosf(angle) * 3.0f, 0.0f, sinf(angle) * 3.0f);
+        projectile_pool_spawn(&game->projectiles, arena_point(), velocity, 10.0f);
+    }
+    return game;
+}
+
+static GameInput scripted_input(int frame) {
+    GameInput input = {0, 0, 0, 0, 1};
+    switch ((frame / 20) % 4) {
+        case 0: input.up = 1; break;
+        case 1: input.left = 1; break;
+        case 2: input.down = 1; break;
+        default: input.right = 1; break;
+    }
+    return input;
+}
+
+typedef struct {
+    double frame_time;  // Per frame
+    double tick_time;   // Per tick, inline runs only
+    int score;
+    int enemies;
+    int projectiles;
+    Vec3 position;
+} RunResult;
+
+static RunResult run(Renderer* renderer, int threaded) {
+    GameState* game = crowded_game();
+    Simulation* simulation = simulation_create(game, DT, threaded);
+    GameSnapshot frame;
+    snapshot_init(&frame);
+    Vec3 camera = vec3_new(0.0f, 3.0f, 0.0f), down = vec3_new(0.0f, -1.0f, 0.0f);
+    
+    RunResult result = {0};
+    double start = timer_seconds();
+    for (int f = 0; f < FRAMES; f++) {
+        double tick_start = timer_seconds();
+        simulation_queue(simulation, scripted_input(f));
+        result.tick_time += timer_seconds() - tick_start;
+        
+        simulation_frame(simulation, &frame, 0.5f);
+        renderer_draw_snapshot(renderer, &frame, camera, down);
+    }
+    simulation_free(simulation);
+    result.frame_time = (timer_seconds() - start) / FRAMES;
+    result.tick_time /= FRAMES;
+    
+    result.score = game->score;
+    result.enemies = game->enemies.count;
+    result.projectiles = game->projectiles.count;
+    result.position = game->player.position;
+    snapshot_free(&frame);
+    game_free(game);
+    return result;
+}
+
+static int same_result(RunResult a, RunResult b) {
+    return a.score == b.score && a.enemies == b.enemies && a.projectiles == b.projectiles &&
+           a.position.x == b.position.x && a.position.z == b.position.z;
+}
+
+int main() {
+    Renderer* renderer = renderer_create(WIDTH, HEIGHT);
+    renderer_set_threads(renderer, 1);
+    
+    RunResult inline_run = run(renderer, 0);
+    RunResult pipelined = run(renderer, 1);
+    int ok = same_result(inline_run, pipelined);
+    
+    double draw_time = inline_run.frame_time - inline_run.tick_time;
+    double ideal = inline_run.tick_time > draw_time ? inline_run.tick_time : draw_time;
+    printf("%d enemies, %d frames, %d CPUs: tick %.2f ms, draw %.2f ms\n",
+           ENEMY_COUNT, FRAMES, parallel_cpu_count(), inline_run.tick_time * 1000.0, draw_time * 1000.0);
+    printf("inline    %7.2f ms/frame\n", inline_run.frame_time * 1000.0);
+    printf("pipelined %7.2f ms/frame  %.2fx (at best %.2fx)  %s\n", pipelined.frame_time * 1000.0,
+           inline_run.frame_time / pipelined.frame_time, inline_run.frame_time / ideal, ok ? "ok" : "MISMATCH");
+    printf("final: score %d, %d enemies, %d projectiles\n", pipelined.score, pipelined.enemies, pipelined.projectiles);
+    
+    renderer_free(renderer);
+    
+    if (!ok) {
+        printf("The pipelined run ended in a different game state\n");
+        return 1;
+    }
+    return 0;
+}
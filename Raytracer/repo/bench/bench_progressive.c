@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_scene.h"
+
+// Fixed spp against adaptive progressive sampling, both measured against a
+// high spp reference. Adaptive must reach the same noise with fewer samples.
+
+#define WIDTH 128
+#define HEIGHT 96
+#define REFERENCE_SPP 256
+#define FIXED_SPP 32
+
+int main() {
+    Scene* scene = bench_scene_create();
+    Camera camera = bench_scene_camera(0.0f, WIDTH, HEIGHT);
+    
+    Image* reference = image_create(WIDTH, HEIGHT);
+    Image* image = image_create(WIDTH, HEIGHT);
+    RenderSettings settings = render_settings_default();
+    RenderStats stats;
+    
+    bench_render_reference(scene, &camera, reference, RENDER_RECURSIVE, REFERENCE_SPP);
+    
+    settings.spp = FIXED_SPP;
+    render_scene(scene, &camera, image, &settings, &stats);
+    long long fixed_samples = (long long)FIXED_SPP * WIDTH * HEIGHT;
+    double fixed_error = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+    printf("%dx%d, reference %d spp\n", WIDTH, HEIGHT, REFERENCE_SPP);
+    printf("fixed %3d spp   %10lld samples  %7.3f s  rms %.5f\n", FIXED_SPP, fixed_samples, stats.seconds, fixed_error);
+    
+    // Tighten the per-pixel target until the noise matches the fixed render
+    AccumBuffer* accum = accum_create(WIDTH, HEIGHT);
+    ProgressiveSettings progressive = progressive_settings_default();
+    progressive.render.spp = 8;
+    progressive.max_spp = REFERENCE_SPP;
+    int matched = 0;
+    for (float pixel_error = 0.08f; pixel_error > 0.004f; pixel_error *= 0.85f) {
+        ProgressiveStats pstats;
+        progressive.pixel_error = pixel_error;
+        accum_clear(accum);
+        render_progressive(scene, &camera, image, accum, &progressive, &pstats);
+        double error = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+        printf("adaptive %.4f  %10lld samples  %7.3f s  rms %.5f  %d passes  %.2fx fewer samples\n",
+               pixel_error, pstats.samples, pstats.seconds, error, pstats.passes,
+               (double)fixed_samples / pstats.samples);
+        if (error <= fixed_error) {
+            matched = pstats.samples < fixed_samples;
+            break;
+        }
+    }
+    
+    accum_free(accum);
+    image_free(image);
+    image_free(reference);
+    scene_free(scene);
+    
+    if (!matched) {
+        printf("Adaptive sampling did not beat fixed spp at equal noise\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "renderer.h"
+#include "parallel.h"
+#include "timer.h"
+
+// renderer_draw_game on a crowded 1080p frame at increasing thread counts.
+// Tiles never share pixels and keep their draw order, so every thread count
+// must produce the same framebuffer and depth buffer as one thread. Then the
+// same frames again with the background layer redrawn every frame, which
+// must also give the same image. Then overdraw: pixels shaded per pixel
+// covered, for one humanoid at a time and for the whole crowd. Last, a far
+// bigger crowd drawn from humanoid sprites and from rasterized parts, and
+// how many pixels the two disagree on at all and by more than 16 levels.
+// Finally a large sparse map where almost everything is off screen, which
+// must draw the same frame as a game holding only what is near the screen.
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define ENEMY_COUNT 400
+#define PROJECTILE_COUNT 50
+#define FRAMES 20
+#define OVERDRAW_SIZE 256
+#define CROWD_COUNT 4000
+#define MAP_SIZE 400.0f
+#define MAP_ENEMIES 100000
+#define MAP_PROJECTILES 20000
+
+static uint32_t bench_rng = 0x2545f491u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static uint64_t frame_hash(Renderer* renderer) {
+    renderer_resolve_depth(renderer);
+    uint64_t hash = 1469598103934665603ull;
+    for (int i = 0; i < renderer->width * renderer->height; i++) {
+        uint32_t depth;
+        memcpy(&depth, &renderer->depthbuffer[i], sizeof(depth));
+        hash = (hash ^ renderer->framebuffer[i]) * 1099511628211ull;
+        hash = (hash ^ depth) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static int covered_pixels(Renderer* renderer) {
+    renderer_resolve_depth(renderer);
+    int covered = 0;
+    for (int i = 0; i < renderer->width * renderer->height; i++) {
+        covered += renderer->depthbuffer[i] < 999999.0f;
+    }
+    return covered;
+}
+
+// Humanoids drawn one by one on an empty screen, so only their own limbs overlap
+static double humanoid_overdraw(GameState* game) {
+    Renderer* renderer = renderer_create(OVERDRAW_SIZE, OVERDRAW_SIZE);
+    long long covered = 0;
+    for (int i = 0; i < game->enemies.count; i++) {
+        Humanoid humanoid = humanoid_create(vec3_new(0.0f, 0.0f, 0.0f), vec3_normalize(enemy_pool_position(&game->enemies, i)));
+        humanoid.animation_time = (float)i;
+        humanoid_compute_parts(&humanoid);
+        renderer_clear(renderer, 0);
+        renderer_draw_humanoid_3d(renderer, &humanoid, 0xcc1a1a);
+        covered += covered_pixels(renderer);
+    }
+    double overdraw = (double)renderer->fragments / covered;
+    renderer_free(renderer);
+    return overdraw;
+}
+
+// The crowd alone, without the background, through renderer_draw_game's tiles
+static double crowd_overdraw(GameState* game, Renderer* renderer) {
+    int structure_count = game->environment->structure_count;
+    game->environment->structure_count = 0;
+    game->environment->structure_revision++;
+    renderer_draw_game(renderer, game, game->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    long long fragments = renderer->fragments;
+    renderer_draw_game(renderer, game, game->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    fragments = renderer->fragments - fragments;
+    game->environment->structure_count = structure_count;
+    game->environment->structure_revision++;
+    return (double)fragments / covered_pixels(renderer);
+}
+
+// Serial ms per frame for the crowd without the background
+static double crowd_time(GameState* game, Renderer* renderer, int sprites) {
+    renderer_set_humanoid_sprites(renderer, sprites);
+    renderer_draw_game(renderer, game, game->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    double start = timer_seconds();
+    for (int f = 0; f < FRAMES; f++) {
+        game->environment->time_of_day = 18.0f + f * 0.0017f;
+        renderer_draw_game(renderer, game, game->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    }
+    return (timer_seconds() - start) * 1000.0 / FRAMES;
+}
+
+static void crowd_sprites(GameState* game) {
+    EnemyPool enemies;
+    enemy_pool_init(&enemies);
+    enemy_pool_copy(&enemies, &game->enemies);
+    enemy_pool_clear(&game->enemies);
+    for (int i = 0; i < CROWD_COUNT; i++) {
+        Vec3 pos = vec3_new((bench_random() - 0.5f) * 38.0f, 0.0f, (bench_random() - 0.5f) * 21.0f);
+        enemy_pool_spawn(&game->enemies, pos, 0.5f, 1, (float)i);
+    }
+    int structure_count = game->environment->structure_count;
+    game->environment->structure_count = 0;
+    game->environment->structure_revision++;
+    
+    Renderer* renderer = renderer_create(WIDTH, HEIGHT);
+    renderer_set_threads(renderer, 1);
+    double parts_time = crowd_time(game, renderer, 0);
+    uint32_t* parts = (uint32_t*)malloc(WIDTH * HEIGHT * sizeof(uint32_t));
+    memcpy(parts, renderer->framebuffer, WIDTH * HEIGHT * sizeof(uint32_t));
+    double sprite_time = crowd_time(game, renderer, 1);
+    
+    int differ = 0, visible = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        int largest = 0;
+        for (int shift = 0; shift < 24; shift += 8) {
+            int delta = abs((int)((parts[i] >> shift) & 0xFF) - (int)((renderer->framebuffer[i] >> shift) & 0xFF));
+            if (delta > largest) largest = delta;
+        }
+        differ += largest > 0;
+        visible += largest > 16;
+    }
+    printf("%d enemies: parts %.2f ms/frame, sprites %.2f ms/frame  %.2fx  %d sprites built\n",
+           CROWD_COUNT, parts_time, sprite_time, parts_time / sprite_time, renderer->sprites.builds);
+    printf("sprites vs parts: %.2f%% of pixels differ, %.2f%% by more than 16 levels\n",
+           100.0 * differ / (WIDTH * HEIGHT), 100.0 * visible / (WIDTH * HEIGHT));
+    
+    free(parts);
+    renderer_free(renderer);
+    enemy_pool_copy(&game->enemies, &enemies);
+    enemy_pool_free(&enemies);
+    game->environment->structure_count = structure_count;
+    game->environment->structure_revision++;
+}
+
+// Whatever is this near the centre (in world units, the screen being about
+// 38 x 21) goes in the nearby-only game
+static int near_screen(Vec3 pos) {
+    return fabsf(pos.x) < 25.0f && fabsf(pos.z) < 17.0f;
+}
+
+static int sparse_map() {
+    GameState* map = game_create();
+    GameState* nearby = game_create();
+    enemy_pool_clear(&map->enemies);
+    enemy_pool_clear(&nearby->enemies);
+    for (int i = 0; i < MAP_ENEMIES; i++) {
+        Vec3 pos = vec3_new((bench_random() - 0.5f) * MAP_SIZE, 0.0f, (bench_random() - 0.5f) * MAP_SIZE);
+        enemy_pool_spawn(&map->enemies, pos, 0.5f, 1, (float)i);
+        if (near_screen(pos)) enemy_pool_spawn(&nearby->enemies, pos, 0.5f, 1, (float)i);
+    }
+    for (int i = 0; i < MAP_PROJECTILES; i++) {
+        Vec3 pos = vec3_new((bench_random() - 0.5f) * MAP_SIZE, 0.0f, (bench_random() - 0.5f) * MAP_SIZE);
+        projectile_pool_spawn(&map->projectiles, pos, vec3_new(0.0f, 0.0f, 0.0f), 1.0f);
+        if (near_screen(pos)) projectile_pool_spawn(&nearby->projectiles, pos, vec3_new(0.0f, 0.0f, 0.0f), 1.0f);
+    }
+    
+    Renderer* renderer = renderer_create(WIDTH, HEIGHT);
+    renderer_set_threads(renderer, 1);
+    renderer_draw_game(renderer, nearby, nearby->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    uint64_t reference = frame_hash(renderer);
+    
+    renderer_draw_game(renderer, map, map->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    double start = timer_seconds();
+    for (int f = 0; f < FRAMES; f++) {
+        renderer_draw_game(renderer, map, map->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    }
+    double elapsed = (timer_seconds() - start) * 1000.0 / FRAMES;
+    int same = frame_hash(renderer) == reference;
+    printf("sparse map: %d enemies, %d on or near screen: %.2f ms/frame  %s\n", MAP_ENEMIES,
+           nearby->enemies.count, elapsed, same ? "ok" : "MISMATCH");
+    
+    renderer_free(renderer);
+    game_free(map);
+    game_free(nearby);
+    return !same;
+}
+
+// The timed sequence of FRAMES frames, redrawing the background every
+// frame if uncached
+static void draw_frames(Renderer* renderer, GameState* game, int uncached) {
+    for (int f = 0; f < FRAMES; f++) {
+        // The game clock advances 0.1 hours a second; these are about 60 fps steps
+        game->environment->time_of_day = 18.0f + f * 0.0017f;
+        if (uncached) renderer_invalidate_background(renderer);
+        renderer_draw_game(renderer, game, game->environment, vec3_new(0.0f, 3.0f, 0.0f), vec3_new(0.0f, -1.0f, 0.0f));
+    }
+}
+
+int main() {
+    GameState* game = game_create();
+    
+    // Fill the screen (about 38 x 21 units at 50 pixels per unit)
+    enemy_pool_clear(&game->enemies);
+    for (int i = 0; i < ENEMY_COUNT; i++) {
+        Vec3 pos = vec3_new((bench_random() - 0.5f) * 38.0f, 0.0f, (bench_random() - 0.5f) * 21.0f);
+        enemy_pool_spawn(&game->enemies, pos, 0.5f, 1, (float)i);
+    }
+    for (int i = 0; i < PROJECTILE_COUNT; i++) {
+        Vec3 pos = vec3_new((bench_random() - 0.5f) * 38.0f, 0.0f, (bench_random() - 0.5f) * 21.0f);
+        projectile_pool_spawn(&game->projectiles, pos, vec3_new(0.0f, 0.0f, 0.0f), 1.0f);
+    }
+    
+    Renderer* renderer = renderer_create(WIDTH, HEIGHT);
+    int cpus = parallel_cpu_count();
+    int thread_counts[] = {1, 2, 4, 8, cpus};
+    int runs = cpus > 8 ? 5 : 4;
+    
+    printf("%dx%d, %d enemies, %d projectiles, %d tiles, %d CPUs\n", WIDTH, HEIGHT, ENEMY_COUNT,
+           game->projectiles.count, renderer->draws.tiles_x * renderer->draws.tiles_y, cpus);
+    int failures = 0;
+    uint64_t reference = 0;
+    double serial_time = 0.0;
+    for (int r = 0; r <= runs; r++) {
+        // The last run repeats the serial one with the background redrawn every frame
+        int uncached = r == runs;
+        renderer_set_threads(renderer, uncached ? 1 : thread_counts[r]);
+        // The same frames untimed first, so the one-time background and
+        // sprite builds are not charged to the first thread count
+        draw_frames(renderer, game, uncached);
+        int rebuilds = renderer->background.rebuilds;
+        int builds = renderer->sprites.builds;
+        
+        double start = timer_seconds();
+        draw_frames(renderer, game, uncached);
+        double elapsed = (timer_seconds() - start) / FRAMES;
+        rebuilds = renderer->background.rebuilds - rebuilds;
+        builds = renderer->sprites.builds - builds;
+        if (builds != 0 || (!uncached && rebuilds != 0)) {
+            printf("caches still warming while timed: %d sprites, %d backgrounds built\n", builds, rebuilds);
+            failures++;
+        }
+        
+        uint64_t hash = frame_hash(renderer);
+        if (r == 0) {
+            reference = hash;
+            serial_time = elapsed;
+        }
+        if (uncached) {
+            printf("no cache:   %7.2f ms/frame  %5.2fx  %s  background drawn %d/%d\n", elapsed * 1000.0,
+                   serial_time / elapsed, hash == reference ? "ok" : "MISMATCH", rebuilds, FRAMES);
+        } else {
+            printf("%2d threads: %7.2f ms/frame  %5.2fx  %s  background drawn %d/%d\n", thread_counts[r], elapsed * 1000.0,
+                   serial_time / elapsed, hash == reference ? "ok" : "MISMATCH", rebuilds, FRAMES);
+        }
+        if (hash != reference) failures++;
+    }
+    
+    printf("overdraw: %.2f pixels shaded per pixel covered per humanoid, %.2f for the crowd\n",
+           humanoid_overdraw(game), crowd_overdraw(game, renderer));
+    crowd_sprites(game);
+    if (sparse_map()) failures++;
+    
+    renderer_free(renderer);
+    game_free(game);
+    
+    if (failures) {
+        printf("Tiled drawing depends on the thread count, the background cache or off-screen entities,\n"
+               "or the caches were still warming while timed\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "scene_render.h"
+#include "parallel.h"
+
+// Thread scaling of render_scene, with a check that the image does not
+// depend on the number of threads
+
+#define WIDTH 320
+#define HEIGHT 240
+#define SPP 4
+#define SPHERE_COUNT 2000
+
+static uint32_t bench_rng = 0x6b43a9b5u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static Scene* make_scene() {
+    Scene* scene = scene_create();
+    int diffuse = scene_add_material(scene, material_diffuse(vec3_new(0.7f, 0.4f, 0.3f)));
+    int metal = scene_add_material(scene, material_metal(vec3_new(0.8f, 0.8f, 0.9f), 0.1f));
+    int ground = scene_add_material(scene, material_diffuse(vec3_new(0.5f, 0.5f, 0.5f)));
+    
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, -1000.0f, 0.0f), 1000.0f, ground));
+    for (int i = 0; i < SPHERE_COUNT; i++) {
+        float r = 0.1f + bench_random() * 0.2f;
+        Vec3 c = vec3_new((bench_random() - 0.5f) * 30.0f, r, -bench_random() * 30.0f);
+        scene_add_object(scene, sphere_create(c, r, bench_random() < 0.3f ? metal : diffuse));
+    }
+    return scene;
+}
+
+int main() {
+    Scene* scene = make_scene();
+    Camera camera = camera_create(vec3_new(0.0f, 2.0f, 5.0f), vec3_new(0.0f, 0.0f, -10.0f),
+                                  vec3_new(0.0f, 1.0f, 0.0f), 50.0f, (float)WIDTH / HEIGHT);
+    scene_build_bvh(scene);
+    
+    Image* reference = image_create(WIDTH, HEIGHT);
+    Image* image = image_create(WIDTH, HEIGHT);
+    int max_threads = parallel_cpu_count();
+    if (max_threads < 4) max_threads = 4;  // Still exercise the work queue on small machines
+    
+    RenderSettings settings = render_settings_default();
+    settings.spp = SPP;
+    settings.threads = 1;
+    
+    RenderStats stats;
+    render_scene(scene, &camera, reference, &settings, &stats);
+    double base = stats.seconds;
+    printf("%dx%d, %d spp, %d spheres, %d CPUs\n", WIDTH, HEIGHT, SPP, SPHERE_COUNT, parallel_cpu_count());
+    printf("threads %3d: %8.3f s  %5.2fx\n", 1, base, 1.0);
+    
+    int failures = 0;
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        settings.threads = threads;
+        render_scene(scene, &camera, image, &settings, &stats);
+        printf("threads %3d: %8.3f s  %5.2fx  tiles/thread", threads, stats.seconds, base / stats.seconds);
+        for (int i = 0; i < threads && i < 16; i++) printf(" %d", stats.tiles_per_thread[i]);
+        printf("%s\n", threads > 16 ? " ..." : "");
+        
+        if (memcmp(image->pixels, reference->pixels, WIDTH * HEIGHT * sizeof(Color)) != 0) failures++;
+    }
+    
+    image_free(image);
+    image_free(reference);
+    scene_free(scene);
+    
+    if (failures) {
+        printf("Image changed with the thread count\n");
+        return 1;
+    }
+    return 0;
+}
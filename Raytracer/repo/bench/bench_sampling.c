@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_scene.h"
+#include "timer.h"
+
+// Closed-form direction sampling against the rejection loop it replaced,
+// then the scrambled Sobol points: every power-of-two run of a pixel's
+// samples must stratify the unit square (a (0,2)-net), and renders drawing
+// from them must be less noisy than renders from independent random
+// numbers at the same spp, without moving the mean.
+
+#define DIRECTIONS 5000000
+#define NET_PIXELS 64
+#define NET_POINTS 256
+#define WIDTH 128
+#define HEIGHT 96
+#define REFERENCE_SPP 1024
+
+// The old sampler, kept here for comparison
+static int rejection_draws;
+
+static Vec3 rejection_unit_vector(Rng* rng) {
+    while (1) {
+        Vec3 p = vec3_new(rng_float_range(rng, -1.0f, 1.0f), rng_float_range(rng, -1.0f, 1.0f),
+                          rng_float_range(rng, -1.0f, 1.0f));
+        rejection_draws += 3;
+        if (vec3_length(p) < 1.0f) {
+            return vec3_normalize(p);
+        }
+    }
+}
+
+static void bench_directions() {
+    Rng rng;
+    rng_seed(&rng, 0, 0, 0);
+    Vec3 normal = vec3_new(0.0f, 1.0f, 0.0f);
+    double rejection_cos = 0.0, closed_cos = 0.0;
+    
+    double start = timer_seconds();
+    for (int i = 0; i < DIRECTIONS; i++) {
+        Vec3 d = vec3_normalize(vec3_add(normal, rejection_unit_vector(&rng)));
+        rejection_cos += d.y;
+    }
+    double rejection_time = timer_seconds() - start;
+    
+    start = timer_seconds();
+    for (int i = 0; i < DIRECTIONS; i++) {
+        float u, v;
+        rng_sample_2d(&rng, &u, &v);
+        closed_cos += vec3_cosine_direction(normal, u, v).y;
+    }
+    double closed_time = timer_seconds() - start;
+    
+    // Both should average a cosine of 2/3
+    printf("cosine directions, %d\n", DIRECTIONS);
+    printf("rejection     %8.1f M/s  %.2f random numbers each  mean cos %.4f\n", DIRECTIONS / rejection_time * 1e-6,
+           (double)rejection_draws / DIRECTIONS, rejection_cos / DIRECTIONS);
+    printf("closed form   %8.1f M/s  2 random numbers each     mean cos %.4f  %.2fx\n",
+           DIRECTIONS / closed_time * 1e-6, closed_cos / DIRECTIONS, rejection_time / closed_time);
+}
+
+// The first n points of every pixel must fall one to each of the n
+// elementary rectangles of every shape, for each power of two n
+static int check_nets() {
+    int failures = 0;
+    float* xs = (float*)malloc(NET_POINTS * sizeof(float));
+    float* ys = (float*)malloc(NET_POINTS * sizeof(float));
+    int* cells = (int*)malloc(NET_POINTS * sizeof(int));
+    
+    for (int pixel = 0; pixel < NET_PIXELS; pixel++) {
+        for (int dimension = 0; dimension < 3; dimension++) {
+            for (int i = 0; i < NET_POINTS; i++) {
+                Rng rng;
+                rng_seed(&rng, (uint32_t)pixel, (uint32_t)i, 0);
+                // Later dimension pairs come from their own scrambles
+                for (int d = 0; d <= dimension; d++) {
+                    rng_sample_2d(&rng, &xs[i], &ys[i]);
+                }
+            }
+            for (int n = 1; n <= NET_POINTS; n *= 2) {
+                for (int columns = 1; columns <= n; columns *= 2) {
+                    int rows = n / columns;
+                    for (int c = 0; c < n; c++) cells[c] = 0;
+                    for (int i = 0; i < n; i++) {
+                        cells[(int)(ys[i] * rows) * columns + (int)(xs[i] * columns)]++;
+                    }
+                    for (int c = 0; c < n; c++) {
+                        if (cells[c] != 1) {
+                            failures++;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    free(cells);
+    free(ys);
+    free(xs);
+    printf("\n(0,2)-net check, %d pixels x 3 dimension pairs x up to %d points: %d failures\n",
+           NET_PIXELS, NET_POINTS, failures);
+    return failures == 0;
+}
+
+static int bench_render() {
+    Scene* scene = bench_scene_create();
+    Camera camera = bench_scene_camera(0.0f, WIDTH, HEIGHT);
+    
+    Image* reference = image_create(WIDTH, HEIGHT);
+    Image* image = image_create(WIDTH, HEIGHT);
+    RenderSettings settings = render_settings_default();
+    RenderStats stats;
+    bench_render_reference(scene, &camera, reference, RENDER_RECURSIVE, REFERENCE_SPP);
+    double reference_mean = bench_mean(reference->pixels, WIDTH * HEIGHT);
+    
+    int ok = 1;
+    int spps[] = {1, 4, 16, 64};
+    printf("\n%dx%d, reference %d spp (mean %.4f)\n", WIDTH, HEIGHT, REFERENCE_SPP, reference_mean);
+    printf("spp   independent rms     ms    Sobol rms     ms   ratio\n");
+    for (int s = 0; s < 4; s++) {
+        double error[2], mean[2], ms[2];
+        for (int sobol = 0; sobol < 2; sobol++) {
+            settings.spp = spps[s];
+            settings.low_discrepancy = sobol;
+            render_scene(scene, &camera, image, &settings, &stats);
+            error[sobol] = bench_rms_error(image->pixels, reference->pixels, WIDTH * HEIGHT);
+            mean[sobol] = bench_mean(image->pixels, WIDTH * HEIGHT);
+            ms[sobol] = stats.seconds * 1000.0;
+        }
+        printf("%3d   %15.5f %6.1f %12.5f %6.1f   %.2fx\n", spps[s], error[0], ms[0], error[1], ms[1],
+               error[0] / error[1]);
+        if (spps[s] >= 4 && error[1] > error[0] * 0.9) {
+            printf("Sobol samples are not less noisy than independent ones at %d spp\n", spps[s]);
+            ok = 0;
+        }
+        if (fabs(mean[1] - reference_mean) > reference_mean * 0.01) {
+            printf("Sobol samples moved the mean at %d spp\n", spps[s]);
+            ok = 0;
+        }
+    }
+    
+    image_free(image);
+    image_free(reference);
+    scene_free(scene);
+    return ok;
+}
+
+int main() {
+    int ok = 1;
+    bench_directions();
+    if (!check_nets()) {
+        printf("Scrambled Sobol points do not stratify\n");
+        ok = 0;
+    }
+    if (!bench_render()) ok = 0;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#ifndef BENCH_SCENE_H
+#define BENCH_SCENE_H
+
+#include <math.h>
+#include "scene_render.h"
+
+// What the image quality benches share: one test scene and camera, the
+// reference they measure against and the error measure itself
+
+// Materials of bench_scene_create's scene, by index
+enum { BENCH_GROUND, BENCH_DIFFUSE, BENCH_METAL };
+
+// Diffuse, metal and diffuse spheres on a huge ground sphere: mostly sky
+// and smooth ground, like the usual test scenes. The BVH is built, so
+// dynamic objects can still be added.
+static inline Scene* bench_scene_create() {
+    Scene* scene = scene_create();
+    scene_add_material(scene, material_diffuse(vec3_new(0.5f, 0.5f, 0.5f)));
+    scene_add_material(scene, material_diffuse(vec3_new(0.7f, 0.3f, 0.3f)));
+    scene_add_material(scene, material_metal(vec3_new(0.8f, 0.8f, 0.8f), 0.3f));
+    
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, -100.5f, -1.0f), 100.0f, BENCH_GROUND));
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, 0.0f, -1.0f), 0.5f, BENCH_DIFFUSE));
+    scene_add_object(scene, sphere_create(vec3_new(1.0f, 0.0f, -1.0f), 0.5f, BENCH_METAL));
+    scene_add_object(scene, sphere_create(vec3_new(-1.0f, 0.0f, -1.0f), 0.5f, BENCH_DIFFUSE));
+    scene_build_bvh(scene);
+    return scene;
+}
+
+// Looking at the spheres, moved pan units to the side
+static inline Camera bench_scene_camera(float pan, int width, int height) {
+    return camera_create(vec3_new(pan, 0.5f, 2.0f), vec3_new(pan, 0.0f, -1.0f),
+                         vec3_new(0.0f, 1.0f, 0.0f), 60.0f, (float)width / height);
+}
+
+// Independent samples on their own stream, so the reference shares no
+// samples with the renders measured against it
+static inline void bench_render_reference(Scene* scene, Camera* camera, Image* image, RenderMode mode, int spp) {
+    RenderSettings settings = render_settings_default();
+    settings.mode = mode;
+    settings.spp = spp;
+    settings.low_discrepancy = 0;
+    settings.stream = 1;
+    render_scene(scene, camera, image, &settings, NULL);
+}
+
+// Over the r, g and b of count pixels
+static inline double bench_rms_error(const Color* image, const Color* reference, int count) {
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        double dr = image[i].r - reference[i].r;
+        double dg = image[i].g - reference[i].g;
+        double db = image[i].b - reference[i].b;
+        sum += dr * dr + dg * dg + db * db;
+    }
+    return sqrt(sum / (3.0 * count));
+}
+
+static inline double bench_mean(const Color* image, int count) {
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sum += image[i].r + image[i].g + image[i].b;
+    }
+    return sum / (3.0 * count);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "sphere.h"
+
+// Throughput of the AoS loop, the scalar SoA kernel and the SIMD SoA kernel,
+// and a check that all three report exactly the same hits
+
+#define SPHERE_COUNT 1024
+#define RAY_COUNT 20000
+
+static uint32_t bench_rng = 0x9e3779b9u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int same_hit(RayHit* a, RayHit* b) {
+    return a->t == b->t && a->material_id == b->material_id &&
+           a->point.x == b->point.x && a->point.y == b->point.y && a->point.z == b->point.z &&
+           a->normal.x == b->normal.x && a->normal.y == b->normal.y && a->normal.z == b->normal.z;
+}
+
+int main() {
+    SphereList* aos = sphere_list_create(SPHERE_COUNT);
+    SphereList* soa = sphere_list_create(SPHERE_COUNT);
+    for (int i = 0; i < SPHERE_COUNT; i++) {
+        Vec3 c = vec3_new((bench_random() - 0.5f) * 40.0f, (bench_random() - 0.5f) * 40.0f, (bench_random() - 0.5f) * 40.0f);
+        Sphere s = sphere_create(c, 0.2f + bench_random(), i);
+        sphere_list_add(aos, s);
+        sphere_list_add(soa, s);
+    }
+    sphere_list_enable_soa(soa);
+    
+    Ray* rays = (Ray*)malloc(RAY_COUNT * sizeof(Ray));
+    for (int i = 0; i < RAY_COUNT; i++) {
+        Vec3 o = vec3_new((bench_random() - 0.5f) * 40.0f, (bench_random() - 0.5f) * 40.0f, (bench_random() - 0.5f) * 40.0f);
+        rays[i] = ray_create(o, vec3_new(bench_random() - 0.5f, bench_random() - 0.5f, bench_random() - 0.5f));
+    }
+    
+    // Every path must agree bit for bit
+    int mismatches = 0;
+    int hits = 0;
+    for (int i = 0; i < RAY_COUNT; i++) {
+        RayHit a = {0}, b = {0};
+        float ts, tv;
+        int ha = sphere_list_hit_any(aos, rays[i], 0.001f, 1e6f, &a);
+        int hb = sphere_list_hit_any(soa, rays[i], 0.001f, 1e6f, &b);
+        int is = sphere_soa_hit_closest_scalar(soa->soa, 0, soa->count, rays[i], 0.001f, 1e6f, &ts);
+        int iv = sphere_soa_hit_closest(soa->soa, 0, soa->count, rays[i], 0.001f, 1e6f, &tv);
+        
+        if (ha != hb || (ha && !same_hit(&a, &b))) mismatches++;
+        if (is != iv || (is >= 0 && ts != tv)) mismatches++;
+        if (ha != (is >= 0) || (ha && (a.material_id != is || a.t != ts))) mismatches++;
+        hits += ha;
+    }
+    
+    float checksum = 0.0f;
+    RayHit hit;
+    float t;
+    
+    double t0 = now_seconds();
+    for (int i = 0; i < RAY_COUNT; i++) {
+        if (sphere_list_hit_any(aos, rays[i], 0.001f, 1e6f, &hit)) checksum += hit.t;
+    }
+    double aos_time = now_seconds() - t0;
+    
+    t0 = now_seconds();
+    for (int i = 0; i < RAY_COUNT; i++) {
+        if (sphere_soa_hit_closest_scalar(soa->soa, 0, soa->count, rays[i], 0.001f, 1e6f, &t) >= 0) checksum += t;
+    }
+    double scalar_time = now_seconds() - t0;
+    
+    t0 = now_seconds();
+    for (int i = 0; i < RAY_COUNT; i++) {
+        if (sphere_soa_hit_closest(soa->soa, 0, soa->count, rays[i], 0.001f, 1e6f, &t) >= 0) checksum += t;
+    }
+    double simd_time = now_seconds() - t0;
+    
+    double tests = (double)RAY_COUNT * SPHERE_COUNT;
+    printf("%d spheres, %d rays, %d hits, SIMD width %d\n", SPHERE_COUNT, RAY_COUNT, hits, SPHERE_SIMD_WIDTH);
+    printf("%-12s %10.1f M tests/s\n", "aos", tests / aos_time * 1e-6);
+    printf("%-12s %10.1f M tests/s\n", "soa scalar", tests / scalar_time * 1e-6);
+    printf("%-12s %10.1f M tests/s   (checksum %.1f)\n", "soa simd", tests / simd_time * 1e-6, checksum);
+    
+    free(rays);
+    sphere_list_free(aos);
+    sphere_list_free(soa);
+    
+    if (mismatches) {
+        printf("Intersection paths disagree on %d results\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
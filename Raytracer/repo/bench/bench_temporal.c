@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_scene.h"
+
+// 1 spp real-time frames with temporal accumulation against 16 spp, both
+// measured against the mean of many pixel-centre frames (the value both
+// estimate; a jittered reference would count antialiasing as error).
+// With everything still, the history should reach the quality of 16
+// independent samples; a plain mean of 16 scrambled Sobol frames is better
+// still, as blending into a history cannot keep their stratification. With
+// the camera panning and a sphere moving it should stay well under the raw
+// 1 spp noise without leaving ghosts behind the sphere.
+
+#define WIDTH 128
+#define HEIGHT 96
+#define REFERENCE_FRAMES 256
+#define COMPARE_SPP 16
+#define SETTLE_FRAMES 32
+#define MOVING_FRAMES 32
+
+static void move_sphere(Scene* scene, int mover, float x) {
+    Sphere sphere = scene->dynamic->spheres[mover];
+    sphere.center.x = x;
+    scene_set_dynamic(scene, mover, sphere);
+    scene_refit(scene);
+}
+
+static void add_frame(Color* sum, const Color* frame) {
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        sum[i].r += frame[i].r;
+        sum[i].g += frame[i].g;
+        sum[i].b += frame[i].b;
+    }
+}
+
+static void scale_frame(Color* sum, float scale) {
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        sum[i] = (Color){sum[i].r * scale, sum[i].g * scale, sum[i].b * scale};
+    }
+}
+
+// The mean of frames first..first+count-1 of raw 1 spp colours, from a fresh history
+static void mean_frames(Scene* scene, Camera* camera, Image* image, int first, int count, int low_discrepancy,
+                        Color* mean) {
+    TemporalBuffer* temporal = temporal_create(WIDTH, HEIGHT);
+    RenderSettings settings = render_settings_default();
+    settings.spp = 1;
+    settings.low_discrepancy = low_discrepancy;
+    memset(mean, 0, WIDTH * HEIGHT * sizeof(Color));
+    for (int f = 0; f < first + count; f++) {
+        render_temporal(scene, camera, image, temporal, &settings, NULL);
+        if (f >= first) add_frame(mean, temporal->color);
+    }
+    scale_frame(mean, 1.0f / count);
+    temporal_free(temporal);
+}
+
+int main() {
+    // The bench scene plus one sphere that moves
+    Scene* scene = bench_scene_create();
+    int mover = scene_add_dynamic(scene, sphere_create(vec3_new(-0.6f, -0.3f, -0.2f), 0.2f, BENCH_DIFFUSE));
+    scene_refit(scene);
+    Image* image = image_create(WIDTH, HEIGHT);
+    Color* reference = (Color*)malloc(WIDTH * HEIGHT * sizeof(Color));
+    Color* compare = (Color*)malloc(WIDTH * HEIGHT * sizeof(Color));
+    RenderSettings settings = render_settings_default();
+    settings.spp = 1;
+    RenderStats stats;
+    int ok = 1;
+    
+    // Still: the history of SETTLE_FRAMES frames
+    Camera camera = bench_scene_camera(0.0f, WIDTH, HEIGHT);
+    mean_frames(scene, &camera, image, COMPARE_SPP, REFERENCE_FRAMES, 0, reference);
+    mean_frames(scene, &camera, image, 0, COMPARE_SPP, 0, compare);
+    double compare_error = bench_rms_error(compare, reference, WIDTH * HEIGHT);
+    mean_frames(scene, &camera, image, 0, COMPARE_SPP, 1, compare);
+    double sobol_error = bench_rms_error(compare, reference, WIDTH * HEIGHT);
+    
+    TemporalBuffer* temporal = temporal_create(WIDTH, HEIGHT);
+    double still_time = 0.0;
+    for (int f = 0; f < SETTLE_FRAMES; f++) {
+        render_temporal(scene, &camera, image, temporal, &settings, &stats);
+        still_time += stats.seconds;
+    }
+    double raw_error = bench_rms_error(temporal->color, reference, WIDTH * HEIGHT);
+    double still_error = bench_rms_error(image->pixels, reference, WIDTH * HEIGHT);
+    
+    settings.spp = COMPARE_SPP;
+    render_scene(scene, &camera, image, &settings, &stats);
+    double compare_time = stats.seconds;
+    settings.spp = 1;
+    
+    printf("%dx%d, reference %d frames\n", WIDTH, HEIGHT, REFERENCE_FRAMES);
+    printf("still    1 spp raw      rms %.5f\n", raw_error);
+    printf("still   %2d spp          rms %.5f  %7.2f ms/frame\n", COMPARE_SPP, compare_error, compare_time * 1000.0);
+    printf("still   %2d spp Sobol    rms %.5f\n", COMPARE_SPP, sobol_error);
+    printf("still    1 spp temporal rms %.5f  %7.2f ms/frame  %.0f%% history\n", still_error,
+           still_time * 1000.0 / SETTLE_FRAMES, 100.0 * temporal->reused / (WIDTH * HEIGHT));
+    if (still_error > compare_error * 1.1) {
+        printf("Temporal accumulation fell short of %d spp\n", COMPARE_SPP);
+        ok = 0;
+    }
+    
+    // Moving: the camera pans and the sphere crosses the view, then both
+    // stop where the reference is taken
+    double moving_time = 0.0;
+    for (int f = 0; f < MOVING_FRAMES; f++) {
+        float t = (float)(f + 1) / MOVING_FRAMES;
+        camera = bench_scene_camera(0.2f * t, WIDTH, HEIGHT);
+        move_sphere(scene, mover, -0.6f + 0.8f * t);
+        render_temporal(scene, &camera, image, temporal, &settings, &stats);
+        moving_time += stats.seconds;
+    }
+    int moving_reused = temporal->reused;
+    Color* raw = (Color*)malloc(WIDTH * HEIGHT * sizeof(Color));
+    memcpy(compare, image->pixels, WIDTH * HEIGHT * sizeof(Color));
+    memcpy(raw, temporal->color, WIDTH * HEIGHT * sizeof(Color));
+    mean_frames(scene, &camera, image, COMPARE_SPP, REFERENCE_FRAMES, 0, reference);
+    double moving_raw = bench_rms_error(raw, reference, WIDTH * HEIGHT);
+    double moving_error = bench_rms_error(compare, reference, WIDTH * HEIGHT);
+    printf("moving   1 spp raw      rms %.5f\n", moving_raw);
+    printf("moving   1 spp temporal rms %.5f  %7.2f ms/frame  %.0f%% history\n", moving_error,
+           moving_time * 1000.0 / MOVING_FRAMES, 100.0 * moving_reused / (WIDTH * HEIGHT));
+    if (moving_error > moving_raw * 0.5) {
+        printf("Temporal accumulation did not hold up under motion\n");
+        ok = 0;
+    }
+    
+    temporal_free(temporal);
+    free(raw);
+    free(reference);
+    free(compare);
+    image_free(image);
+    scene_free(scene);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include "scene_render.h"
+
+// Recursive trace_ray against the wavefront path tracer at increasing path
+// depths. Both estimate the same image, so their mean colours must agree.
+
+#define WIDTH 160
+#define HEIGHT 120
+#define SPP 16
+#define SPHERE_COUNT 2000
+#define TOLERANCE 0.02f
+
+static uint32_t bench_rng = 0x2545f491u;
+
+static float bench_random() {
+    bench_rng ^= bench_rng << 13;
+    bench_rng ^= bench_rng >> 17;
+    bench_rng ^= bench_rng << 5;
+    return (bench_rng >> 8) * (1.0f / 16777216.0f);
+}
+
+static Scene* make_scene() {
+    Scene* scene = scene_create();
+    int diffuse = scene_add_material(scene, material_diffuse(vec3_new(0.8f, 0.6f, 0.5f)));
+    int metal = scene_add_material(scene, material_metal(vec3_new(0.9f, 0.9f, 0.9f), 0.05f));
+    int ground = scene_add_material(scene, material_diffuse(vec3_new(0.7f, 0.7f, 0.7f)));
+    
+    scene_add_object(scene, sphere_create(vec3_new(0.0f, -1000.0f, 0.0f), 1000.0f, ground));
+    for (int i = 0; i < SPHERE_COUNT; i++) {
+        float r = 0.2f + bench_random() * 0.3f;
+        Vec3 c = vec3_new((bench_random() - 0.5f) * 20.0f, r, -bench_random() * 20.0f);
+        scene_add_object(scene, sphere_create(c, r, bench_random() < 0.4f ? metal : diffuse));
+    }
+    return scene;
+}
+
+static Color image_mean(Image* image) {
+    double r = 0.0, g = 0.0, b = 0.0;
+    int n = image->width * image->height;
+    for (int i = 0; i < n; i++) {
+        r += image->pixels[i].r;
+        g += image->pixels[i].g;
+        b += image->pixels[i].b;
+    }
+    return (Color){(float)(r / n), (float)(g / n), (float)(b / n)};
+}
+
+static float relative_error(float a, float b) {
+    return fabsf(a - b) / fmaxf(fabsf(b), 1e-6f);
+}
+
+int main() {
+    Scene* scene = make_scene();
+    Camera camera = camera_create(vec3_new(0.0f, 1.5f, 4.0f), vec3_new(0.0f, 0.3f, -6.0f),
+                                  vec3_new(0.0f, 1.0f, 0.0f), 50.0f, (float)WIDTH / HEIGHT);
+    scene_build_bvh(scene);
+    
+    Image* recursive = image_create(WIDTH, HEIGHT);
+    Image* wavefront = image_create(WIDTH, HEIGHT);
+    RenderSettings settings = render_settings_default();
+    settings.spp = SPP;
+    
+    printf("%dx%d, %d spp, %d spheres\n", WIDTH, HEIGHT, SPP, SPHERE_COUNT);
+    int failures = 0;
+    int depths[] = {MAX_DEPTH, 10, 20};
+    for (int i = 0; i < 3; i++) {
+        RenderStats stats;
+        settings.max_depth = depths[i];
+        
+        settings.mode = RENDER_RECURSIVE;
+        render_scene(scene, &camera, recursive, &settings, &stats);
+        double recursive_time = stats.seconds;
+        
+        settings.mode = RENDER_WAVEFRONT;
+        render_scene(scene, &camera, wavefront, &settings, &stats);
+        double wavefront_time = stats.seconds;
+        
+        Color a = image_mean(recursive);
+        Color b = image_mean(wavefront);
+        float error = fmaxf(relative_error(b.r, a.r), fmaxf(relative_error(b.g, a.g), relative_error(b.b, a.b)));
+        printf("depth %2d: recursive %7.3f s  wavefront %7.3f s  %5.2fx  mean error %.4f\n",
+               depths[i], recursive_time, wavefront_time, recursive_time / wavefront_time, error);
+        if (error > TOLERANCE) failures++;
+    }
+    
+    image_free(wavefront);
+    image_free(recursive);
+    scene_free(scene);
+    
+    if (failures) {
+        printf("Wavefront and recursive images disagree\n");
+        return 1;
+    }
+    return 0;
+}
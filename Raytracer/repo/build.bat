@@ -17,7 +17,7 @@ REM Compile all C files
 echo Compiling...
 for %%f in (%SRC_DIR%\*.c) do (
     echo Compiling %%f
-    "%GCC%" -c "%%f" -o "%BUILD_DIR%\%%~nf.o" -Wall -Wextra -O2 -std=c99
+    "%GCC%" -c "%%f" -o "%BUILD_DIR%\%%~nf.o" -Wall -Wextra -O2 -std=c99 -pthread
     if errorlevel 1 (
         echo Compilation error!
         exit /b 1
@@ -26,7 +26,7 @@ for %%f in (%SRC_DIR%\*.c) do (
 
 REM Link with Windows libraries
 echo Linking...
-"%GCC%" %BUILD_DIR%\*.o -o "%BIN_DIR%\raytracer.exe" -lm -luser32 -lgdi32 -Wall -Wextra -O2
+"%GCC%" %BUILD_DIR%\*.o -o "%BIN_DIR%\raytracer.exe" -lm -luser32 -lgdi32 -pthread -Wall -Wextra -O2
 if errorlevel 1 (
     echo Linking error!
     exit /b 1
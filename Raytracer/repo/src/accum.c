@@ -0,0 +1,72 @@
+#include "accum.h"
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+static float luminance(Color c) {
+    return 0.2126f * c.r + 0.7152f * c.g + 0.0722f * c.b;
+}
+
+AccumBuffer* accum_create(int width, int height) {
+    size_t n = (size_t)width * height;
+    AccumBuffer* acc = (AccumBuffer*)malloc(sizeof(AccumBuffer));
+    acc->width = width;
+    acc->height = height;
+    acc->mean = (Color*)malloc(n * sizeof(Color));
+    acc->lum_mean = (float*)malloc(n * sizeof(float));
+    acc->lum_m2 = (float*)malloc(n * sizeof(float));
+    acc->samples = (int*)malloc(n * sizeof(int));
+    accum_clear(acc);
+    return acc;
+}
+
+void accum_free(AccumBuffer* acc) {
+    if (acc) {
+        free(acc->mean);
+        free(acc->lum_mean);
+        free(acc->lum_m2);
+        free(acc->samples);
+        free(acc);
+    }
+}
+
+void accum_clear(AccumBuffer* acc) {
+    size_t n = (size_t)acc->width * acc->height;
+    memset(acc->mean, 0, n * sizeof(Color));
+    memset(acc->lum_mean, 0, n * sizeof(float));
+    memset(acc->lum_m2, 0, n * sizeof(float));
+    memset(acc->samples, 0, n * sizeof(int));
+}
+
+void accum_add(AccumBuffer* acc, int index, Color sample) {
+    int n = ++acc->samples[index];
+    float inv = 1.0f / n;
+    
+    Color* mean = &acc->mean[index];
+    mean->r += (sample.r - mean->r) * inv;
+    mean->g += (sample.g - mean->g) * inv;
+    mean->b += (sample.b - mean->b) * inv;
+    
+    // Welford update of the luminance variance
+    float lum = luminance(sample);
+    float delta = lum - acc->lum_mean[index];
+    acc->lum_mean[index] += delta * inv;
+    acc->lum_m2[index] += delta * (lum - acc->lum_mean[index]);
+}
+
+float accum_pixel_error(AccumBuffer* acc, int index, int low_discrepancy) {
+    int n = acc->samples[index];
+    if (n < 2) {
+        return FLT_MAX;
+    }
+    
+    float variance = acc->lum_m2[index] / (n - 1);
+    float mean = acc->lum_mean[index];
+    if (mean < ACCUM_LUMINANCE_FLOOR) mean = ACCUM_LUMINANCE_FLOOR;
+    float error = low_discrepancy ? sqrtf(variance) * powf((float)n, -ACCUM_SOBOL_EXPONENT) : sqrtf(variance / n);
+    return error / mean;
+}
+
+void accum_resolve(AccumBuffer* acc, Image* image) {
+    memcpy(image->pixels, acc->mean, (size_t)acc->width * acc->height * sizeof(Color));
+}
@@ -0,0 +1,42 @@
+#ifndef ACCUM_H
+#define ACCUM_H
+
+#include "image.h"
+
+// Error is relative to the pixel's luminance, but anything darker than this
+// is measured against it, so shadows and near-black pixels do not soak up
+// samples chasing noise nobody can see
+#define ACCUM_LUMINANCE_FLOOR 0.25f
+
+// Scrambled Sobol error falls about as samples^-0.65 on the benches, where
+// independent samples give samples^-0.5
+#define ACCUM_SOBOL_EXPONENT 0.65f
+
+// Running per-pixel statistics for progressive rendering: the mean colour
+// plus Welford mean/M2 of luminance, from which the error of the mean is
+// estimated
+typedef struct {
+    int width;
+    int height;
+    Color* mean;
+    float* lum_mean;
+    float* lum_m2;
+    int* samples;
+} AccumBuffer;
+
+AccumBuffer* accum_create(int width, int height);
+void accum_free(AccumBuffer* acc);
+void accum_clear(AccumBuffer* acc);
+
+// Fold one sample into pixel index
+void accum_add(AccumBuffer* acc, int index, Color sample);
+
+// Relative standard error of the pixel's mean luminance, for independent
+// samples or for scrambled Sobol ones (low_discrepancy), whose error falls
+// faster than 1/sqrt(samples). Infinite until the pixel has two samples.
+float accum_pixel_error(AccumBuffer* acc, int index, int low_discrepancy);
+
+// Copy the current means into image (same size)
+void accum_resolve(AccumBuffer* acc, Image* image);
+
+#endif
@@ -0,0 +1,497 @@
+#include "bvh.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#define BVH_STACK_SIZE 128
+#define BVH_MEDIAN_DEPTH 96          // Past this depth splits fall back to object median
+#define BVH_PARALLEL_MIN_SPHERES 8192
+#define BVH_TRAVERSAL_COST 1.0f
+#define BVH_INTERSECT_COST 0.5f
+
+typedef struct {
+    int node_index;
+    int first;
+    int count;
+    int base;
+    int depth;
+} BuildTask;
+
+typedef struct {
+    SphereList* list;
+    float* centroids;      // 3 floats per sphere
+    int* indices;
+    BVHNode* nodes;        // Scratch nodes, a node of n spheres owns 2n-2 slots for its descendants
+
+    int defer_below;       // Subtrees smaller than this become worker tasks (0 = build everything inline)
+    BuildTask* tasks;
+    int task_count;
+    int task_capacity;
+    int next_task;
+} BuildContext;
+
+typedef struct {
+    float min[3];
+    float max[3];
+    int count;
+} Bin;
+
+static void bounds_reset(float* bmin, float* bmax) {
+    for (int a = 0; a < 3; a++) {
+        bmin[a] = INFINITY;
+        bmax[a] = -INFINITY;
+    }
+}
+
+static void bounds_grow_sphere(float* bmin, float* bmax, Sphere* s) {
+    float c[3] = {s->center.x, s->center.y, s->center.z};
+    for (int a = 0; a < 3; a++) {
+        if (c[a] - s->radius < bmin[a]) bmin[a] = c[a] - s->radius;
+        if (c[a] + s->radius > bmax[a]) bmax[a] = c[a] + s->radius;
+    }
+}
+
+static void bounds_grow_bounds(float* bmin, float* bmax, const float* omin, const float* omax) {
+    for (int a = 0; a < 3; a++) {
+        if (omin[a] < bmin[a]) bmin[a] = omin[a];
+        if (omax[a] > bmax[a]) bmax[a] = omax[a];
+    }
+}
+
+static float bounds_half_area(const float* bmin, const float* bmax) {
+    float dx = bmax[0] - bmin[0];
+    float dy = bmax[1] - bmin[1];
+    float dz = bmax[2] - bmin[2];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+static void push_task(BuildContext* ctx, BuildTask task) {
+    if (ctx->task_count >= ctx->task_capacity) {
+        ctx->task_capacity = ctx->task_capacity ? ctx->task_capacity * 2 : 64;
+        ctx->tasks = (BuildTask*)realloc(ctx->tasks, ctx->task_capacity * sizeof(BuildTask));
+    }
+    ctx->tasks[ctx->task_count++] = task;
+}
+
+// Object median split (quickselect on the centroid), used when binning cannot
+// separate the spheres or the tree gets too deep. Returns the split position.
+static int split_median(BuildContext* ctx, int first, int count, int axis) {
+    int* idx = ctx->indices;
+    float* c = ctx->centroids;
+    int lo = first;
+    int hi = first + count - 1;
+    int k = first + count / 2;
+
+    while (lo < hi) {
+        float pivot = c[idx[(lo + hi) / 2] * 3 + axis];
+        int i = lo;
+        int j = hi;
+        while (i <= j) {
+            while (c[idx[i] * 3 + axis] < pivot) i++;
+            while (c[idx[j] * 3 + axis] > pivot) j--;
+            if (i <= j) {
+                int t = idx[i]; idx[i] = idx[j]; idx[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
+    }
+    return k;
+}
+
+static void build_node(BuildContext* ctx, int node_index, int first, int count, int base, int depth) {
+    BVHNode* node = &ctx->nodes[node_index];
+    float cmin[3], cmax[3];
+    bounds_reset(node->min, node->max);
+    bounds_reset(cmin, cmax);
+
+    for (int i = first; i < first + count; i++) {
+        int s = ctx->indices[i];
+        float* c = &ctx->centroids[s * 3];
+        bounds_grow_sphere(node->min, node->max, &ctx->list->spheres[s]);
+        bounds_grow_bounds(cmin, cmax, c, c);
+    }
+
+    node->left_first = first;
+    node->count = count;
+    if (count == 1) return;
+
+    // Largest centroid extent, used for the median fallback
+    int widest = 0;
+    for (int a = 1; a < 3; a++) {
+        if (cmax[a] - cmin[a] > cmax[widest] - cmin[widest]) widest = a;
+    }
+    int mid = -1;
+
+    if (cmax[widest] - cmin[widest] > 0.0f && depth < BVH_MEDIAN_DEPTH) {
+        // Bin every sphere along all three axes
+        Bin bins[3][BVH_SAH_BINS];
+        float scale[3];
+        for (int a = 0; a < 3; a++) {
+            float extent = cmax[a] - cmin[a];
+            scale[a] = extent > 0.0f ? BVH_SAH_BINS / extent : 0.0f;
+            for (int b = 0; b < BVH_SAH_BINS; b++) {
+                bounds_reset(bins[a][b].min, bins[a][b].max);
+                bins[a][b].count = 0;
+            }
+        }
+
+        for (int i = first; i < first + count; i++) {
+            int s = ctx->indices[i];
+            float* c = &ctx->centroids[s * 3];
+            for (int a = 0; a < 3; a++) {
+                int b = (int)((c[a] - cmin[a]) * scale[a]);
+                if (b >= BVH_SAH_BINS) b = BVH_SAH_BINS - 1;
+                bounds_grow_sphere(bins[a][b].min, bins[a][b].max, &ctx->list->spheres[s]);
+                bins[a][b].count++;
+            }
+        }
+
+        // Sweep the split planes and keep the cheapest one
+        float best_cost = INFINITY;
+        int best_axis = -1;
+        int best_split = 0;
+        for (int a = 0; a < 3; a++) {
+            if (scale[a] == 0.0f) continue;
+
+            float left_area[BVH_SAH_BINS];
+            int left_count[BVH_SAH_BINS];
+            float lmin[3], lmax[3];
+            bounds_reset(lmin, lmax);
+            int n = 0;
+            for (int b = 0; b < BVH_SAH_BINS - 1; b++) {
+                if (bins[a][b].count) bounds_grow_bounds(lmin, lmax, bins[a][b].min, bins[a][b].max);
+                n += bins[a][b].count;
+                left_count[b] = n;
+                left_area[b] = n ? bounds_half_area(lmin, lmax) : 0.0f;
+            }
+
+            float rmin[3], rmax[3];
+            bounds_reset(rmin, rmax);
+            n = 0;
+            for (int b = BVH_SAH_BINS - 1; b > 0; b--) {
+                if (bins[a][b].count) bounds_grow_bounds(rmin, rmax, bins[a][b].min, bins[a][b].max);
+                n += bins[a][b].count;
+                if (!n || !left_count[b - 1]) continue;
+
+                float cost = left_area[b - 1] * left_count[b - 1] + bounds_half_area(rmin, rmax) * n;
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_split = b;
+                }
+            }
+        }
+
+        float node_area = bounds_half_area(node->min, node->max);
+        float split_cost = BVH_TRAVERSAL_COST + BVH_INTERSECT_COST * best_cost / node_area;
+        float leaf_cost = BVH_INTERSECT_COST * count;
+        if (count <= BVH_MAX_LEAF_SIZE && (best_axis < 0 || leaf_cost <= split_cost)) {
+            return;
+        }
+
+        if (best_axis >= 0) {
+            // Partition indices in place around the chosen plane
+            int i = first;
+            int j = first + count - 1;
+            while (i <= j) {
+                int s = ctx->indices[i];
+                int b = (int)((ctx->centroids[s * 3 + best_axis] - cmin[best_axis]) * scale[best_axis]);
+                if (b >= BVH_SAH_BINS) b = BVH_SAH_BINS - 1;
+                if (b < best_split) {
+                    i++;
+                } else {
+                    ctx->indices[i] = ctx->indices[j];
+                    ctx->indices[j--] = s;
+                }
+            }
+            mid = i;
+        }
+    } else if (count <= BVH_MAX_LEAF_SIZE) {
+        return;
+    }
+
+    if (mid <= first || mid >= first + count) {
+        mid = split_median(ctx, first, count, widest);
+    }
+
+    int left_count = mid - first;
+    int right_count = count - left_count;
+    node->left_first = base;
+    node->count = 0;
+
+    // Children sit at base and base + 1, then each child's own descendants
+    int left_base = base + 2;
+    int right_base = left_base + 2 * left_count - 2;
+
+    if (ctx->defer_below && left_count < ctx->defer_below) {
+        push_task(ctx, (BuildTask){base, first, left_count, left_base, depth + 1});
+    } else {
+        build_node(ctx, base, first, left_count, left_base, depth + 1);
+    }
+    if (ctx->defer_below && right_count < ctx->defer_below) {
+        push_task(ctx, (BuildTask){base + 1, mid, right_count, right_base, depth + 1});
+    } else {
+        build_node(ctx, base + 1, mid, right_count, right_base, depth + 1);
+    }
+}
+
+static void build_worker(void* arg, int thread_index) {
+    (void)thread_index;
+    BuildContext* ctx = (BuildContext*)arg;
+
+    while (1) {
+        int t = parallel_fetch_add(&ctx->next_task, 1);
+        if (t >= ctx->task_count) break;
+        BuildTask* task = &ctx->tasks[t];
+        build_node(ctx, task->node_index, task->first, task->count, task->base, task->depth);
+    }
+}
+
+// Copy the scratch tree depth-first into the final array so that siblings
+// stay adjacent and every subtree is contiguous
+static void compact_node(BVH* bvh, BVHNode* scratch, int src, int dst) {
+    bvh->nodes[dst] = scratch[src];
+    if (scratch[src].count > 0) return;
+
+    int children = bvh->node_count;
+    bvh->node_count += 2;
+    bvh->nodes[dst].left_first = children;
+    compact_node(bvh, scratch, scratch[src].left_first, children);
+    compact_node(bvh, scratch, scratch[src].left_first + 1, children + 1);
+}
+
+// Summed half areas of the boxes of every node but the unused slot 1
+static float tree_area(const BVH* bvh) {
+    float area = 0.0f;
+    for (int i = 0; i < bvh->node_count; i++) {
+        if (i == 1) continue;
+        area += bounds_half_area(bvh->nodes[i].min, bvh->nodes[i].max);
+    }
+    return area;
+}
+
+BVH* bvh_build(SphereList* list, int thread_count) {
+    BVH* bvh = (BVH*)malloc(sizeof(BVH));
+    int n = list->count;
+
+    bvh->index_count = n;
+    bvh->indices = (int*)malloc((n > 0 ? n : 1) * sizeof(int));
+
+    // Root at 0, slot 1 left empty so every sibling pair starts on a cache line
+    int max_nodes = (n > 0 ? 2 * n : 2) + 1;
+    bvh->node_memory = malloc((size_t)max_nodes * sizeof(BVHNode) + 64);
+    bvh->nodes = (BVHNode*)(((uintptr_t)bvh->node_memory + 63) & ~(uintptr_t)63);
+    bvh->node_count = 2;
+
+    if (n <= 0) {
+        // Empty box that no ray can enter
+        bounds_reset(bvh->nodes[0].min, bvh->nodes[0].max);
+        bvh->nodes[0].left_first = 0;
+        bvh->nodes[0].count = 0;
+        bvh->node_count = 1;
+        bvh->leaf_spheres = sphere_soa_create(1);
+        bvh->area = 0.0f;
+        return bvh;
+    }
+
+    BuildContext ctx = {0};
+    ctx.list = list;
+    ctx.indices = bvh->indices;
+    ctx.centroids = (float*)malloc((size_t)n * 3 * sizeof(float));
+    ctx.nodes = (BVHNode*)malloc(((size_t)n * 2 - 1) * sizeof(BVHNode));
+    for (int i = 0; i < n; i++) {
+        ctx.indices[i] = i;
+        ctx.centroids[i * 3 + 0] = list->spheres[i].center.x;
+        ctx.centroids[i * 3 + 1] = list->spheres[i].center.y;
+        ctx.centroids[i * 3 + 2] = list->spheres[i].center.z;
+    }
+
+    if (thread_count > 1 && n >= BVH_PARALLEL_MIN_SPHERES) {
+        // Split the top of the tree serially into roughly 8 subtrees per thread
+        ctx.defer_below = n / (thread_count * 8);
+        if (ctx.defer_below < 1024) ctx.defer_below = 1024;
+    }
+
+    build_node(&ctx, 0, 0, n, 1, 0);
+    if (ctx.task_count > 0) {
+        // Workers build their subtrees completely
+        ctx.defer_below = 0;
+        parallel_run(thread_count, build_worker, &ctx);
+    }
+
+    compact_node(bvh, ctx.nodes, 0, 0);
+
+    // Each leaf becomes one contiguous range of the SoA arrays
+    bvh->leaf_spheres = sphere_soa_create(n);
+    for (int i = 0; i < n; i++) {
+        sphere_soa_add(bvh->leaf_spheres, list->spheres[bvh->indices[i]]);
+    }
+    bvh->area = tree_area(bvh);
+
+    free(ctx.tasks);
+    free(ctx.nodes);
+    free(ctx.centroids);
+    return bvh;
+}
+
+void bvh_free(BVH* bvh) {
+    if (bvh) {
+        free(bvh->node_memory);
+        free(bvh->indices);
+        sphere_soa_free(bvh->leaf_spheres);
+        free(bvh);
+    }
+}
+
+float bvh_refit(BVH* bvh, SphereList* list) {
+    if (bvh->index_count == 0) return 0.0f;
+    for (int i = 0; i < bvh->index_count; i++) {
+        sphere_soa_set(bvh->leaf_spheres, i, list->spheres[bvh->indices[i]]);
+    }
+    
+    // Children always come after their parent (see compact_node), so one
+    // backwards sweep sees both children of a node before the node itself
+    for (int i = bvh->node_count - 1; i >= 0; i--) {
+        if (i == 1) continue;
+        BVHNode* node = &bvh->nodes[i];
+        bounds_reset(node->min, node->max);
+        if (node->count > 0) {
+            for (int k = node->left_first; k < node->left_first + node->count; k++) {
+                bounds_grow_sphere(node->min, node->max, &list->spheres[bvh->indices[k]]);
+            }
+        } else {
+            BVHNode* left = &bvh->nodes[node->left_first];
+            bounds_grow_bounds(node->min, node->max, left->min, left->max);
+            bounds_grow_bounds(node->min, node->max, (left + 1)->min, (left + 1)->max);
+        }
+    }
+    return tree_area(bvh);
+}
+
+static float min_f(float a, float b) { return a < b ? a : b; }
+static float max_f(float a, float b) { return a > b ? a : b; }
+
+// Distance at which the ray enters the node box, INFINITY if it misses
+static float node_entry(const BVHNode* node, Vec3 origin, Vec3 inv_dir, float t_min, float t_max) {
+    float tx0 = (node->min[0] - origin.x) * inv_dir.x;
+    float tx1 = (node->max[0] - origin.x) * inv_dir.x;
+    float ty0 = (node->min[1] - origin.y) * inv_dir.y;
+    float ty1 = (node->max[1] - origin.y) * inv_dir.y;
+    float tz0 = (node->min[2] - origin.z) * inv_dir.z;
+    float tz1 = (node->max[2] - origin.z) * inv_dir.z;
+
+    float near = max_f(max_f(min_f(tx0, tx1), min_f(ty0, ty1)), max_f(min_f(tz0, tz1), t_min));
+    float far = min_f(min_f(max_f(tx0, tx1), max_f(ty0, ty1)), min_f(max_f(tz0, tz1), t_max));
+    return near <= far ? near : INFINITY;
+}
+
+int bvh_hit(BVH* bvh, SphereList* list, Ray ray, float t_min, float t_max, RayHit* hit) {
+    Vec3 inv_dir = vec3_new(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    BVHNode* nodes = bvh->nodes;
+
+    int stack[BVH_STACK_SIZE];
+    float stack_dist[BVH_STACK_SIZE];
+    int sp = 0;
+
+    int best = -1;
+    float closest = t_max;
+
+    if (node_entry(&nodes[0], ray.origin, inv_dir, t_min, closest) == INFINITY) {
+        return 0;
+    }
+    int node_index = 0;
+
+    while (1) {
+        BVHNode* node = &nodes[node_index];
+
+        if (node->count > 0) {
+            float t;
+            int k = sphere_soa_hit_closest(bvh->leaf_spheres, node->left_first, node->left_first + node->count,
+                                           ray, t_min, closest, &t);
+            if (k >= 0) {
+                best = k;
+                closest = t;
+            }
+        } else {
+            // Visit the nearer child first, remember the other one
+            int near_index = node->left_first;
+            int far_index = near_index + 1;
+            float near_dist = node_entry(&nodes[near_index], ray.origin, inv_dir, t_min, closest);
+            float far_dist = node_entry(&nodes[far_index], ray.origin, inv_dir, t_min, closest);
+            if (far_dist < near_dist) {
+                int ti = near_index; near_index = far_index; far_index = ti;
+                float td = near_dist; near_dist = far_dist; far_dist = td;
+            }
+
+            if (near_dist != INFINITY) {
+                if (far_dist != INFINITY) {
+                    stack[sp] = far_index;
+                    stack_dist[sp++] = far_dist;
+                }
+                node_index = near_index;
+                continue;
+            }
+        }
+
+        // Pop the next node that can still beat the closest hit
+        node_index = -1;
+        while (sp > 0) {
+            sp--;
+            if (stack_dist[sp] <= closest) {
+                node_index = stack[sp];
+                break;
+            }
+        }
+        if (node_index < 0) break;
+    }
+
+    if (best < 0) {
+        return 0;
+    }
+    sphere_hit_record(list->spheres[bvh->indices[best]], ray, closest, hit);
+    hit->object = bvh->indices[best];
+    return 1;
+}
+
+int bvh_occluded(BVH* bvh, Ray ray, float t_min, float t_max) {
+    Vec3 inv_dir = vec3_new(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+    BVHNode* nodes = bvh->nodes;
+
+    int stack[BVH_STACK_SIZE];
+    int sp = 0;
+    if (node_entry(&nodes[0], ray.origin, inv_dir, t_min, t_max) == INFINITY) {
+        return 0;
+    }
+    stack[sp++] = 0;
+
+    // Any hit will do, so there is no closest distance to cull against;
+    // nearer children still go first, as blockers near the origin are the
+    // likelier ones
+    while (sp > 0) {
+        BVHNode* node = &nodes[stack[--sp]];
+        if (node->count > 0) {
+            if (sphere_soa_occluded(bvh->leaf_spheres, node->left_first, node->left_first + node->count,
+                                    ray, t_min, t_max)) {
+                return 1;
+            }
+            continue;
+        }
+
+        int near_index = node->left_first;
+        int far_index = near_index + 1;
+        float near_dist = node_entry(&nodes[near_index], ray.origin, inv_dir, t_min, t_max);
+        float far_dist = node_entry(&nodes[far_index], ray.origin, inv_dir, t_min, t_max);
+        if (far_dist < near_dist) {
+            int ti = near_index; near_index = far_index; far_index = ti;
+            float td = near_dist; near_dist = far_dist; far_dist = td;
+        }
+        if (far_dist != INFINITY) stack[sp++] = far_index;
+        if (near_dist != INFINITY) stack[sp++] = near_index;
+    }
+    return 0;
+}
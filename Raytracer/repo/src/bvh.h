@@ -0,0 +1,49 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "ray.h"
+#include "sphere.h"
+
+#define BVH_MAX_LEAF_SIZE 8
+#define BVH_SAH_BINS 16
+
+// Flat BVH node (32 bytes). Siblings are stored next to each other and
+// aligned so that a node pair fills exactly one 64-byte cache line.
+typedef struct {
+    float min[3];
+    int left_first;  // Interior: index of left child (right child is left_first + 1). Leaf: first entry in indices
+    float max[3];
+    int count;       // 0 for interior nodes, number of spheres for leaves
+} BVHNode;
+
+typedef struct {
+    BVHNode* nodes;
+    int node_count;
+    int* indices;     // Sphere indices into the source SphereList, in leaf order
+    int index_count;
+    SphereSoA* leaf_spheres;  // Copy of the spheres in leaf order for the SIMD kernel
+    void* node_memory;
+    float area;       // Summed half areas of the node boxes, a proxy for traversal cost
+
+} BVH;
+
+// Build a binned-SAH BVH over the spheres of list. Large lists build their
+// lower subtrees on up to thread_count threads.
+BVH* bvh_build(SphereList* list, int thread_count);
+void bvh_free(BVH* bvh);
+
+// Recompute every box after the spheres of list (the list the BVH was built
+// from, same count) moved or resized in place. The topology stays, so this
+// is one linear pass with no sorting or binning, but the tree degrades as
+// spheres drift from where they were at build time. Returns the new area;
+// compare it with the area at build time to decide when to rebuild.
+float bvh_refit(BVH* bvh, SphereList* list);
+
+// Closest hit against the spheres of list (which must be the list the BVH was built from)
+int bvh_hit(BVH* bvh, SphereList* list, Ray ray, float t_min, float t_max, RayHit* hit);
+
+// 1 if anything is hit within [t_min, t_max]. Stops at the first hit found
+// and visits children in whatever order, for shadow rays.
+int bvh_occluded(BVH* bvh, Ray ray, float t_min, float t_max);
+
+#endif
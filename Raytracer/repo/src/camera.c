@@ -0,0 +1,40 @@
+#include "camera.h"
+#include <math.h>
+
+Camera camera_create(Vec3 look_from, Vec3 look_at, Vec3 up, float vfov_degrees, float aspect) {
+    float theta = vfov_degrees * 3.14159265f / 180.0f;
+    float half_height = tanf(theta / 2.0f);
+    float half_width = aspect * half_height;
+    
+    Vec3 w = vec3_normalize(vec3_sub(look_from, look_at));
+    Vec3 u = vec3_normalize(vec3_cross(up, w));
+    Vec3 v = vec3_cross(w, u);
+    
+    Camera camera;
+    camera.origin = look_from;
+    camera.horizontal = vec3_mul(u, 2.0f * half_width);
+    camera.vertical = vec3_mul(v, 2.0f * half_height);
+    camera.lower_left = vec3_sub(vec3_sub(vec3_sub(look_from, vec3_mul(u, half_width)), vec3_mul(v, half_height)), w);
+    return camera;
+}
+
+Ray camera_get_ray(Camera* camera, float u, float v) {
+    Vec3 target = vec3_add(camera->lower_left, vec3_add(vec3_mul(camera->horizontal, u), vec3_mul(camera->vertical, v)));
+    return ray_create(camera->origin, vec3_sub(target, camera->origin));
+}
+
+CameraProjection camera_projection(Camera* camera) {
+    // A direction d reaches the image plane scaled by 1 / dot(facing, d),
+    // and (u, v) are that point's coordinates along horizontal and vertical
+    // from lower_left
+    CameraProjection p;
+    Vec3 corner = vec3_sub(camera->lower_left, camera->origin);
+    Vec3 normal = vec3_cross(camera->horizontal, camera->vertical);
+    p.origin = camera->origin;
+    p.facing = vec3_mul(normal, 1.0f / vec3_dot(corner, normal));
+    p.u_axis = vec3_mul(camera->horizontal, 1.0f / vec3_dot(camera->horizontal, camera->horizontal));
+    p.v_axis = vec3_mul(camera->vertical, 1.0f / vec3_dot(camera->vertical, camera->vertical));
+    p.u_offset = vec3_dot(corner, p.u_axis);
+    p.v_offset = vec3_dot(corner, p.v_axis);
+    return p;
+}
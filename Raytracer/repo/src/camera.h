@@ -0,0 +1,47 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "math_utils.h"
+#include "ray.h"
+
+// Pinhole camera
+typedef struct {
+    Vec3 origin;
+    Vec3 lower_left;
+    Vec3 horizontal;
+    Vec3 vertical;
+} Camera;
+
+Camera camera_create(Vec3 look_from, Vec3 look_at, Vec3 up, float vfov_degrees, float aspect);
+
+// u goes left to right and v bottom to top, both in [0, 1]
+Ray camera_get_ray(Camera* camera, float u, float v);
+
+// What camera_project needs of a camera, worked out once
+typedef struct {
+    Vec3 origin;
+    Vec3 facing;  // Normal to the image plane, scaled so dot(facing, d) == 1 on it
+    Vec3 u_axis;  // u = dot(u_axis, d) / dot(facing, d) - u_offset for d = point - origin
+    Vec3 v_axis;
+    float u_offset;
+    float v_offset;
+} CameraProjection;
+
+CameraProjection camera_projection(Camera* camera);
+
+// The (u, v) whose ray passes through point, the inverse of camera_get_ray.
+// Returns 0 for points behind the camera. Defined here so per-pixel loops
+// can inline it.
+static inline int camera_project(const CameraProjection* p, Vec3 point, float* u, float* v) {
+    float dx = point.x - p->origin.x;
+    float dy = point.y - p->origin.y;
+    float dz = point.z - p->origin.z;
+    float along = p->facing.x * dx + p->facing.y * dy + p->facing.z * dz;
+    if (along <= 0.0f) return 0;
+    float scale = 1.0f / along;
+    *u = (p->u_axis.x * dx + p->u_axis.y * dy + p->u_axis.z * dz) * scale - p->u_offset;
+    *v = (p->v_axis.x * dx + p->v_axis.y * dy + p->v_axis.z * dz) * scale - p->v_offset;
+    return 1;
+}
+
+#endif
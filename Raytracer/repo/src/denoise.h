@@ -0,0 +1,69 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "image.h"
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al.) for path traced
+// images. Each pass blurs with a 5x5 B3-spline kernel whose taps are spread
+// 2^pass pixels apart, so a few passes cover a wide footprint at 25 taps a
+// pixel each. Taps are weighted down where colour, normal, depth or albedo
+// differ from the centre pixel's, so the blur stops at edges and object
+// boundaries. Colour is divided by albedo before filtering and multiplied
+// back after, so surface colour is kept sharp and only lighting is blurred.
+
+// Pixels filtered per SIMD instruction (4 with SSE2, 1 otherwise)
+#if defined(__SSE2__)
+#define DENOISE_SIMD_WIDTH 4
+#else
+#define DENOISE_SIMD_WIDTH 1
+#endif
+
+#define DENOISE_SKY_DEPTH 1e6f  // Depth of pixels whose primary ray hits nothing
+
+// What the tracer knows about each pixel's first hit
+typedef struct {
+    int width;
+    int height;
+    // Planar, so the filter loads a vector of pixels at a time
+    float* albedo_r;  // Of the first hit's material; 1 for sky
+    float* albedo_g;
+    float* albedo_b;
+    float* normal_x;  // Of the first hit; 0 for sky
+    float* normal_y;
+    float* normal_z;
+    float* depth;     // Distance to the first hit, DENOISE_SKY_DEPTH for sky
+} DenoiseGuide;
+
+typedef struct {
+    int passes;          // Footprint is 4 * (2^passes - 1) + 1 pixels across
+    float sigma_color;   // Halved every pass, as the image gets smoother
+    float sigma_normal;  // Of the distance between unit normals
+    float sigma_depth;   // Of the depth difference relative to the centre's depth
+    float sigma_albedo;
+    int threads;         // 0 = one per CPU
+} DenoiseSettings;
+
+// Planar working copies of the image, kept between calls
+typedef struct {
+    int width;
+    int height;
+    float* plane[2][3];  // Ping-pong r, g, b
+} Denoiser;
+
+DenoiseGuide* denoise_guide_create(int width, int height);
+void denoise_guide_free(DenoiseGuide* guide);
+
+// Tuned for images of spp samples per pixel, independent or low
+// discrepancy (RenderSettings.low_discrepancy)
+DenoiseSettings denoise_settings_default(int spp, int low_discrepancy);
+
+Denoiser* denoiser_create(int width, int height);
+void denoiser_free(Denoiser* denoiser);
+
+// Filter image in place; image, guide and denoiser must all be the same size
+void denoise_image(Denoiser* denoiser, Image* image, const DenoiseGuide* guide, const DenoiseSettings* settings);
+
+// The same one pixel at a time on one thread, for reference
+void denoise_image_scalar(Denoiser* denoiser, Image* image, const DenoiseGuide* guide, const DenoiseSettings* settings);
+
+#endif
@@ -1,11 +1,13 @@
 #include "environment.h"
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 Environment* environment_create() {
     Environment* env = (Environment*)malloc(sizeof(Environment));
     env->structure_capacity = 32;
     env->structure_count = 0;
+    env->structure_revision = 0;
     env->structures = (Structure*)malloc(env->structure_capacity * sizeof(Structure));
     env->fog_density = 0.3f;
     env->time_of_day = 18.0f;  // Evening for gothic atmosphere
@@ -21,11 +23,30 @@ void environment_free(Environment* env) {
     }
 }
 
+void environment_copy(Environment* dst, const Environment* src) {
+    Structure* structures = dst->structures;
+    int capacity = dst->structure_capacity;
+    int revision = dst->structure_revision;
+    if (capacity < src->structure_count) {
+        capacity = src->structure_capacity;
+        structures = (Structure*)realloc(structures, capacity * sizeof(Structure));
+        revision = src->structure_revision - 1;
+    }
+    if (revision != src->structure_revision) {
+        memcpy(structures, src->structures, src->structure_count * sizeof(Structure));
+    }
+    
+    *dst = *src;
+    dst->structures = structures;
+    dst->structure_capacity = capacity;
+}
+
 void environment_add_structure(Environment* env, Vec3 pos, Vec3 size, ArchitectureType type) {
     if (!env || env->structure_count >= env->structure_capacity) return;
     
     Structure s = {pos, size, type, 0.0f, 0};
     env->structures[env->structure_count++] = s;
+    env->structure_revision++;
 }
 
 void environment_update(Environment* env, float delta_time) {
@@ -41,6 +62,7 @@ void environment_populate_gothic_arena(Environment* env) {
     
     // Clear existing structures
     env->structure_count = 0;
+    env->structure_revision++;
     
     // Central gothic tower
     environment_add_structure(env, vec3_new(0.0f, 0.0f, 0.0f), vec3_new(1.5f, 3.0f, 1.5f), ARCH_TOWER);
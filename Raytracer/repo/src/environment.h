@@ -26,6 +26,7 @@ typedef struct {
     Structure* structures;
     int structure_count;
     int structure_capacity;
+    int structure_revision;  // Bumped whenever structures change; bump it after editing them directly
     
     // Atmosphere parameters
     float fog_density;      // For atmospheric effects
@@ -35,6 +36,9 @@ typedef struct {
 
 Environment* environment_create();
 void environment_free(Environment* env);
+// Make dst a copy of src; the structures are only copied when their
+// revision differs, so dst must have come from a copy of src before (or be zeroed)
+void environment_copy(Environment* dst, const Environment* src);
 void environment_add_structure(Environment* env, Vec3 pos, Vec3 size, ArchitectureType type);
 void environment_update(Environment* env, float delta_time);
 void environment_populate_gothic_arena(Environment* env);
@@ -3,6 +3,13 @@
 #include <math.h>
 #include <stdio.h>
 
+// Projectiles hit enemies whose centre is within the enemy radius plus this
+#define PROJECTILE_HIT_RADIUS 0.1f
+
+// Grid cells about as wide as an enemy's hit circle and a structure
+#define ENEMY_CELL_SIZE 1.0f
+#define STRUCTURE_CELL_SIZE 2.0f
+
 GameState* game_create() {
     GameState* game = (GameState*)malloc(sizeof(GameState));
     
@@ -13,19 +20,17 @@ GameState* game_create() {
     game->player.material_id = 0;
     game->player.weapon_cooldown = 0.0f;
     
-    // Initialize enemies - larger exploration area
-    game->enemy_count = 5;
-    game->enemies = (Enemy*)malloc(game->enemy_count * sizeof(Enemy));
-    game->enemies[0] = (Enemy){vec3_new(-3.0f, 0.0f, -3.0f), 0.5f, 1, 0.0f, 0.0f};
-    game->enemies[1] = (Enemy){vec3_new(3.0f, 0.0f, -3.0f), 0.5f, 1, 0.0f, 0.0f};
-    game->enemies[2] = (Enemy){vec3_new(0.0f, 0.0f, -6.0f), 0.5f, 1, 0.0f, 0.0f};
-    game->enemies[3] = (Enemy){vec3_new(-4.0f, 0.0f, 2.0f), 0.5f, 1, 0.0f, 0.0f};
-    game->enemies[4] = (Enemy){vec3_new(4.0f, 0.0f, 2.0f), 0.5f, 1, 0.0f, 0.0f};
+    // Initialize enemies - larger exploration area. Each keeps its spawn
+    // order as its phase, so removing others never changes its motion.
+    enemy_pool_init(&game->enemies);
+    enemy_pool_spawn(&game->enemies, vec3_new(-3.0f, 0.0f, -3.0f), 0.5f, 1, 0.0f);
+    enemy_pool_spawn(&game->enemies, vec3_new(3.0f, 0.0f, -3.0f), 0.5f, 1, 1.0f);
+    enemy_pool_spawn(&game->enemies, vec3_new(0.0f, 0.0f, -6.0f), 0.5f, 1, 2.0f);
+    enemy_pool_spawn(&game->enemies, vec3_new(-4.0f, 0.0f, 2.0f), 0.5f, 1, 3.0f);
+    enemy_pool_spawn(&game->enemies, vec3_new(4.0f, 0.0f, 2.0f), 0.5f, 1, 4.0f);
     
     // Initialize projectiles
-    game->projectile_capacity = 50;
-    game->projectile_count = 0;
-    game->projectiles = (Projectile*)malloc(game->projectile_capacity * sizeof(Projectile));
+    projectile_pool_init(&game->projectiles);
     
     // Initialize gothic environment
     game->environment = environment_create();
@@ -38,19 +43,98 @@ GameState* game_create() {
     game->score = 0;
     game->time_elapsed = 0.0f;
     
+    spatial_hash_init(&game->enemy_grid, ENEMY_CELL_SIZE);
+    spatial_hash_init(&game->structure_grid, STRUCTURE_CELL_SIZE);
+    game->structure_revision = game->environment->structure_revision - 1;
+    game->scratch_capacity = 0;
+    game->boxes = NULL;
+    game->candidates = NULL;
+    
     return game;
 }
 
 void game_free(GameState* game) {
     if (game) {
-        free(game->enemies);
-        free(game->projectiles);
+        enemy_pool_free(&game->enemies);
+        projectile_pool_free(&game->projectiles);
         if (game->collectibles) free(game->collectibles);
         environment_free(game->environment);
+        spatial_hash_free(&game->enemy_grid);
+        spatial_hash_free(&game->structure_grid);
+        free(game->boxes);
+        free(game->candidates);
         free(game);
     }
 }
 
+// Make room for count boxes and query results
+static void reserve_scratch(GameState* game, int count) {
+    if (count <= game->scratch_capacity) return;
+    game->scratch_capacity = count;
+    free(game->boxes);
+    free(game->candidates);
+    game->boxes = (SpatialBox*)malloc(count * sizeof(SpatialBox));
+    game->candidates = (int*)malloc(count * sizeof(int));
+}
+
+static void build_structure_grid(GameState* game) {
+    Environment* env = game->environment;
+    reserve_scratch(game, env->structure_count);
+    for (int i = 0; i < env->structure_count; i++) {
+        Structure* s = &env->structures[i];
+        Vec3 half_size = vec3_mul(s->size, 0.5f);
+        game->boxes[i] = (SpatialBox){s->position.x - half_size.x, s->position.z - half_size.z,
+                                      s->position.x + half_size.x, s->position.z + half_size.z};
+    }
+    spatial_hash_build(&game->structure_grid, game->boxes, env->structure_count);
+    game->structure_revision = env->structure_revision;
+}
+
+void game_collide_projectiles(GameState* game) {
+    EnemyPool* enemies = &game->enemies;
+    ProjectilePool* projectiles = &game->projectiles;
+    
+    // Enemies are filed by where a projectile centre would hit them, so each
+    // projectile only looks up its own point. Enemies killed earlier in this
+    // pass are still filed and are skipped.
+    reserve_scratch(game, enemies->count);
+    for (int e = 0; e < enemies->count; e++) {
+        float reach = enemies->radius[e] + PROJECTILE_HIT_RADIUS;
+        game->boxes[e] = (SpatialBox){enemies->x[e] - reach, enemies->z[e] - reach,
+                                      enemies->x[e] + reach, enemies->z[e] + reach};
+    }
+    spatial_hash_build(&game->enemy_grid, game->boxes, enemies->count);
+    
+    for (int i = 0; i < projectiles->count; i++) {
+        SpatialBox point = {projectiles->x[i], projectiles->z[i], projectiles->x[i], projectiles->z[i]};
+        int count = spatial_hash_query(&game->enemy_grid, point, game->candidates);
+        for (int c = 0; c < count; c++) {
+            int e = game->candidates[c];
+            if (!enemies->radius[e]) continue;
+            
+            float dx = projectiles->x[i] - enemies->x[e];
+            float dy = projectiles->y[i] - enemies->y[e];
+            float dz = projectiles->z[i] - enemies->z[e];
+            float reach = enemies->radius[e] + PROJECTILE_HIT_RADIUS;
+            
+            if (dx * dx + dy * dy + dz * dz < reach * reach) {
+                projectiles->lifetime[i] = 0.0f;
+                enemies->radius[e] = 0.0f;  // Mark as dead
+                game->score += 100;
+            }
+        }
+    }
+}
+
+void game_remove_dead(GameState* game) {
+    // Walking down means whatever moves into slot i has already been checked
+    for (int i = game->enemies.count - 1; i >= 0; i--) {
+        if (game->enemies.radius[i] <= 0.0f) enemy_pool_remove(&game->enemies, i);
+    }
+    for (int i = game->projectiles.count - 1; i >= 0; i--) {
+        if (game->projectiles.lifetime[i] <= 0.0f) projectile_pool_remove(&game->projectiles, i);
+    }
+}
 
 void game_update(GameState* game, float delta_time) {
     game->time_elapsed += delta_time;
@@ -65,73 +149,39 @@ void game_update(GameState* game, float delta_time) {
         game->player.weapon_cooldown -= delta_time;
     }
     
-    // Update enemies - make them patrol/turn towards player
-    for (int i = 0; i < game->enemy_count; i++) {
-        // Bobbing animation
-        game->enemies[i].bob_offset = sinf(game->time_elapsed * 2.0f + i) * 0.2f;
-        game->enemies[i].angle = game->time_elapsed * 0.3f;
-        
-        // Simple patrol - move in circles
-        game->enemies[i].position.x += cosf(game->time_elapsed * 0.5f + i * 1.256f) * 0.3f * delta_time;
-        game->enemies[i].position.z += sinf(game->time_elapsed * 0.5f + i * 1.256f) * 0.3f * delta_time;
+    // Update enemies - make them patrol/turn towards player. Per-enemy
+    // offsets enter through the angle sum identities, e.g.
+    // cos(a + b) = cos a cos b - sin a sin b, with cos b and sin b fixed at
+    // spawn, so every loop here is plain multiply-adds over the pool.
+    EnemyPool* enemies = &game->enemies;
+    int enemy_count = enemies->count;
+    float t = game->time_elapsed;
+    
+    // Bobbing animation
+    float bob_sin = sinf(t * 2.0f) * 0.2f, bob_cos = cosf(t * 2.0f) * 0.2f;
+    for (int i = 0; i < enemy_count; i++) {
+        enemies->bob_offset[i] = bob_sin * enemies->bob_cos[i] + bob_cos * enemies->bob_sin[i];
+        enemies->angle[i] = t * 0.3f;
     }
     
-    // Update projectiles
-    for (int i = 0; i < game->projectile_count; i++) {
-        game->projectiles[i].position = vec3_add(game->projectiles[i].position,
-            vec3_mul(game->projectiles[i].velocity, delta_time));
-        game->projectiles[i].lifetime -= delta_time;
-        
-        if (game->projectiles[i].lifetime <= 0.0f) {
-            game->projectiles[i].is_active = 0;
-        }
-        
-        // Check collisions with enemies
-        for (int e = 0; e < game->enemy_count; e++) {
-            if (!game->enemies[e].radius) continue;
-            
-            Vec3 diff = vec3_sub(game->projectiles[i].position, game->enemies[e].position);
-            float dist = vec3_length(diff);
-            
-            if (dist < game->enemies[e].radius + 0.1f) {
-                game->projectiles[i].is_active = 0;
-                game->projectiles[i].lifetime = 0.0f;
-                game->enemies[e].radius = 0.0f;  // Mark as dead
-                game->score += 100;
-            }
-        }
-    }
+    // Simple patrol - move in circles
+    float step = 0.3f * delta_time;
+    float patrol_cos = cosf(t * 0.5f) * step, patrol_sin = sinf(t * 0.5f) * step;
+    pool_axpy(enemies->x, patrol_cos, enemies->patrol_cos, enemy_count);
+    pool_axpy(enemies->x, -patrol_sin, enemies->patrol_sin, enemy_count);
+    pool_axpy(enemies->z, patrol_sin, enemies->patrol_cos, enemy_count);
+    pool_axpy(enemies->z, patrol_cos, enemies->patrol_sin, enemy_count);
     
-    // Remove inactive projectiles
-    int write_idx = 0;
-    for (int i = 0; i < game->projectile_count; i++) {
-        if (game->projectiles[i].is_active) {
-            game->projectiles[write_idx++] = game->projectiles[i];
-        }
-    }
-    game->projectile_count = write_idx;
-}
-
-
-void game_populate_scene(GameState* game, Scene* scene) {
-    // Add ground
-    Sphere ground = sphere_create(vec3_new(0.0f, -1.5f, 0.0f), 5.0f, scene->material_count - 1);
-    scene_add_object(scene, ground);
-    
-    // Add player
-    Sphere player = sphere_create(game->player.position, game->player.radius, game->player.material_id);
-    scene_add_object(scene, player);
-    
-    // Add enemies
-    for (int i = 0; i < game->enemy_count; i++) {
-        if (game->enemies[i].radius <= 0.0f) continue;  // Skip dead enemies
-        
-        Vec3 enemy_pos = game->enemies[i].position;
-        enemy_pos.y += game->enemies[i].bob_offset;
-        
-        Sphere enemy = sphere_create(enemy_pos, game->enemies[i].radius, game->enemies[i].material_id);
-        scene_add_object(scene, enemy);
-    }
+    // Update projectiles
+    ProjectilePool* projectiles = &game->projectiles;
+    pool_axpy(projectiles->x, delta_time, projectiles->vx, projectiles->count);
+    pool_axpy(projectiles->y, delta_time, projectiles->vy, projectiles->count);
+    pool_axpy(projectiles->z, delta_time, projectiles->vz, projectiles->count);
+    pool_add(projectiles->lifetime, -delta_time, projectiles->count);
+    
+    // Check collisions with enemies, then drop the dead and the spent
+    game_collide_projectiles(game);
+    game_remove_dead(game);
 }
 
 
@@ -170,10 +220,16 @@ void game_handle_input(GameState* game, int key_up, int key_down, int key_left,
     if (new_pos.z > bound) new_pos.z = bound;
     if (new_pos.z < -bound) new_pos.z = -bound;
     
-    // Collision detection with environmental structures
+    // Collision detection with environmental structures near the new position
+    if (game->structure_revision != game->environment->structure_revision) {
+        build_structure_grid(game);
+    }
+    float r = game->player.radius;
+    SpatialBox reach = {new_pos.x - r, new_pos.z - r, new_pos.x + r, new_pos.z + r};
+    int count = spatial_hash_query(&game->structure_grid, reach, game->candidates);
     int collision = 0;
-    for (int i = 0; i < game->environment->structure_count; i++) {
-        Structure* s = &game->environment->structures[i];
+    for (int c = 0; c < count; c++) {
+        Structure* s = &game->environment->structures[game->candidates[c]];
         Vec3 half_size = vec3_mul(s->size, 0.5f);
         float dx = fabsf(new_pos.x - s->position.x);
         float dz = fabsf(new_pos.z - s->position.z);
@@ -189,18 +245,11 @@ void game_handle_input(GameState* game, int key_up, int key_down, int key_left,
     }
     
     // Fire weapon
-    if (fire_weapon && game->player.weapon_cooldown <= 0.0f && game->projectile_count < game->projectile_capacity) {
+    if (fire_weapon && game->player.weapon_cooldown <= 0.0f) {
         Vec3 projectile_pos = vec3_add(game->player.position, vec3_mul(game->player.direction, 0.5f));
         Vec3 projectile_vel = vec3_mul(game->player.direction, 15.0f);  // 15 units/sec
         
-        Projectile proj = (Projectile){
-            projectile_pos,
-            projectile_vel,
-            3.0f,  // 3 second lifetime
-            1
-        };
-        
-        game->projectiles[game->projectile_count++] = proj;
+        projectile_pool_spawn(&game->projectiles, projectile_pos, projectile_vel, 3.0f);  // 3 second lifetime
         game->player.weapon_cooldown = 0.2f;  // 200ms cooldown between shots
     }
 }
@@ -2,23 +2,9 @@
 #define GAME_H
 
 #include "math_utils.h"
-#include "raytracer.h"
 #include "environment.h"
-
-typedef struct {
-    Vec3 position;
-    Vec3 velocity;
-    float lifetime;
-    int is_active;
-} Projectile;
-
-typedef struct {
-    Vec3 position;
-    float radius;
-    int material_id;
-    float angle;
-    float bob_offset;
-} Enemy;
+#include "spatial.h"
+#include "pool.h"
 
 typedef struct {
     Vec3 position;
@@ -37,12 +23,8 @@ typedef struct {
 typedef struct {
     Player player;
     
-    Enemy* enemies;
-    int enemy_count;
-    
-    Projectile* projectiles;
-    int projectile_count;
-    int projectile_capacity;
+    EnemyPool enemies;          // Live enemies only; killed ones are removed
+    ProjectilePool projectiles; // Live projectiles only
     
     Environment* environment;  // Gothic environment with structures
     
@@ -51,12 +33,24 @@ typedef struct {
     
     int score;
     float time_elapsed;
+    
+    // Collision queries go through these instead of scanning every object
+    SpatialHash enemy_grid;      // Enemy hit circles, rebuilt every update
+    SpatialHash structure_grid;  // Structure footprints, rebuilt when the structures change
+    int structure_revision;      // environment->structure_revision structure_grid was built from
+    SpatialBox* boxes;           // Scratch for building the grids
+    int* candidates;             // Scratch for query results
+    int scratch_capacity;
 } GameState;
 
 GameState* game_create();
 void game_free(GameState* game);
 void game_update(GameState* game, float delta_time);
-void game_populate_scene(GameState* game, Scene* scene);
+// Kill every enemy a projectile touches and spend the projectile, marking
+// both with zero radius or lifetime; part of game_update
+void game_collide_projectiles(GameState* game);
+// Remove the enemies and projectiles marked dead; part of game_update
+void game_remove_dead(GameState* game);
 void game_handle_input(GameState* game, int key_up, int key_down, int key_left, int key_right, int fire_weapon);
 
 #endif
@@ -0,0 +1,191 @@
+#include "game_scene.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Scene materials, the first two in the order the game's material ids count them
+enum {
+    MATERIAL_PLAYER,
+    MATERIAL_ENEMY,
+    MATERIAL_PROJECTILE,
+    MATERIAL_STRUCTURE,
+    MATERIAL_GROUND
+};
+
+#define PROJECTILE_RADIUS 0.1f
+#define GROUND_RADIUS 1000.0f
+#define GROUND_LEVEL -0.5f  // Where enemies' and the player's spheres rest
+
+static void binding_init(SceneBinding* binding) {
+    binding->object = NULL;
+    binding->generation = NULL;
+    binding->capacity = 0;
+}
+
+static void binding_free(SceneBinding* binding) {
+    free(binding->object);
+    free(binding->generation);
+}
+
+static void binding_reserve(SceneBinding* binding, int slots) {
+    if (slots <= binding->capacity) return;
+    int capacity = binding->capacity ? binding->capacity : 16;
+    while (capacity < slots) capacity *= 2;
+    binding->object = (int*)realloc(binding->object, capacity * sizeof(int));
+    binding->generation = (int*)realloc(binding->generation, capacity * sizeof(int));
+    for (int slot = binding->capacity; slot < capacity; slot++) {
+        binding->object[slot] = -1;
+    }
+    binding->capacity = capacity;
+}
+
+// Hand back the objects of entities the pool no longer has
+static void unbind_removed(Scene* scene, SceneBinding* binding, const SlotMap* slots) {
+    for (int slot = 0; slot < binding->capacity; slot++) {
+        if (binding->object[slot] < 0) continue;
+        if (slot < slots->slot_count && slots->index_of[slot] >= 0 &&
+            slots->generation[slot] == binding->generation[slot]) continue;
+        scene_remove_dynamic(scene, binding->object[slot]);
+        binding->object[slot] = -1;
+    }
+}
+
+// Move the entity's object to sphere, giving it one if it has none yet
+static void bind(Scene* scene, SceneBinding* binding, EntityHandle handle, Sphere sphere) {
+    binding_reserve(binding, handle.slot + 1);
+    if (binding->object[handle.slot] < 0) {
+        binding->object[handle.slot] = scene_add_dynamic(scene, sphere);
+        binding->generation[handle.slot] = handle.generation;
+    } else {
+        scene_set_dynamic(scene, binding->object[handle.slot], sphere);
+    }
+}
+
+// Structures are boxes and the raytracer only knows spheres: fill each one
+// with overlapping spheres as wide as its narrow side, in a row along its
+// long side and stacked up to its height
+static void add_structure(Scene* scene, const Structure* structure) {
+    Vec3 size = structure->size;
+    float radius = (size.x < size.z ? size.x : size.z) * 0.5f;
+    if (radius <= 0.0f) return;
+    int along_x = size.x >= size.z;
+    float length = along_x ? size.x : size.z;
+    
+    int row = (int)((length - 2.0f * radius) / radius) + 1;
+    int stack = (int)((size.y - 2.0f * radius) / radius) + 1;
+    if (row < 1) row = 1;
+    if (stack < 1) stack = 1;
+    float row_step = row > 1 ? (length - 2.0f * radius) / (row - 1) : 0.0f;
+    float stack_step = stack > 1 ? (size.y - 2.0f * radius) / (stack - 1) : 0.0f;
+    
+    for (int i = 0; i < row; i++) {
+        float offset = -length * 0.5f + radius + i * row_step;
+        for (int j = 0; j < stack; j++) {
+            Vec3 center = structure->position;
+            center.y += radius + j * stack_step;
+            if (along_x) center.x += offset;
+            else center.z += offset;
+            scene_add_object(scene, sphere_create(center, radius, MATERIAL_STRUCTURE));
+        }
+    }
+}
+
+static void build_static(GameScene* game_scene, const Environment* env) {
+    Scene* scene = game_scene->scene;
+    scene_clear_objects(scene);
+    Vec3 ground = vec3_new(0.0f, GROUND_LEVEL - GROUND_RADIUS, 0.0f);
+    scene_add_object(scene, sphere_create(ground, GROUND_RADIUS, MATERIAL_GROUND));
+    for (int i = 0; i < env->structure_count; i++) {
+        if (!env->structures[i].is_destroyed) add_structure(scene, &env->structures[i]);
+    }
+    scene_build_bvh(scene);
+    game_scene->structure_revision = env->structure_revision;
+}
+
+GameScene* game_scene_create(int width, int height) {
+    GameScene* game_scene = (GameScene*)malloc(sizeof(GameScene));
+    Scene* scene = scene_create();
+    scene_add_material(scene, material_diffuse(vec3_new(0.1f, 0.8f, 0.1f)));
+    scene_add_material(scene, material_diffuse(vec3_new(0.8f, 0.1f, 0.1f)));
+    scene_add_material(scene, material_metal(vec3_new(1.0f, 0.8f, 0.0f), 0.1f));
+    scene_add_material(scene, material_diffuse(vec3_new(0.45f, 0.42f, 0.5f)));
+    scene_add_material(scene, material_diffuse(vec3_new(0.3f, 0.3f, 0.25f)));
+    game_scene->scene = scene;
+    game_scene->player = scene_add_dynamic(scene, sphere_create(vec3_new(0.0f, 0.0f, 0.0f), 0.0f, MATERIAL_PLAYER));
+    binding_init(&game_scene->enemies);
+    binding_init(&game_scene->projectiles);
+    game_scene->structure_revision = -1;
+    
+    // The whole arena from above and in front, as the top-down view frames it
+    game_scene->image = image_create(width, height);
+    game_scene->temporal = temporal_create(width, height);
+    game_scene->row = (uint8_t*)malloc(width * 3);
+    game_scene->settings = render_settings_default();
+    game_scene->settings.spp = 1;
+    game_scene->settings.max_depth = 3;
+    game_scene->camera = camera_create(vec3_new(0.0f, 11.0f, 9.0f), vec3_new(0.0f, 0.0f, 0.5f),
+                                       vec3_new(0.0f, 1.0f, 0.0f), 50.0f, (float)width / height);
+    return game_scene;
+}
+
+void game_scene_free(GameScene* game_scene) {
+    if (game_scene) {
+        scene_free(game_scene->scene);
+        binding_free(&game_scene->enemies);
+        binding_free(&game_scene->projectiles);
+        image_free(game_scene->image);
+        temporal_free(game_scene->temporal);
+        free(game_scene->row);
+        free(game_scene);
+    }
+}
+
+void game_scene_sync(GameScene* game_scene, const Player* player, const EnemyPool* enemies,
+                     const ProjectilePool* projectiles, const Environment* env) {
+    Scene* scene = game_scene->scene;
+    if (game_scene->structure_revision != env->structure_revision) {
+        build_static(game_scene, env);
+    }
+    
+    scene_set_dynamic(scene, game_scene->player, sphere_create(player->position, player->radius, player->material_id));
+    
+    unbind_removed(scene, &game_scene->enemies, &enemies->slots);
+    for (int i = 0; i < enemies->count; i++) {
+        Vec3 center = enemy_pool_position(enemies, i);
+        center.y += enemies->bob_offset[i];
+        Sphere sphere = sphere_create(center, enemies->radius[i], enemies->material_id[i]);
+        bind(scene, &game_scene->enemies, enemy_pool_handle(enemies, i), sphere);
+    }
+    
+    unbind_removed(scene, &game_scene->projectiles, &projectiles->slots);
+    for (int i = 0; i < projectiles->count; i++) {
+        Sphere sphere = sphere_create(projectile_pool_position(projectiles, i), PROJECTILE_RADIUS, MATERIAL_PROJECTILE);
+        bind(scene, &game_scene->projectiles, projectile_pool_handle(projectiles, i), sphere);
+    }
+    
+    scene_refit(scene);
+}
+
+void game_populate_scene(GameState* game, GameScene* game_scene) {
+    game_scene_sync(game_scene, &game->player, &game->enemies, &game->projectiles, game->environment);
+}
+
+void game_scene_render(GameScene* game_scene, uint32_t* pixels, int width, int height) {
+    Image* image = game_scene->image;
+    render_temporal(game_scene->scene, &game_scene->camera, image, game_scene->temporal, &game_scene->settings, NULL);
+    
+    // Nearest-neighbour scale up, converting each traced row once
+    uint8_t* row = game_scene->row;
+    int source_row = -1;
+    for (int y = 0; y < height; y++) {
+        int sy = y * image->height / height;
+        if (sy != source_row) {
+            image_convert_rgb8(&image->pixels[sy * image->width], image->width, row);
+            source_row = sy;
+        }
+        uint32_t* out = &pixels[y * width];
+        for (int x = 0; x < width; x++) {
+            const uint8_t* c = &row[(x * image->width / width) * 3];
+            out[x] = ((uint32_t)c[0] << 16) | ((uint32_t)c[1] << 8) | c[2];
+        }
+    }
+}
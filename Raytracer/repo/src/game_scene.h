@@ -0,0 +1,48 @@
+#ifndef GAME_SCENE_H
+#define GAME_SCENE_H
+
+#include <stdint.h>
+#include "game.h"
+#include "scene_render.h"
+
+// The game as a raytracing Scene kept from frame to frame. Ground and
+// structures are static objects in a tree built once per structure
+// revision; the player, enemies and projectiles are dynamic objects moved
+// in place and refit every sync. Entities find their objects through their
+// pool slots, so swap-removal reordering a pool moves nothing in the scene.
+
+typedef struct {
+    int* object;      // Per pool slot: scene handle, -1 = none
+    int* generation;  // Generation of the entity that object belongs to
+    int capacity;
+} SceneBinding;
+
+typedef struct {
+    Scene* scene;
+    int player;               // Scene handle
+    SceneBinding enemies;
+    SceneBinding projectiles;
+    int structure_revision;   // Of the structures in the static tree, -1 = none yet
+
+    Image* image;             // Traced at this size, then scaled up to the frame
+    TemporalBuffer* temporal; // Frames are 1 spp, accumulated over time
+    uint8_t* row;             // One traced row converted to 8-bit RGB, for the scale up
+    RenderSettings settings;
+    Camera camera;
+} GameScene;
+
+// Frames are traced at width x height
+GameScene* game_scene_create(int width, int height);
+void game_scene_free(GameScene* game_scene);
+
+// Bring the scene up to date with these, e.g. from a GameSnapshot
+void game_scene_sync(GameScene* game_scene, const Player* player, const EnemyPool* enemies,
+                     const ProjectilePool* projectiles, const Environment* env);
+
+// game_scene_sync from a live game
+void game_populate_scene(GameState* game, GameScene* game_scene);
+
+// Trace a frame and scale it up into pixels (0xRRGGBB, width x height)
+void game_scene_render(GameScene* game_scene, uint32_t* pixels, int width, int height);
+
+#endif
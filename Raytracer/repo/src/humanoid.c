@@ -37,7 +37,7 @@ void humanoid_compute_parts(Humanoid* h) {
     h->torso_pos = h->position;
     
     // Walking animation - legs swing back and forth
-    float walk_cycle = sinf(h->animation_time * 4.0f);  // Faster animation
+    float walk_cycle = sinf(h->animation_time * HUMANOID_WALK_RATE);  // Faster animation
     float walk_amplitude = 0.1f;
     
     // Left leg swings forward when right leg is back
@@ -3,6 +3,10 @@
 
 #include "math_utils.h"
 
+// Walk cycle rate in radians per second of animation_time; poses repeat
+// every 2 pi / HUMANOID_WALK_RATE seconds
+#define HUMANOID_WALK_RATE 4.0f
+
 // Humanoid body parts
 typedef struct {
     Vec3 head_pos;
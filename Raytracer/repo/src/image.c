@@ -1,6 +1,11 @@
 #include "image.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 Image* image_create(int width, int height) {
     Image* img = (Image*)malloc(sizeof(Image));
@@ -38,36 +43,179 @@ void image_clear(Image* img, Color color) {
     }
 }
 
-int image_write_ppm(Image* img, const char* filename) {
+void image_convert_rgb8(const Color* src, int count, uint8_t* dst) {
+    // A run of Colors is one flat array of floats, converted 16 at a time
+    const float* in = (const float*)src;
+    int n = count * 3;
+    int i = 0;
+    
+#if defined(__SSE2__)
+    __m128 scale = _mm_set1_ps(255.0f);
+    __m128 zero = _mm_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        __m128i a = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), zero), scale));
+        __m128i b = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), zero), scale));
+        __m128i c = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 8), scale), zero), scale));
+        __m128i d = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 12), scale), zero), scale));
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i*)(dst + i), bytes);
+    }
+#endif
+    
+    for (; i < n; i++) {
+        int v = (int)(in[i] * 255.0f);
+        dst[i] = (uint8_t)(v > 255 ? 255 : (v < 0 ? 0 : v));
+    }
+}
+
+// Write the whole file with one unbuffered fwrite, i.e. a single write call
+// for the pixel data instead of one stdio call per pixel
+static int write_file(const char* filename, const uint8_t* data, size_t size) {
     FILE* file = fopen(filename, "wb");
     if (!file) {
         return 0;
     }
+    setvbuf(file, NULL, _IONBF, 0);
+    size_t written = fwrite(data, 1, size, file);
+    return (fclose(file) == 0) && written == size;
+}
+
+// Append v in decimal, v in [0, 255]
+static char* write_byte_text(char* out, int v) {
+    if (v >= 100) {
+        *out++ = (char)('0' + v / 100);
+        *out++ = (char)('0' + v / 10 % 10);
+    } else if (v >= 10) {
+        *out++ = (char)('0' + v / 10);
+    }
+    *out++ = (char)('0' + v % 10);
+    return out;
+}
+
+int image_write_ppm(Image* img, const char* filename) {
+    // Same text as the old fprintf writer: "r g b " per pixel and a newline
+    // after every fifth pixel of a row
+    size_t row_bytes = (size_t)img->width * 3;
+    size_t capacity = 64 + (size_t)img->height * (row_bytes * 4 + img->width / 5 + 1);
+    char* buffer = (char*)malloc(capacity);
+    uint8_t* row = (uint8_t*)malloc(row_bytes + 16);
+    if (!buffer || !row) {
+        free(buffer);
+        free(row);
+        return 0;
+    }
     
-    // PPM header
-    fprintf(file, "P3\n");
-    fprintf(file, "%d %d\n", img->width, img->height);
-    fprintf(file, "255\n");
-    
-    // Pixel data
+    char* out = buffer + sprintf(buffer, "P3\n%d %d\n255\n", img->width, img->height);
     for (int y = 0; y < img->height; y++) {
+        image_convert_rgb8(&img->pixels[y * img->width], img->width, row);
         for (int x = 0; x < img->width; x++) {
-            Color c = image_get_pixel(img, x, y);
-            int r = (int)(c.r * 255.0f);
-            int g = (int)(c.g * 255.0f);
-            int b = (int)(c.b * 255.0f);
-            
-            r = r > 255 ? 255 : (r < 0 ? 0 : r);
-            g = g > 255 ? 255 : (g < 0 ? 0 : g);
-            b = b > 255 ? 255 : (b < 0 ? 0 : b);
-            
-            fprintf(file, "%d %d %d ", r, g, b);
+            for (int c = 0; c < 3; c++) {
+                out = write_byte_text(out, row[x * 3 + c]);
+                *out++ = ' ';
+            }
             if ((x + 1) % 5 == 0) {
-                fprintf(file, "\n");
+                *out++ = '\n';
             }
         }
     }
     
-    fclose(file);
-    return 1;
+    int ok = write_file(filename, (uint8_t*)buffer, (size_t)(out - buffer));
+    free(row);
+    free(buffer);
+    return ok;
+}
+
+int image_write_ppm_binary(Image* img, const char* filename) {
+    char header[64];
+    int header_size = sprintf(header, "P6\n%d %d\n255\n", img->width, img->height);
+    size_t data_size = (size_t)img->width * img->height * 3;
+    uint8_t* buffer = (uint8_t*)malloc(header_size + data_size);
+    if (!buffer) {
+        return 0;
+    }
+    
+    // Rows are contiguous in both layouts, so the image converts in one go
+    memcpy(buffer, header, header_size);
+    image_convert_rgb8(img->pixels, img->width * img->height, buffer + header_size);
+    
+    int ok = write_file(filename, buffer, header_size + data_size);
+    free(buffer);
+    return ok;
+}
+
+// BMP file header structures
+#pragma pack(push, 1)
+typedef struct {
+    unsigned short signature;
+    unsigned int file_size;
+    unsigned short reserved1;
+    unsigned short reserved2;
+    unsigned int data_offset;
+} BMPFileHeader;
+
+typedef struct {
+    unsigned int header_size;
+    int width;
+    int height;
+    unsigned short planes;
+    unsigned short bits_per_pixel;
+    unsigned int compression;
+    unsigned int image_size;
+    int x_pixels_per_meter;
+    int y_pixels_per_meter;
+    unsigned int num_colors;
+    unsigned int important_colors;
+} BMPInfoHeader;
+#pragma pack(pop)
+
+int image_write_bmp(Image* img, const char* filename) {
+    // Rows are padded to a multiple of 4 bytes
+    size_t row_bytes = ((size_t)img->width * 3 + 3) & ~(size_t)3;
+    size_t data_offset = sizeof(BMPFileHeader) + sizeof(BMPInfoHeader);
+    size_t data_size = row_bytes * img->height;
+    uint8_t* buffer = (uint8_t*)calloc(data_offset + data_size, 1);
+    if (!buffer) {
+        return 0;
+    }
+    
+    BMPFileHeader file_header;
+    BMPInfoHeader info_header;
+    
+    // File header
+    file_header.signature = 0x4D42; // "BM"
+    file_header.reserved1 = 0;
+    file_header.reserved2 = 0;
+    file_header.data_offset = (unsigned int)data_offset;
+    file_header.file_size = (unsigned int)(data_offset + data_size);
+    
+    // Info header
+    info_header.header_size = sizeof(BMPInfoHeader);
+    info_header.width = img->width;
+    info_header.height = -img->height; // Negative for top-down
+    info_header.planes = 1;
+    info_header.bits_per_pixel = 24;
+    info_header.compression = 0;
+    info_header.image_size = (unsigned int)data_size;
+    info_header.x_pixels_per_meter = 2835;
+    info_header.y_pixels_per_meter = 2835;
+    info_header.num_colors = 0;
+    info_header.important_colors = 0;
+    
+    memcpy(buffer, &file_header, sizeof(BMPFileHeader));
+    memcpy(buffer + sizeof(BMPFileHeader), &info_header, sizeof(BMPInfoHeader));
+    
+    // Convert each row to RGB, then swap to the BGR order BMP stores
+    for (int y = 0; y < img->height; y++) {
+        uint8_t* row = buffer + data_offset + y * row_bytes;
+        image_convert_rgb8(&img->pixels[y * img->width], img->width, row);
+        for (int x = 0; x < img->width; x++) {
+            uint8_t r = row[x * 3];
+            row[x * 3] = row[x * 3 + 2];
+            row[x * 3 + 2] = r;
+        }
+    }
+    
+    int ok = write_file(filename, buffer, data_offset + data_size);
+    free(buffer);
+    return ok;
 }
@@ -15,6 +15,14 @@ void image_free(Image* img);
 void image_set_pixel(Image* img, int x, int y, Color color);
 Color image_get_pixel(Image* img, int x, int y);
 void image_clear(Image* img, Color color);
-int image_write_ppm(Image* img, const char* filename);
+
+// Convert count pixels to 8-bit RGB (clamped, truncated like (int)(c * 255))
+void image_convert_rgb8(const Color* src, int count, uint8_t* dst);
+
+// File writers: each converts the whole image into one buffer and writes it
+// at once. Return 1 on success, 0 on failure.
+int image_write_ppm(Image* img, const char* filename);         // ASCII P3
+int image_write_ppm_binary(Image* img, const char* filename);  // Binary P6
+int image_write_bmp(Image* img, const char* filename);         // 24-bit, top-down
 
 #endif
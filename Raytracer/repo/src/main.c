@@ -1,64 +1,143 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <windows.h>
+#include <string.h>
 #include <time.h>
-#include "window.h"
+#include "platform.h"
+#include "timer.h"
 #include "renderer.h"
 #include "game.h"
 #include "math_utils.h"
 #include "humanoid.h"
+#include "simulation.h"
+#include "parallel.h"
+#include "game_scene.h"
 
 #define GAME_WIDTH 1024
 #define GAME_HEIGHT 768
 #define TARGET_FPS 60
+#define RAYTRACE_SCALE 4  // --raytrace traces at 1/RAYTRACE_SCALE of the window size
 
-int main() {
-    srand(time(NULL));
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --headless          Run without a window (default where no window backend exists)\n");
+    printf("  --frames N          Headless: quit after N frames\n");
+    printf("  --script FILE       Headless: read input from FILE (see platform_headless.c)\n");
+    printf("  --dump PATTERN      Headless: write frames to PATTERN, e.g. frame_%%04d.ppm (one int conversion)\n");
+    printf("  --dump-every N      Headless: only write every Nth frame\n");
+    printf("  --fixed-dt SECONDS  Headless: advance time by a fixed step per frame, and tick by it\n");
+    printf("  --serial            Run the simulation on the render thread\n");
+    printf("  --raytrace          Draw frames with the raytracer instead of the rasterizer\n");
+}
+
+// Returns 0 and prints usage on a bad command line
+static int parse_args(int argc, char** argv, PlatformConfig* config, int* serial, int* raytrace) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        
+        if (strcmp(arg, "--headless") == 0) {
+            config->backend = "headless";
+            continue;
+        }
+        if (strcmp(arg, "--serial") == 0) {
+            *serial = 1;
+            continue;
+        }
+        if (strcmp(arg, "--raytrace") == 0) {
+            *raytrace = 1;
+            continue;
+        }
+        if (!value) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        
+        if (strcmp(arg, "--frames") == 0) {
+            config->frames = atoi(value);
+        } else if (strcmp(arg, "--script") == 0) {
+            config->script = value;
+        } else if (strcmp(arg, "--dump") == 0) {
+            if (!platform_dump_pattern_valid(value)) {
+                print_usage(argv[0]);
+                return 0;
+            }
+            config->dump_path = value;
+        } else if (strcmp(arg, "--dump-every") == 0) {
+            config->dump_every = atoi(value);
+        } else if (strcmp(arg, "--fixed-dt") == 0) {
+            config->fixed_dt = (float)atof(value);
+        } else {
+            print_usage(argv[0]);
+            return 0;
+        }
+        i++;
+    }
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    random_seed((unsigned int)time(NULL));
+    
+    PlatformConfig config = platform_config_default(GAME_WIDTH, GAME_HEIGHT, "Ray Tracer Game");
+    int serial = 0;
+    int raytrace = 0;
+    if (!parse_args(argc, argv, &config, &serial, &raytrace)) {
+        return 1;
+    }
     
     printf("Ray Tracer Game - Real-time Version\n");
     printf("Resolution: %dx%d\n", GAME_WIDTH, GAME_HEIGHT);
     printf("Controls: ZQSD or WASD to move, SPACE to fire, ESC to quit\n");
     
-    // Create window
-    GameWindow* window = window_create(GAME_WIDTH, GAME_HEIGHT, "Ray Tracer Game");
-    if (!window) {
+    // Create window (or headless stand-in)
+    Platform* platform = platform_create(&config);
+    if (!platform) {
         printf("Failed to create window\n");
         return 1;
     }
+    printf("Platform: %s\n", platform->backend->name);
     
     // Create renderer
     Renderer* renderer = renderer_create(GAME_WIDTH, GAME_HEIGHT);
     if (!renderer) {
         printf("Failed to create renderer\n");
-        window_free(window);
+        platform_free(platform);
         return 1;
     }
     
-    // Create game
+    // Create game. Ticks are a fixed 1/60 s, the step game_handle_input
+    // assumes, or the headless fixed step so scripted runs tick once a frame.
     GameState* game = game_create();
+    float tick_dt = config.fixed_dt > 0.0f ? config.fixed_dt : 1.0f / TARGET_FPS;
+    Simulation* simulation = simulation_create(game, tick_dt, !serial && parallel_cpu_count() > 1);
+    printf("Simulation: %s\n", simulation->thread ? "own thread" : "render thread");
+    GameSnapshot frame;
+    snapshot_init(&frame);
+    GameScene* game_scene = NULL;
+    if (raytrace) {
+        game_scene = game_scene_create(GAME_WIDTH / RAYTRACE_SCALE, GAME_HEIGHT / RAYTRACE_SCALE);
+    }
     
     // Camera setup (top-down view centered on player)
     Vec3 camera_pos = vec3_new(0.0f, 3.0f, 0.0f);
     Vec3 camera_dir = vec3_new(0.0f, -1.0f, 0.0f);
     
     // Frame timing
-    LARGE_INTEGER frequency, last_count;
-    QueryPerformanceFrequency(&frequency);
-    QueryPerformanceCounter(&last_count);
-    
-    float frame_time = 1.0f / TARGET_FPS;
+    double wall_start = timer_seconds();
+    double last_time = platform_time(platform);
     int frame_count = 0;
+    int total_frames = 0;
     float elapsed_time = 0.0f;
+    double tick_time = 0.0;  // Time passed that no tick has been queued for yet
     
     printf("\nGame started! Humanoid combat arena. Destroy enemies to gain points!\n");
     
     // Main game loop
-    while (window_is_open(window)) {
+    while (platform_is_open(platform)) {
         // Calculate delta time
-        LARGE_INTEGER current_count;
-        QueryPerformanceCounter(&current_count);
-        float delta_time = (float)(current_count.QuadPart - last_count.QuadPart) / frequency.QuadPart;
-        last_count = current_count;
+        double current_time = platform_time(platform);
+        float delta_time = (float)(current_time - last_time);
+        last_time = current_time;
         
         if (delta_time > 0.05f) delta_time = 0.05f;  // Cap delta time
         
@@ -66,45 +145,69 @@ int main() {
         frame_count++;
         
         // Update window events
-        window_update(window);
+        platform_poll(platform);
+        if (!platform_is_open(platform)) {
+            break;
+        }
         
-        // Handle input (ZQSD or WASD)
-        int key_up = window_key_pressed(window, 'Z') || window_key_pressed(window, 'W');
-        int key_down = window_key_pressed(window, 'S');
-        int key_left = window_key_pressed(window, 'Q') || window_key_pressed(window, 'A');
-        int key_right = window_key_pressed(window, 'D');
-        int fire_weapon = window_key_pressed(window, VK_SPACE);
+        // Handle input
+        int key_up = platform_key_down(platform, PLATFORM_KEY_UP);
+        int key_down = platform_key_down(platform, PLATFORM_KEY_DOWN);
+        int key_left = platform_key_down(platform, PLATFORM_KEY_LEFT);
+        int key_right = platform_key_down(platform, PLATFORM_KEY_RIGHT);
+        int fire_weapon = platform_key_down(platform, PLATFORM_KEY_FIRE);
         
-        if (window_key_pressed(window, VK_ESCAPE)) {
+        if (platform_key_down(platform, PLATFORM_KEY_QUIT)) {
             break;
         }
         
-        // Update game
-        game_handle_input(game, key_up, key_down, key_left, key_right, fire_weapon);
-        game_update(game, delta_time);
+        // Queue the ticks that are due with this frame's input; they run on
+        // the simulation thread while this one draws. The slack absorbs
+        // rounding when the clock steps by exactly one tick a frame.
+        GameInput input = {key_up, key_down, key_left, key_right, fire_weapon};
+        tick_time += delta_time;
+        while (tick_time >= tick_dt * 0.9999) {
+            simulation_queue(simulation, input);
+            tick_time -= tick_dt;
+        }
+        if (tick_time < 0.0) tick_time = 0.0;
         
-        // Render
-        renderer_clear(renderer, 0x000000);  // Black background (overwritten by sky)
-        renderer_draw_game(renderer, game, game->environment, camera_pos, camera_dir);
-        window_draw_frame(window, renderer->framebuffer);
+        // Render the newest snapshots, interpolated
+        simulation_frame(simulation, &frame, (float)(tick_time / tick_dt));
+        if (game_scene) {
+            game_scene_sync(game_scene, &frame.player, &frame.enemies, &frame.projectiles, &frame.environment);
+            game_scene_render(game_scene, renderer->framebuffer, GAME_WIDTH, GAME_HEIGHT);
+        } else {
+            renderer_draw_snapshot(renderer, &frame, camera_pos, camera_dir);
+        }
+        platform_present(platform, renderer->framebuffer);
+        total_frames++;
         
         // Display stats every second
         if (elapsed_time >= 1.0f) {
             printf("FPS: %d | Score: %d | Pos: (%.1f, %.1f, %.1f) | Enemies: %d | Projectiles: %d\n",
-                   frame_count, game->score,
-                   game->player.position.x, game->player.position.y, game->player.position.z,
-                   game->enemy_count, game->projectile_count);
+                   frame_count, frame.score,
+                   frame.player.position.x, frame.player.position.y, frame.player.position.z,
+                   frame.enemies.count, frame.projectiles.count);
             elapsed_time = 0.0f;
             frame_count = 0;
         }
     }
     
+    // Let the simulation finish what was queued before reading the game
+    simulation_free(simulation);
+    snapshot_free(&frame);
     printf("Game closed. Final score: %d\n", game->score);
+    double total_time = timer_seconds() - wall_start;
+    if (total_frames > 0) {
+        printf("%d frames in %.3f s, %.3f ms per frame\n", total_frames, total_time, total_time * 1000.0 / total_frames);
+    }
     
     // Cleanup
+    game_scene_free(game_scene);
     game_free(game);
     renderer_free(renderer);
-    window_free(window);
+    platform_free(platform);
     
     return 0;
 }
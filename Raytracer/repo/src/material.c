@@ -5,7 +5,8 @@ Material material_diffuse(Vec3 albedo) {
         .type = MAT_DIFFUSE,
         .albedo = albedo,
         .roughness = 1.0f,
-        .ior = 1.0f
+        .ior = 1.0f,
+        .emission = (Vec3){0.0f, 0.0f, 0.0f}
     };
 }
 
@@ -14,7 +15,8 @@ Material material_metal(Vec3 albedo, float roughness) {
         .type = MAT_METAL,
         .albedo = albedo,
         .roughness = roughness,
-        .ior = 1.0f
+        .ior = 1.0f,
+        .emission = (Vec3){0.0f, 0.0f, 0.0f}
     };
 }
 
@@ -23,6 +25,18 @@ Material material_dielectric(float ior) {
         .type = MAT_DIELECTRIC,
         .albedo = (Vec3){1.0f, 1.0f, 1.0f},
         .roughness = 0.0f,
-        .ior = ior
+        .ior = ior,
+        .emission = (Vec3){0.0f, 0.0f, 0.0f}
+    };
+}
+
+Material material_emissive(Vec3 emission) {
+    // White albedo, so albedo-guided filters see the emission as lighting
+    return (Material){
+        .type = MAT_EMISSIVE,
+        .albedo = (Vec3){1.0f, 1.0f, 1.0f},
+        .roughness = 1.0f,
+        .ior = 1.0f,
+        .emission = emission
     };
 }
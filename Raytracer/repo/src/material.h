@@ -6,7 +6,8 @@
 typedef enum {
     MAT_DIFFUSE,
     MAT_METAL,
-    MAT_DIELECTRIC
+    MAT_DIELECTRIC,
+    MAT_EMISSIVE  // Gives off emission and reflects nothing
 } MaterialType;
 
 typedef struct {
@@ -14,10 +15,12 @@ typedef struct {
     Vec3 albedo;
     float roughness;
     float ior;  // index of refraction for dielectrics
+    Vec3 emission;  // Radiance given off, zero unless emissive
 } Material;
 
 Material material_diffuse(Vec3 albedo);
 Material material_metal(Vec3 albedo, float roughness);
 Material material_dielectric(float ior);
+Material material_emissive(Vec3 emission);
 
 #endif
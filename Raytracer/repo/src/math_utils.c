@@ -1,5 +1,8 @@
 #include "math_utils.h"
-#include <stdlib.h>
+
+// Default generator for code that does not carry its own Rng. Each thread
+// owns its state: no shared state, no locking.
+static __thread Rng random_state = {{0x9e3779b9u, 0x243f6a88u, 0xb7e15162u, 0x2545f491u}, 0, 0, 0};
 
 Vec3 vec3_new(float x, float y, float z) {
     return (Vec3){x, y, z};
@@ -41,10 +44,80 @@ Vec3 vec3_cross(Vec3 a, Vec3 b) {
     );
 }
 
+void random_seed(unsigned int seed) {
+    rng_seed_value(&random_state, seed);
+}
+
 float random_float() {
-    return (float)rand() / (float)RAND_MAX;
+    return rng_float(&random_state);
 }
 
 float random_float_range(float min, float max) {
-    return min + (max - min) * random_float();
+    return rng_float_range(&random_state, min, max);
+}
+
+#define PI 3.14159265f
+
+void sincos_turns(float turns, float* s, float* c) {
+    // Half of 2 pi turns - pi lies in [-pi/2, pi/2), where short Taylor
+    // series hold to about 1e-7, and double angle formulas give the whole
+    // angle to within 1e-6. No branches, and cheaper than sinf plus cosf.
+    float x = PI * turns - 0.5f * PI;
+    float x2 = x * x;
+    float sh = x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f +
+               x2 * (1.0f / 362880.0f + x2 * (-1.0f / 39916800.0f))))));
+    float ch = 1.0f + x2 * (-0.5f + x2 * (1.0f / 24.0f + x2 * (-1.0f / 720.0f + x2 * (1.0f / 40320.0f +
+               x2 * (-1.0f / 3628800.0f + x2 * (1.0f / 479001600.0f))))));
+    // The angle is 2x + pi
+    *s = -2.0f * sh * ch;
+    *c = sh * sh - ch * ch;
+}
+
+Vec3 vec3_sphere_direction(float u, float v) {
+    // z uniform in [-1, 1] makes the area uniform (Archimedes)
+    float z = 1.0f - 2.0f * u;
+    float r = sqrtf(fmaxf(0.0f, 1.0f - z * z));
+    float s, c;
+    sincos_turns(v, &s, &c);
+    return vec3_new(r * c, r * s, z);
+}
+
+Vec3 vec3_in_unit_sphere(float u, float v, float w) {
+    // The cube root spreads radii so the volume is uniform
+    return vec3_mul(vec3_sphere_direction(u, v), cbrtf(w));
+}
+
+void vec3_basis(Vec3 n, Vec3* t, Vec3* b) {
+    // Duff et al., "Building an Orthonormal Basis, Revisited": no branch on
+    // which axis n is closest to, only on its sign
+    float sign = copysignf(1.0f, n.z);
+    float a = -1.0f / (sign + n.z);
+    float c = n.x * n.y * a;
+    *t = vec3_new(1.0f + sign * n.x * n.x * a, sign * c, -sign * n.x);
+    *b = vec3_new(c, sign + n.y * n.y * a, -n.y);
+}
+
+Vec3 vec3_cosine_direction(Vec3 normal, float u, float v) {
+    // Uniform on the disc, lifted onto the hemisphere (Malley's method)
+    Vec3 t, b;
+    vec3_basis(normal, &t, &b);
+    float r = sqrtf(u);
+    float s, c;
+    sincos_turns(v, &s, &c);
+    float x = r * c;
+    float y = r * s;
+    float z = sqrtf(fmaxf(0.0f, 1.0f - u));
+    return vec3_new(t.x * x + b.x * y + normal.x * z, t.y * x + b.y * y + normal.y * z,
+                    t.z * x + b.z * y + normal.z * z);
+}
+
+Vec3 vec3_random_in_unit_sphere(Rng* rng) {
+    float u = rng_float(rng);
+    float v = rng_float(rng);
+    return vec3_in_unit_sphere(u, v, rng_float(rng));
+}
+
+Vec3 vec3_random_unit_vector(Rng* rng) {
+    float u = rng_float(rng);
+    return vec3_sphere_direction(u, rng_float(rng));
 }
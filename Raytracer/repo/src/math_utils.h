@@ -2,6 +2,7 @@
 #define MATH_UTILS_H
 
 #include <math.h>
+#include "rng.h"
 
 typedef struct {
     float x, y, z;
@@ -21,8 +22,26 @@ float vec3_length(Vec3 v);
 Vec3 vec3_normalize(Vec3 v);
 Vec3 vec3_cross(Vec3 a, Vec3 b);
 
-// Random utilities
+// Random utilities on a per-thread default generator (see random_seed)
+void random_seed(unsigned int seed);
 float random_float();
 float random_float_range(float min, float max);
 
+// Closed-form warps of numbers uniform in [0, 1) onto directions and
+// points, so samplers need no rejection loops and keep the stratification
+// of low-discrepancy inputs
+Vec3 vec3_sphere_direction(float u, float v);               // Uniform on the unit sphere
+Vec3 vec3_in_unit_sphere(float u, float v, float w);        // Uniform in the unit ball
+Vec3 vec3_cosine_direction(Vec3 normal, float u, float v);  // Cosine-weighted around a unit normal
+
+// Unit t and b perpendicular to unit n and each other
+void vec3_basis(Vec3 n, Vec3* t, Vec3* b);
+
+// sin and cos of 2 pi turns for turns in [0, 1), to within 1e-6, without libm
+void sincos_turns(float turns, float* s, float* c);
+
+// Random directions drawn from an explicit generator (see rng.h)
+Vec3 vec3_random_in_unit_sphere(Rng* rng);
+Vec3 vec3_random_unit_vector(Rng* rng);
+
 #endif
@@ -0,0 +1,295 @@
+#include "packet.h"
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define PACKET_STACK_SIZE 128
+#define PACKET_GROUPS (RAY_PACKET_MAX / 4)
+
+// Bounds of the packet origins and inverse directions. Only usable when
+// every ray has the same direction sign on each axis.
+typedef struct {
+    float origin_lo[3];
+    float origin_hi[3];
+    float inv_lo[3];
+    float inv_hi[3];
+    int valid;
+} PacketInterval;
+
+void ray_packet_init(RayPacket* packet, const Ray* rays, int count) {
+    if (count > RAY_PACKET_MAX) count = RAY_PACKET_MAX;
+    packet->count = count;
+
+    for (int k = 0; k < RAY_PACKET_MAX; k++) {
+        Ray ray = rays[k < count ? k : 0];
+        packet->origin_x[k] = ray.origin.x;
+        packet->origin_y[k] = ray.origin.y;
+        packet->origin_z[k] = ray.origin.z;
+        packet->dir_x[k] = ray.direction.x;
+        packet->dir_y[k] = ray.direction.y;
+        packet->dir_z[k] = ray.direction.z;
+        packet->inv_x[k] = 1.0f / ray.direction.x;
+        packet->inv_y[k] = 1.0f / ray.direction.y;
+        packet->inv_z[k] = 1.0f / ray.direction.z;
+        packet->length2[k] = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y +
+                             ray.direction.z * ray.direction.z;
+    }
+}
+
+Ray ray_packet_get(const RayPacket* packet, int lane) {
+    // Not ray_create: the direction is used as stored, like the single-ray path
+    Ray ray;
+    ray.origin = vec3_new(packet->origin_x[lane], packet->origin_y[lane], packet->origin_z[lane]);
+    ray.direction = vec3_new(packet->dir_x[lane], packet->dir_y[lane], packet->dir_z[lane]);
+    return ray;
+}
+
+static float min_f(float a, float b) { return a < b ? a : b; }
+static float max_f(float a, float b) { return a > b ? a : b; }
+
+static void interval_init(PacketInterval* iv, const RayPacket* packet) {
+    const float* origin[3] = {packet->origin_x, packet->origin_y, packet->origin_z};
+    const float* inv[3] = {packet->inv_x, packet->inv_y, packet->inv_z};
+
+    iv->valid = 1;
+    for (int a = 0; a < 3; a++) {
+        iv->origin_lo[a] = iv->origin_hi[a] = origin[a][0];
+        iv->inv_lo[a] = iv->inv_hi[a] = inv[a][0];
+        for (int k = 1; k < packet->count; k++) {
+            iv->origin_lo[a] = min_f(iv->origin_lo[a], origin[a][k]);
+            iv->origin_hi[a] = max_f(iv->origin_hi[a], origin[a][k]);
+            iv->inv_lo[a] = min_f(iv->inv_lo[a], inv[a][k]);
+            iv->inv_hi[a] = max_f(iv->inv_hi[a], inv[a][k]);
+        }
+        if (!(iv->inv_lo[a] > 0.0f || iv->inv_hi[a] < 0.0f)) iv->valid = 0;
+    }
+}
+
+static void interval_mul(float a_lo, float a_hi, float b_lo, float b_hi, float* lo, float* hi) {
+    float p0 = a_lo * b_lo;
+    float p1 = a_lo * b_hi;
+    float p2 = a_hi * b_lo;
+    float p3 = a_hi * b_hi;
+    *lo = min_f(min_f(p0, p1), min_f(p2, p3));
+    *hi = max_f(max_f(p0, p1), max_f(p2, p3));
+}
+
+// True when no ray of the packet can enter the box before far_bound
+static int interval_misses(const PacketInterval* iv, const BVHNode* node, float t_min, float far_bound) {
+    float near = t_min;
+    float far = far_bound;
+
+    for (int a = 0; a < 3; a++) {
+        float lo_min, hi_min, lo_max, hi_max;
+        interval_mul(node->min[a] - iv->origin_hi[a], node->min[a] - iv->origin_lo[a],
+                     iv->inv_lo[a], iv->inv_hi[a], &lo_min, &hi_min);
+        interval_mul(node->max[a] - iv->origin_hi[a], node->max[a] - iv->origin_lo[a],
+                     iv->inv_lo[a], iv->inv_hi[a], &lo_max, &hi_max);
+
+        if (iv->inv_lo[a] > 0.0f) {
+            near = max_f(near, lo_min);
+            far = min_f(far, hi_max);
+        } else {
+            near = max_f(near, lo_max);
+            far = min_f(far, hi_min);
+        }
+    }
+    return near > far;
+}
+
+#if defined(__SSE2__)
+
+static __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static __m128 lane_mask(uint32_t bits) {
+    __m128i select = _mm_set_epi32(8, 4, 2, 1);
+    __m128i set = _mm_and_si128(_mm_set1_epi32((int)bits), select);
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(set, select));
+}
+
+// Rays of mask whose slab interval overlaps the node before their closest hit
+static uint32_t box_mask(const BVHNode* node, const RayPacket* p, const float* closest, float t_min, uint32_t mask) {
+    uint32_t result = 0;
+    __m128 vt_min = _mm_set1_ps(t_min);
+
+    for (int g = 0; g < PACKET_GROUPS; g++) {
+        if (!((mask >> (g * 4)) & 0xF)) continue;
+        int k = g * 4;
+
+        __m128 ox = _mm_loadu_ps(p->origin_x + k);
+        __m128 oy = _mm_loadu_ps(p->origin_y + k);
+        __m128 oz = _mm_loadu_ps(p->origin_z + k);
+        __m128 ix = _mm_loadu_ps(p->inv_x + k);
+        __m128 iy = _mm_loadu_ps(p->inv_y + k);
+        __m128 iz = _mm_loadu_ps(p->inv_z + k);
+
+        __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->min[0]), ox), ix);
+        __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->max[0]), ox), ix);
+        __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->min[1]), oy), iy);
+        __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->max[1]), oy), iy);
+        __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->min[2]), oz), iz);
+        __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node->max[2]), oz), iz);
+
+        __m128 near = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)),
+                                 _mm_max_ps(_mm_min_ps(tz0, tz1), vt_min));
+        __m128 far = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)),
+                                _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_loadu_ps(closest + k)));
+
+        result |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(near, far)) << k;
+    }
+    return result & mask;
+}
+
+// Same operation sequence as the single-ray sphere kernel, across rays
+static void leaf_hit(const SphereSoA* soa, int first, int count, const RayPacket* p, float t_min, float t_max,
+                     float* closest, int* best, uint32_t mask) {
+    __m128 vt_min = _mm_set1_ps(t_min);
+    __m128 vt_max = _mm_set1_ps(t_max);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 zero = _mm_setzero_ps();
+
+    for (int j = first; j < first + count; j++) {
+        __m128 cx = _mm_set1_ps(soa->center_x[j]);
+        __m128 cy = _mm_set1_ps(soa->center_y[j]);
+        __m128 cz = _mm_set1_ps(soa->center_z[j]);
+        __m128 r2 = _mm_set1_ps(soa->radius2[j]);
+        __m128 index = _mm_castsi128_ps(_mm_set1_epi32(j));
+
+        for (int g = 0; g < PACKET_GROUPS; g++) {
+            uint32_t bits = (mask >> (g * 4)) & 0xF;
+            if (!bits) continue;
+            int k = g * 4;
+
+            __m128 ocx = _mm_sub_ps(_mm_loadu_ps(p->origin_x + k), cx);
+            __m128 ocy = _mm_sub_ps(_mm_loadu_ps(p->origin_y + k), cy);
+            __m128 ocz = _mm_sub_ps(_mm_loadu_ps(p->origin_z + k), cz);
+            __m128 a = _mm_loadu_ps(p->length2 + k);
+
+            __m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, _mm_loadu_ps(p->dir_x + k)),
+                                                  _mm_mul_ps(ocy, _mm_loadu_ps(p->dir_y + k))),
+                                       _mm_mul_ps(ocz, _mm_loadu_ps(p->dir_z + k)));
+            __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), r2);
+            __m128 discriminant = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+
+            __m128 sqrtd = _mm_sqrt_ps(discriminant);
+            __m128 neg_half_b = _mm_xor_ps(half_b, sign);
+            __m128 near = _mm_div_ps(_mm_sub_ps(neg_half_b, sqrtd), a);
+            __m128 far = _mm_div_ps(_mm_add_ps(neg_half_b, sqrtd), a);
+
+            __m128 near_ok = _mm_and_ps(_mm_cmpge_ps(near, vt_min), _mm_cmple_ps(near, vt_max));
+            __m128 far_ok = _mm_and_ps(_mm_cmpge_ps(far, vt_min), _mm_cmple_ps(far, vt_max));
+            __m128 root = select_ps(near_ok, near, far);
+
+            __m128 lane_closest = _mm_loadu_ps(closest + k);
+            __m128 ok = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_or_ps(near_ok, far_ok));
+            ok = _mm_and_ps(ok, _mm_cmple_ps(root, lane_closest));
+            ok = _mm_and_ps(ok, lane_mask(bits));
+
+            _mm_storeu_ps(closest + k, select_ps(ok, root, lane_closest));
+            __m128 lane_best = _mm_loadu_ps((const float*)(best + k));
+            _mm_storeu_ps((float*)(best + k), select_ps(ok, index, lane_best));
+        }
+    }
+}
+
+#else
+
+static uint32_t box_mask(const BVHNode* node, const RayPacket* p, const float* closest, float t_min, uint32_t mask) {
+    uint32_t result = 0;
+    for (int k = 0; k < RAY_PACKET_MAX; k++) {
+        if (!(mask & (1u << k))) continue;
+        float tx0 = (node->min[0] - p->origin_x[k]) * p->inv_x[k];
+        float tx1 = (node->max[0] - p->origin_x[k]) * p->inv_x[k];
+        float ty0 = (node->min[1] - p->origin_y[k]) * p->inv_y[k];
+        float ty1 = (node->max[1] - p->origin_y[k]) * p->inv_y[k];
+        float tz0 = (node->min[2] - p->origin_z[k]) * p->inv_z[k];
+        float tz1 = (node->max[2] - p->origin_z[k]) * p->inv_z[k];
+        float near = max_f(max_f(min_f(tx0, tx1), min_f(ty0, ty1)), max_f(min_f(tz0, tz1), t_min));
+        float far = min_f(min_f(max_f(tx0, tx1), max_f(ty0, ty1)), min_f(max_f(tz0, tz1), closest[k]));
+        if (near <= far) result |= 1u << k;
+    }
+    return result;
+}
+
+static void leaf_hit(const SphereSoA* soa, int first, int count, const RayPacket* p, float t_min, float t_max,
+                     float* closest, int* best, uint32_t mask) {
+    for (int k = 0; k < RAY_PACKET_MAX; k++) {
+        if (!(mask & (1u << k))) continue;
+        float t;
+        int j = sphere_soa_hit_closest_scalar(soa, first, first + count, ray_packet_get(p, k), t_min, t_max, &t);
+        if (j >= 0 && t <= closest[k]) {
+            closest[k] = t;
+            best[k] = j;
+        }
+    }
+}
+
+#endif
+
+uint32_t bvh_hit_packet(BVH* bvh, SphereList* list, const RayPacket* packet, float t_min, float t_max, RayHit* hits) {
+    float closest[RAY_PACKET_MAX];
+    int best[RAY_PACKET_MAX];
+    for (int k = 0; k < RAY_PACKET_MAX; k++) {
+        closest[k] = t_max;
+        best[k] = -1;
+    }
+
+    PacketInterval iv;
+    interval_init(&iv, packet);
+
+    // Average direction decides which child is visited first
+    Vec3 mean_dir = vec3_new(0.0f, 0.0f, 0.0f);
+    for (int k = 0; k < packet->count; k++) {
+        mean_dir = vec3_add(mean_dir, vec3_new(packet->dir_x[k], packet->dir_y[k], packet->dir_z[k]));
+    }
+
+    int stack[PACKET_STACK_SIZE];
+    uint32_t stack_mask[PACKET_STACK_SIZE];
+    int sp = 0;
+    stack[sp] = 0;
+    stack_mask[sp++] = (1u << packet->count) - 1;
+
+    while (sp > 0) {
+        sp--;
+        BVHNode* node = &bvh->nodes[stack[sp]];
+        uint32_t mask = stack_mask[sp];
+
+        // The interval test only pays off when it can skip most of a wide packet
+        if (iv.valid && __builtin_popcount(mask) >= 8 && interval_misses(&iv, node, t_min, t_max)) continue;
+
+        mask = box_mask(node, packet, closest, t_min, mask);
+        if (!mask) continue;
+
+        if (node->count > 0) {
+            leaf_hit(bvh->leaf_spheres, node->left_first, node->count, packet, t_min, t_max, closest, best, mask);
+            continue;
+        }
+
+        BVHNode* left = &bvh->nodes[node->left_first];
+        BVHNode* right = left + 1;
+        float order = (right->min[0] + right->max[0] - left->min[0] - left->max[0]) * mean_dir.x +
+                      (right->min[1] + right->max[1] - left->min[1] - left->max[1]) * mean_dir.y +
+                      (right->min[2] + right->max[2] - left->min[2] - left->max[2]) * mean_dir.z;
+
+        // Push the far child first so the near one is popped next
+        int near_index = order >= 0.0f ? node->left_first : node->left_first + 1;
+        int far_index = order >= 0.0f ? node->left_first + 1 : node->left_first;
+        stack[sp] = far_index;
+        stack_mask[sp++] = mask;
+        stack[sp] = near_index;
+        stack_mask[sp++] = mask;
+    }
+
+    uint32_t hit_mask = 0;
+    for (int k = 0; k < packet->count; k++) {
+        if (best[k] < 0) continue;
+        sphere_hit_record(list->spheres[bvh->indices[best[k]]], ray_packet_get(packet, k), closest[k], &hits[k]);
+        hits[k].object = bvh->indices[best[k]];
+        hit_mask |= 1u << k;
+    }
+    return hit_mask;
+}
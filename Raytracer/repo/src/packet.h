@@ -0,0 +1,34 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stdint.h>
+#include "ray.h"
+#include "bvh.h"
+
+#define RAY_PACKET_MAX 16
+
+// Up to 16 coherent rays (typically a 4x4, 4x2 or 2x2 block of primary
+// rays) in SoA layout. Lanes past count repeat ray 0 and are never active.
+typedef struct {
+    float origin_x[RAY_PACKET_MAX];
+    float origin_y[RAY_PACKET_MAX];
+    float origin_z[RAY_PACKET_MAX];
+    float dir_x[RAY_PACKET_MAX];
+    float dir_y[RAY_PACKET_MAX];
+    float dir_z[RAY_PACKET_MAX];
+    float inv_x[RAY_PACKET_MAX];
+    float inv_y[RAY_PACKET_MAX];
+    float inv_z[RAY_PACKET_MAX];
+    float length2[RAY_PACKET_MAX];  // dot(dir, dir)
+    int count;
+} RayPacket;
+
+void ray_packet_init(RayPacket* packet, const Ray* rays, int count);
+Ray ray_packet_get(const RayPacket* packet, int lane);
+
+// Closest hit of every ray in the packet. Whole subtrees are culled with an
+// interval test over the packet before any per-ray work. hits[i] is filled
+// for every ray whose bit is set in the returned mask.
+uint32_t bvh_hit_packet(BVH* bvh, SphereList* list, const RayPacket* packet, float t_min, float t_max, RayHit* hits);
+
+#endif
@@ -0,0 +1,149 @@
+#define _POSIX_C_SOURCE 200809L
+#include "parallel.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define PARALLEL_MAX_THREADS 256
+
+typedef struct {
+    void (*fn)(void* ctx, int thread_index);
+    void* ctx;
+    int thread_index;
+} WorkerArgs;
+
+static void* worker_main(void* arg) {
+    WorkerArgs* args = (WorkerArgs*)arg;
+    args->fn(args->ctx, args->thread_index);
+    return NULL;
+}
+
+int parallel_cpu_count() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = (int)info.dwNumberOfProcessors;
+#else
+    int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (count < 1) count = 1;
+    if (count > PARALLEL_MAX_THREADS) count = PARALLEL_MAX_THREADS;
+    return count;
+}
+
+void parallel_run(int thread_count, void (*fn)(void* ctx, int thread_index), void* ctx) {
+    if (thread_count > PARALLEL_MAX_THREADS) thread_count = PARALLEL_MAX_THREADS;
+    if (thread_count <= 1) {
+        fn(ctx, 0);
+        return;
+    }
+    
+    pthread_t threads[PARALLEL_MAX_THREADS];
+    WorkerArgs args[PARALLEL_MAX_THREADS];
+    int started[PARALLEL_MAX_THREADS];
+    
+    for (int i = 1; i < thread_count; i++) {
+        args[i] = (WorkerArgs){fn, ctx, i};
+        started[i] = pthread_create(&threads[i], NULL, worker_main, &args[i]) == 0;
+        if (!started[i]) {
+            // Could not spawn: do the work on the calling thread instead
+            fn(ctx, i);
+        }
+    }
+    
+    fn(ctx, 0);
+    
+    for (int i = 1; i < thread_count; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+}
+
+int parallel_fetch_add(int* counter, int value) {
+    return __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+int parallel_load(const int* value) {
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void parallel_store(int* value, int new_value) {
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+int parallel_exchange(int* value, int new_value) {
+    return __atomic_exchange_n(value, new_value, __ATOMIC_ACQ_REL);
+}
+
+struct ParallelThread {
+    pthread_t thread;
+    void (*fn)(void* ctx);
+    void* ctx;
+};
+
+static void* thread_main(void* arg) {
+    ParallelThread* thread = (ParallelThread*)arg;
+    thread->fn(thread->ctx);
+    return NULL;
+}
+
+ParallelThread* parallel_thread_start(void (*fn)(void* ctx), void* ctx) {
+    ParallelThread* thread = (ParallelThread*)malloc(sizeof(ParallelThread));
+    if (!thread) return NULL;
+    thread->fn = fn;
+    thread->ctx = ctx;
+    if (pthread_create(&thread->thread, NULL, thread_main, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+void parallel_thread_join(ParallelThread* thread) {
+    if (!thread) return;
+    pthread_join(thread->thread, NULL);
+    free(thread);
+}
+
+struct ParallelSemaphore {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int count;
+};
+
+ParallelSemaphore* parallel_semaphore_create(int count) {
+    ParallelSemaphore* semaphore = (ParallelSemaphore*)malloc(sizeof(ParallelSemaphore));
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    pthread_cond_init(&semaphore->cond, NULL);
+    semaphore->count = count;
+    return semaphore;
+}
+
+void parallel_semaphore_free(ParallelSemaphore* semaphore) {
+    if (!semaphore) return;
+    pthread_mutex_destroy(&semaphore->mutex);
+    pthread_cond_destroy(&semaphore->cond);
+    free(semaphore);
+}
+
+void parallel_semaphore_post(ParallelSemaphore* semaphore) {
+    pthread_mutex_lock(&semaphore->mutex);
+    semaphore->count++;
+    pthread_cond_signal(&semaphore->cond);
+    pthread_mutex_unlock(&semaphore->mutex);
+}
+
+void parallel_semaphore_wait(ParallelSemaphore* semaphore) {
+    pthread_mutex_lock(&semaphore->mutex);
+    while (semaphore->count == 0) {
+        pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
+    }
+    semaphore->count--;
+    pthread_mutex_unlock(&semaphore->mutex);
+}
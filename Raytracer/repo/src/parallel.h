@@ -0,0 +1,32 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Number of hardware threads available for worker pools
+int parallel_cpu_count();
+
+// Run fn(ctx, thread_index) on thread_count threads (the caller is thread 0)
+// and return once all of them have finished
+void parallel_run(int thread_count, void (*fn)(void* ctx, int thread_index), void* ctx);
+
+// Atomically add value to *counter and return the previous value
+int parallel_fetch_add(int* counter, int value);
+
+// Atomic accesses for handing data between threads: a store publishes
+// everything written before it to whoever loads or exchanges the value after
+int parallel_load(const int* value);
+void parallel_store(int* value, int new_value);
+int parallel_exchange(int* value, int new_value);  // Returns the previous value
+
+// A thread that runs alongside its creator, unlike parallel_run's workers
+typedef struct ParallelThread ParallelThread;
+ParallelThread* parallel_thread_start(void (*fn)(void* ctx), void* ctx);  // NULL if it could not start
+void parallel_thread_join(ParallelThread* thread);  // Waits for fn to return and frees the thread
+
+// Counting semaphore, for a thread to sleep until there is work
+typedef struct ParallelSemaphore ParallelSemaphore;
+ParallelSemaphore* parallel_semaphore_create(int count);
+void parallel_semaphore_free(ParallelSemaphore* semaphore);
+void parallel_semaphore_post(ParallelSemaphore* semaphore);
+void parallel_semaphore_wait(ParallelSemaphore* semaphore);
+
+#endif
@@ -0,0 +1,100 @@
+#include "platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const PlatformBackend* backends[] = {
+#ifdef _WIN32
+    &platform_win32,
+#endif
+    &platform_headless,
+};
+
+PlatformConfig platform_config_default(int width, int height, const char* title) {
+    PlatformConfig config;
+    config.width = width;
+    config.height = height;
+    config.title = title;
+    config.backend = NULL;
+    config.frames = 0;
+    config.script = NULL;
+    config.dump_path = NULL;
+    config.dump_every = 1;
+    config.fixed_dt = 0.0f;
+    return config;
+}
+
+int platform_dump_pattern_valid(const char* pattern) {
+    int conversions = 0;
+    for (const char* c = pattern; *c; c++) {
+        if (*c != '%') continue;
+        c++;
+        if (*c == '%') continue;
+        // Flags, width and precision, but no '*' or length modifiers: the
+        // frame number is a plain int
+        while (*c && strchr("-+ #0", *c)) c++;
+        while (*c >= '0' && *c <= '9') c++;
+        if (*c == '.') {
+            c++;
+            while (*c >= '0' && *c <= '9') c++;
+        }
+        if (!*c || !strchr("diouxX", *c)) return 0;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+Platform* platform_create(const PlatformConfig* config) {
+    // The first backend in the table is the default
+    const PlatformBackend* backend = NULL;
+    int count = (int)(sizeof(backends) / sizeof(backends[0]));
+    for (int i = 0; i < count; i++) {
+        if (!config->backend || strcmp(config->backend, backends[i]->name) == 0) {
+            backend = backends[i];
+            break;
+        }
+    }
+    if (!backend) {
+        return NULL;
+    }
+    
+    Platform* platform = (Platform*)malloc(sizeof(Platform));
+    platform->backend = backend;
+    platform->width = config->width;
+    platform->height = config->height;
+    platform->is_open = 1;
+    memset(platform->keys, 0, sizeof(platform->keys));
+    platform->data = NULL;
+    
+    if (!backend->open(platform, config)) {
+        free(platform);
+        return NULL;
+    }
+    return platform;
+}
+
+void platform_free(Platform* platform) {
+    if (platform) {
+        platform->backend->close(platform);
+        free(platform);
+    }
+}
+
+void platform_poll(Platform* platform) {
+    platform->backend->poll(platform);
+}
+
+void platform_present(Platform* platform, const uint32_t* pixels) {
+    platform->backend->present(platform, pixels);
+}
+
+double platform_time(Platform* platform) {
+    return platform->backend->time(platform);
+}
+
+int platform_is_open(Platform* platform) {
+    return platform ? platform->is_open : 0;
+}
+
+int platform_key_down(Platform* platform, PlatformKey key) {
+    return platform && key >= 0 && key < PLATFORM_KEY_COUNT ? platform->keys[key] : 0;
+}
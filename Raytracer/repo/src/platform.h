@@ -0,0 +1,73 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stdint.h>
+
+// Timing, input and presentation for the game loop, behind a small backend
+// table so the same loop runs in a Win32 window or headless on Linux
+
+typedef enum {
+    PLATFORM_KEY_UP,
+    PLATFORM_KEY_DOWN,
+    PLATFORM_KEY_LEFT,
+    PLATFORM_KEY_RIGHT,
+    PLATFORM_KEY_FIRE,
+    PLATFORM_KEY_QUIT,
+    PLATFORM_KEY_COUNT
+} PlatformKey;
+
+typedef struct {
+    int width;
+    int height;
+    const char* title;
+    const char* backend;  // "win32", "headless", or NULL for the default
+
+    // Headless backend only
+    int frames;             // Close after this many frames (0 = never)
+    const char* script;     // Input script file, NULL = no input
+    const char* dump_path;  // printf pattern taking the frame number, NULL = keep frames in memory only
+    int dump_every;         // Write every Nth presented frame to dump_path
+    float fixed_dt;         // > 0: the clock advances this much per frame instead of following wall time
+} PlatformConfig;
+
+typedef struct Platform Platform;
+
+typedef struct {
+    const char* name;
+    int (*open)(Platform* platform, const PlatformConfig* config);
+    void (*close)(Platform* platform);
+    void (*poll)(Platform* platform);  // Refresh keys and is_open
+    void (*present)(Platform* platform, const uint32_t* pixels);
+    double (*time)(Platform* platform);
+} PlatformBackend;
+
+struct Platform {
+    const PlatformBackend* backend;
+    int width;
+    int height;
+    int is_open;
+    int keys[PLATFORM_KEY_COUNT];
+    void* data;  // Backend state
+};
+
+extern const PlatformBackend platform_headless;
+#ifdef _WIN32
+extern const PlatformBackend platform_win32;
+#endif
+
+PlatformConfig platform_config_default(int width, int height, const char* title);
+
+// 1 if pattern holds exactly one int conversion (%d, %04d, %x...) and no
+// other conversions besides %%, so it is safe to format a frame number with
+int platform_dump_pattern_valid(const char* pattern);
+
+// Returns NULL if the backend is unknown or fails to open
+Platform* platform_create(const PlatformConfig* config);
+void platform_free(Platform* platform);
+void platform_poll(Platform* platform);
+void platform_present(Platform* platform, const uint32_t* pixels);
+double platform_time(Platform* platform);  // Seconds from an arbitrary origin
+int platform_is_open(Platform* platform);
+int platform_key_down(Platform* platform, PlatformKey key);
+
+#endif
@@ -0,0 +1,187 @@
+#include "platform.h"
+#include "timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// No window: time comes from the monotonic clock (or a fixed step), input
+// from a script file, and presented frames are kept in memory and
+// optionally written out as binary PPMs.
+//
+// Script lines hold a frame range and the keys held during it, e.g.
+//     0 119 up fire
+//     120 239 left
+//     600 600 quit
+// Key names: up, down, left, right, fire, quit. '#' starts a comment.
+
+typedef struct {
+    int first_frame;
+    int last_frame;
+    int keys[PLATFORM_KEY_COUNT];
+} ScriptEntry;
+
+typedef struct {
+    uint32_t* frame;  // Last presented frame
+    ScriptEntry* script;
+    int script_count;
+    int frame_index;
+    int frames;
+    float fixed_dt;
+    double start;
+    const char* dump_path;
+    int dump_every;
+    int presented;
+    uint8_t* dump_buffer;
+} HeadlessState;
+
+static const char* key_names[PLATFORM_KEY_COUNT] = {"up", "down", "left", "right", "fire", "quit"};
+
+static int load_script(HeadlessState* state, const char* filename) {
+    FILE* file = fopen(filename, "r");
+    if (!file) {
+        printf("Cannot open input script %s\n", filename);
+        return 0;
+    }
+    
+    int capacity = 16;
+    state->script = (ScriptEntry*)malloc(capacity * sizeof(ScriptEntry));
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        
+        ScriptEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        int consumed = 0;
+        if (sscanf(line, "%d %d%n", &entry.first_frame, &entry.last_frame, &consumed) != 2) {
+            continue;  // Blank or comment line
+        }
+        
+        for (char* token = strtok(line + consumed, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")) {
+            int key = 0;
+            while (key < PLATFORM_KEY_COUNT && strcmp(token, key_names[key]) != 0) key++;
+            if (key == PLATFORM_KEY_COUNT) {
+                printf("%s:%d: unknown key '%s'\n", filename, line_number, token);
+                fclose(file);
+                return 0;
+            }
+            entry.keys[key] = 1;
+        }
+        
+        if (state->script_count == capacity) {
+            capacity *= 2;
+            state->script = (ScriptEntry*)realloc(state->script, capacity * sizeof(ScriptEntry));
+        }
+        state->script[state->script_count++] = entry;
+    }
+    
+    fclose(file);
+    return 1;
+}
+
+static void dump_frame(HeadlessState* state, int width, int height) {
+    char filename[512];
+    snprintf(filename, sizeof(filename), state->dump_path, state->presented);
+    
+    char header[64];
+    int header_size = sprintf(header, "P6\n%d %d\n255\n", width, height);
+    uint8_t* out = state->dump_buffer;
+    memcpy(out, header, header_size);
+    out += header_size;
+    for (int i = 0; i < width * height; i++) {
+        uint32_t c = state->frame[i];
+        *out++ = (uint8_t)(c >> 16);
+        *out++ = (uint8_t)(c >> 8);
+        *out++ = (uint8_t)c;
+    }
+    
+    FILE* file = fopen(filename, "wb");
+    if (file) {
+        fwrite(state->dump_buffer, 1, out - state->dump_buffer, file);
+        fclose(file);
+    }
+}
+
+static int headless_open(Platform* platform, const PlatformConfig* config) {
+    // The pattern is used as a format string
+    if (config->dump_path && !platform_dump_pattern_valid(config->dump_path)) {
+        printf("Dump pattern %s needs exactly one int conversion, e.g. frame_%%04d.ppm\n", config->dump_path);
+        return 0;
+    }
+    
+    HeadlessState* state = (HeadlessState*)calloc(1, sizeof(HeadlessState));
+    size_t pixels = (size_t)config->width * config->height;
+    state->frame = (uint32_t*)calloc(pixels, sizeof(uint32_t));
+    state->frames = config->frames;
+    state->fixed_dt = config->fixed_dt;
+    state->start = timer_seconds();
+    state->dump_path = config->dump_path;
+    state->dump_every = config->dump_every > 0 ? config->dump_every : 1;
+    if (state->dump_path) {
+        state->dump_buffer = (uint8_t*)malloc(64 + pixels * 3);
+    }
+    platform->data = state;
+    
+    if (config->script && !load_script(state, config->script)) {
+        platform->backend->close(platform);
+        return 0;
+    }
+    return 1;
+}
+
+static void headless_close(Platform* platform) {
+    HeadlessState* state = (HeadlessState*)platform->data;
+    if (state) {
+        free(state->frame);
+        free(state->script);
+        free(state->dump_buffer);
+        free(state);
+    }
+}
+
+static void headless_poll(Platform* platform) {
+    HeadlessState* state = (HeadlessState*)platform->data;
+    
+    memset(platform->keys, 0, sizeof(platform->keys));
+    for (int i = 0; i < state->script_count; i++) {
+        ScriptEntry* entry = &state->script[i];
+        if (state->frame_index < entry->first_frame || state->frame_index > entry->last_frame) continue;
+        for (int k = 0; k < PLATFORM_KEY_COUNT; k++) {
+            platform->keys[k] |= entry->keys[k];
+        }
+    }
+    
+    if (state->frames > 0 && state->frame_index >= state->frames) {
+        platform->is_open = 0;
+    }
+    state->frame_index++;
+}
+
+static void headless_present(Platform* platform, const uint32_t* pixels) {
+    HeadlessState* state = (HeadlessState*)platform->data;
+    memcpy(state->frame, pixels, (size_t)platform->width * platform->height * sizeof(uint32_t));
+    
+    if (state->dump_path && state->presented % state->dump_every == 0) {
+        dump_frame(state, platform->width, platform->height);
+    }
+    state->presented++;
+}
+
+static double headless_time(Platform* platform) {
+    HeadlessState* state = (HeadlessState*)platform->data;
+    if (state->fixed_dt > 0.0f) {
+        return state->frame_index * (double)state->fixed_dt;
+    }
+    return timer_seconds() - state->start;
+}
+
+const PlatformBackend platform_headless = {
+    "headless",
+    headless_open,
+    headless_close,
+    headless_poll,
+    headless_present,
+    headless_time
+};
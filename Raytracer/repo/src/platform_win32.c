@@ -0,0 +1,54 @@
+#ifdef _WIN32
+#include "platform.h"
+#include "window.h"
+#include "timer.h"
+#include <windows.h>
+
+// The original GameWindow as a platform backend
+
+static int win32_open(Platform* platform, const PlatformConfig* config) {
+    GameWindow* window = window_create(config->width, config->height, config->title);
+    if (!window) {
+        return 0;
+    }
+    platform->data = window;
+    return 1;
+}
+
+static void win32_close(Platform* platform) {
+    window_free((GameWindow*)platform->data);
+}
+
+static void win32_poll(Platform* platform) {
+    GameWindow* window = (GameWindow*)platform->data;
+    window_update(window);
+    
+    // ZQSD or WASD
+    platform->keys[PLATFORM_KEY_UP] = window_key_pressed(window, 'Z') || window_key_pressed(window, 'W');
+    platform->keys[PLATFORM_KEY_DOWN] = window_key_pressed(window, 'S');
+    platform->keys[PLATFORM_KEY_LEFT] = window_key_pressed(window, 'Q') || window_key_pressed(window, 'A');
+    platform->keys[PLATFORM_KEY_RIGHT] = window_key_pressed(window, 'D');
+    platform->keys[PLATFORM_KEY_FIRE] = window_key_pressed(window, VK_SPACE);
+    platform->keys[PLATFORM_KEY_QUIT] = window_key_pressed(window, VK_ESCAPE);
+    platform->is_open = window_is_open(window);
+}
+
+static void win32_present(Platform* platform, const uint32_t* pixels) {
+    window_draw_frame((GameWindow*)platform->data, (uint32_t*)pixels);
+}
+
+static double win32_time(Platform* platform) {
+    (void)platform;
+    return timer_seconds();
+}
+
+const PlatformBackend platform_win32 = {
+    "win32",
+    win32_open,
+    win32_close,
+    win32_poll,
+    win32_present,
+    win32_time
+};
+
+#endif
@@ -0,0 +1,336 @@
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ---- Stream kernels ----
+
+void pool_axpy(float* y, float a, const float* x, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128 scale = _mm_set1_ps(a);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), _mm_mul_ps(scale, _mm_loadu_ps(x + i))));
+    }
+#endif
+    for (; i < count; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+void pool_add(float* y, float a, int count) {
+    int i = 0;
+#if defined(__SSE2__)
+    __m128 offset = _mm_set1_ps(a);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i), offset));
+    }
+#endif
+    for (; i < count; i++) {
+        y[i] += a;
+    }
+}
+
+// ---- Slot map ----
+
+static void slot_map_init(SlotMap* map) {
+    map->slot_of = NULL;
+    map->index_of = NULL;
+    map->generation = NULL;
+    map->next_free = NULL;
+    map->free_head = -1;
+    map->slot_count = 0;
+    map->capacity = 0;
+}
+
+static void slot_map_free(SlotMap* map) {
+    free(map->slot_of);
+    free(map->index_of);
+    free(map->generation);
+    free(map->next_free);
+}
+
+// Every live entity owns a slot, so slot capacity also bounds the indices
+static void slot_map_reserve(SlotMap* map, int count) {
+    if (count <= map->capacity) return;
+    int capacity = map->capacity ? map->capacity : 16;
+    while (capacity < count) capacity *= 2;
+    map->slot_of = (int*)realloc(map->slot_of, capacity * sizeof(int));
+    map->index_of = (int*)realloc(map->index_of, capacity * sizeof(int));
+    map->generation = (int*)realloc(map->generation, capacity * sizeof(int));
+    map->next_free = (int*)realloc(map->next_free, capacity * sizeof(int));
+    map->capacity = capacity;
+}
+
+// Give the entity at index a slot, reusing a freed one when there is one
+static EntityHandle slot_map_insert(SlotMap* map, int index) {
+    int slot = map->free_head;
+    if (slot >= 0) {
+        map->free_head = map->next_free[slot];
+    } else {
+        slot_map_reserve(map, map->slot_count + 1);
+        slot = map->slot_count++;
+        map->generation[slot] = 0;
+    }
+    map->index_of[slot] = index;
+    map->slot_of[index] = slot;
+    
+    EntityHandle handle = {slot, map->generation[slot]};
+    return handle;
+}
+
+// Free the slot of the entity at index, after the entity at last has been
+// moved into index
+static void slot_map_remove(SlotMap* map, int index, int last) {
+    int slot = map->slot_of[index];
+    map->generation[slot]++;
+    map->index_of[slot] = -1;
+    map->next_free[slot] = map->free_head;
+    map->free_head = slot;
+    
+    if (last != index) {
+        int moved = map->slot_of[last];
+        map->slot_of[index] = moved;
+        map->index_of[moved] = index;
+    }
+}
+
+static void slot_map_clear(SlotMap* map) {
+    for (int slot = 0; slot < map->slot_count; slot++) {
+        if (map->index_of[slot] < 0) continue;
+        map->generation[slot]++;
+        map->index_of[slot] = -1;
+        map->next_free[slot] = map->free_head;
+        map->free_head = slot;
+    }
+}
+
+static void slot_map_copy(SlotMap* dst, const SlotMap* src) {
+    slot_map_reserve(dst, src->slot_count);
+    size_t size = src->slot_count * sizeof(int);
+    if (size) {
+        memcpy(dst->slot_of, src->slot_of, size);
+        memcpy(dst->index_of, src->index_of, size);
+        memcpy(dst->generation, src->generation, size);
+        memcpy(dst->next_free, src->next_free, size);
+    }
+    dst->free_head = src->free_head;
+    dst->slot_count = src->slot_count;
+}
+
+static int slot_map_find(const SlotMap* map, EntityHandle handle) {
+    if (handle.slot < 0 || handle.slot >= map->slot_count) return -1;
+    if (map->generation[handle.slot] != handle.generation) return -1;
+    return map->index_of[handle.slot];
+}
+
+static EntityHandle slot_map_handle(const SlotMap* map, int index) {
+    int slot = map->slot_of[index];
+    return (EntityHandle){slot, map->generation[slot]};
+}
+
+// Resize one field array, keeping its contents
+static void* grow(void* field, int capacity, size_t size) {
+    return realloc(field, capacity * size);
+}
+
+// ---- Enemies ----
+
+void enemy_pool_init(EnemyPool* pool) {
+    memset(pool, 0, sizeof(EnemyPool));
+    slot_map_init(&pool->slots);
+}
+
+void enemy_pool_free(EnemyPool* pool) {
+    free(pool->x);
+    free(pool->y);
+    free(pool->z);
+    free(pool->radius);
+    free(pool->material_id);
+    free(pool->angle);
+    free(pool->bob_offset);
+    free(pool->phase);
+    free(pool->patrol_cos);
+    free(pool->patrol_sin);
+    free(pool->bob_cos);
+    free(pool->bob_sin);
+    slot_map_free(&pool->slots);
+}
+
+static void enemy_pool_reserve(EnemyPool* pool, int count) {
+    if (count <= pool->capacity) return;
+    int capacity = pool->capacity ? pool->capacity : 16;
+    while (capacity < count) capacity *= 2;
+    pool->x = (float*)grow(pool->x, capacity, sizeof(float));
+    pool->y = (float*)grow(pool->y, capacity, sizeof(float));
+    pool->z = (float*)grow(pool->z, capacity, sizeof(float));
+    pool->radius = (float*)grow(pool->radius, capacity, sizeof(float));
+    pool->material_id = (int*)grow(pool->material_id, capacity, sizeof(int));
+    pool->angle = (float*)grow(pool->angle, capacity, sizeof(float));
+    pool->bob_offset = (float*)grow(pool->bob_offset, capacity, sizeof(float));
+    pool->phase = (float*)grow(pool->phase, capacity, sizeof(float));
+    pool->patrol_cos = (float*)grow(pool->patrol_cos, capacity, sizeof(float));
+    pool->patrol_sin = (float*)grow(pool->patrol_sin, capacity, sizeof(float));
+    pool->bob_cos = (float*)grow(pool->bob_cos, capacity, sizeof(float));
+    pool->bob_sin = (float*)grow(pool->bob_sin, capacity, sizeof(float));
+    pool->capacity = capacity;
+}
+
+EntityHandle enemy_pool_spawn(EnemyPool* pool, Vec3 position, float radius, int material_id, float phase) {
+    enemy_pool_reserve(pool, pool->count + 1);
+    int i = pool->count++;
+    pool->x[i] = position.x;
+    pool->y[i] = position.y;
+    pool->z[i] = position.z;
+    pool->radius[i] = radius;
+    pool->material_id[i] = material_id;
+    pool->angle[i] = 0.0f;
+    pool->bob_offset[i] = 0.0f;
+    pool->phase[i] = phase;
+    pool->patrol_cos[i] = cosf(phase * ENEMY_PATROL_SPREAD);
+    pool->patrol_sin[i] = sinf(phase * ENEMY_PATROL_SPREAD);
+    pool->bob_cos[i] = cosf(phase);
+    pool->bob_sin[i] = sinf(phase);
+    return slot_map_insert(&pool->slots, i);
+}
+
+void enemy_pool_remove(EnemyPool* pool, int index) {
+    int last = --pool->count;
+    pool->x[index] = pool->x[last];
+    pool->y[index] = pool->y[last];
+    pool->z[index] = pool->z[last];
+    pool->radius[index] = pool->radius[last];
+    pool->material_id[index] = pool->material_id[last];
+    pool->angle[index] = pool->angle[last];
+    pool->bob_offset[index] = pool->bob_offset[last];
+    pool->phase[index] = pool->phase[last];
+    pool->patrol_cos[index] = pool->patrol_cos[last];
+    pool->patrol_sin[index] = pool->patrol_sin[last];
+    pool->bob_cos[index] = pool->bob_cos[last];
+    pool->bob_sin[index] = pool->bob_sin[last];
+    slot_map_remove(&pool->slots, index, last);
+}
+
+void enemy_pool_clear(EnemyPool* pool) {
+    slot_map_clear(&pool->slots);
+    pool->count = 0;
+}
+
+void enemy_pool_copy(EnemyPool* dst, const EnemyPool* src) {
+    enemy_pool_reserve(dst, src->count);
+    size_t size = src->count * sizeof(float);
+    if (size) {
+        memcpy(dst->x, src->x, size);
+        memcpy(dst->y, src->y, size);
+        memcpy(dst->z, src->z, size);
+        memcpy(dst->radius, src->radius, size);
+        memcpy(dst->material_id, src->material_id, src->count * sizeof(int));
+        memcpy(dst->angle, src->angle, size);
+        memcpy(dst->bob_offset, src->bob_offset, size);
+        memcpy(dst->phase, src->phase, size);
+        memcpy(dst->patrol_cos, src->patrol_cos, size);
+        memcpy(dst->patrol_sin, src->patrol_sin, size);
+        memcpy(dst->bob_cos, src->bob_cos, size);
+        memcpy(dst->bob_sin, src->bob_sin, size);
+    }
+    dst->count = src->count;
+    slot_map_copy(&dst->slots, &src->slots);
+}
+
+int enemy_pool_find(const EnemyPool* pool, EntityHandle handle) {
+    return slot_map_find(&pool->slots, handle);
+}
+
+EntityHandle enemy_pool_handle(const EnemyPool* pool, int index) {
+    return slot_map_handle(&pool->slots, index);
+}
+
+// ---- Projectiles ----
+
+void projectile_pool_init(ProjectilePool* pool) {
+    memset(pool, 0, sizeof(ProjectilePool));
+    slot_map_init(&pool->slots);
+}
+
+void projectile_pool_free(ProjectilePool* pool) {
+    free(pool->x);
+    free(pool->y);
+    free(pool->z);
+    free(pool->vx);
+    free(pool->vy);
+    free(pool->vz);
+    free(pool->lifetime);
+    slot_map_free(&pool->slots);
+}
+
+static void projectile_pool_reserve(ProjectilePool* pool, int count) {
+    if (count <= pool->capacity) return;
+    int capacity = pool->capacity ? pool->capacity : 16;
+    while (capacity < count) capacity *= 2;
+    pool->x = (float*)grow(pool->x, capacity, sizeof(float));
+    pool->y = (float*)grow(pool->y, capacity, sizeof(float));
+    pool->z = (float*)grow(pool->z, capacity, sizeof(float));
+    pool->vx = (float*)grow(pool->vx, capacity, sizeof(float));
+    pool->vy = (float*)grow(pool->vy, capacity, sizeof(float));
+    pool->vz = (float*)grow(pool->vz, capacity, sizeof(float));
+    pool->lifetime = (float*)grow(pool->lifetime, capacity, sizeof(float));
+    pool->capacity = capacity;
+}
+
+EntityHandle projectile_pool_spawn(ProjectilePool* pool, Vec3 position, Vec3 velocity, float lifetime) {
+    projectile_pool_reserve(pool, pool->count + 1);
+    int i = pool->count++;
+    pool->x[i] = position.x;
+    pool->y[i] = position.y;
+    pool->z[i] = position.z;
+    pool->vx[i] = velocity.x;
+    pool->vy[i] = velocity.y;
+    pool->vz[i] = velocity.z;
+    pool->lifetime[i] = lifetime;
+    return slot_map_insert(&pool->slots, i);
+}
+
+void projectile_pool_remove(ProjectilePool* pool, int index) {
+    int last = --pool->count;
+    pool->x[index] = pool->x[last];
+    pool->y[index] = pool->y[last];
+    pool->z[index] = pool->z[last];
+    pool->vx[index] = pool->vx[last];
+    pool->vy[index] = pool->vy[last];
+    pool->vz[index] = pool->vz[last];
+    pool->lifetime[index] = pool->lifetime[last];
+    slot_map_remove(&pool->slots, index, last);
+}
+
+void projectile_pool_clear(ProjectilePool* pool) {
+    slot_map_clear(&pool->slots);
+    pool->count = 0;
+}
+
+void projectile_pool_copy(ProjectilePool* dst, const ProjectilePool* src) {
+    projectile_pool_reserve(dst, src->count);
+    size_t size = src->count * sizeof(float);
+    if (size) {
+        memcpy(dst->x, src->x, size);
+        memcpy(dst->y, src->y, size);
+        memcpy(dst->z, src->z, size);
+        memcpy(dst->vx, src->vx, size);
+        memcpy(dst->vy, src->vy, size);
+        memcpy(dst->vz, src->vz, size);
+        memcpy(dst->lifetime, src->lifetime, size);
+    }
+    dst->count = src->count;
+    slot_map_copy(&dst->slots, &src->slots);
+}
+
+int projectile_pool_find(const ProjectilePool* pool, EntityHandle handle) {
+    return slot_map_find(&pool->slots, handle);
+}
+
+EntityHandle projectile_pool_handle(const ProjectilePool* pool, int index) {
+    return slot_map_handle(&pool->slots, index);
+}
@@ -0,0 +1,92 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "math_utils.h"
+
+// Growable structure-of-arrays pools for the game's entities. Live entities
+// are packed at indices 0 .. count - 1, so update loops run over plain
+// float arrays with no dead entries to skip, and removal moves the last
+// entity into the hole. Indices therefore change; an EntityHandle keeps
+// naming the same entity until it is removed, through a slot map whose
+// freed slots are recycled.
+
+// Patrol circles are offset by this many radians per unit of phase
+#define ENEMY_PATROL_SPREAD 1.256f
+
+typedef struct {
+    int slot;
+    int generation;
+} EntityHandle;
+
+typedef struct {
+    int* slot_of;     // Index -> slot
+    int* index_of;    // Slot -> index, -1 while free
+    int* generation;  // Per slot, bumped on removal so old handles go stale
+    int* next_free;   // Free slots chained from free_head, -1 ends the list
+    int free_head;
+    int slot_count;   // Slots handed out so far, live or free
+    int capacity;
+} SlotMap;
+
+typedef struct {
+    int count;
+    int capacity;
+    float* x;
+    float* y;
+    float* z;
+    float* radius;
+    int* material_id;
+    float* angle;
+    float* bob_offset;
+    float* phase;       // Offset into the patrol and bob cycles, fixed at spawn
+    float* patrol_cos;  // cos and sin of phase * ENEMY_PATROL_SPREAD, so the
+    float* patrol_sin;  // patrol needs no trig per enemy per tick
+    float* bob_cos;     // cos and sin of phase, likewise for bobbing
+    float* bob_sin;
+    SlotMap slots;
+} EnemyPool;
+
+typedef struct {
+    int count;
+    int capacity;
+    float* x;
+    float* y;
+    float* z;
+    float* vx;
+    float* vy;
+    float* vz;
+    float* lifetime;
+    SlotMap slots;
+} ProjectilePool;
+
+// Stream kernels for the update loops, SSE2 when available
+void pool_axpy(float* y, float a, const float* x, int count);  // y[i] += a * x[i]
+void pool_add(float* y, float a, int count);                   // y[i] += a
+
+void enemy_pool_init(EnemyPool* pool);
+void enemy_pool_free(EnemyPool* pool);
+EntityHandle enemy_pool_spawn(EnemyPool* pool, Vec3 position, float radius, int material_id, float phase);
+void enemy_pool_remove(EnemyPool* pool, int index);
+void enemy_pool_clear(EnemyPool* pool);
+void enemy_pool_copy(EnemyPool* dst, const EnemyPool* src);  // Entities and handles
+int enemy_pool_find(const EnemyPool* pool, EntityHandle handle);  // Index, or -1 once removed
+EntityHandle enemy_pool_handle(const EnemyPool* pool, int index);
+
+static inline Vec3 enemy_pool_position(const EnemyPool* pool, int index) {
+    return vec3_new(pool->x[index], pool->y[index], pool->z[index]);
+}
+
+void projectile_pool_init(ProjectilePool* pool);
+void projectile_pool_free(ProjectilePool* pool);
+EntityHandle projectile_pool_spawn(ProjectilePool* pool, Vec3 position, Vec3 velocity, float lifetime);
+void projectile_pool_remove(ProjectilePool* pool, int index);
+void projectile_pool_clear(ProjectilePool* pool);
+void projectile_pool_copy(ProjectilePool* dst, const ProjectilePool* src);
+int projectile_pool_find(const ProjectilePool* pool, EntityHandle handle);
+EntityHandle projectile_pool_handle(const ProjectilePool* pool, int index);
+
+static inline Vec3 projectile_pool_position(const ProjectilePool* pool, int index) {
+    return vec3_new(pool->x[index], pool->y[index], pool->z[index]);
+}
+
+#endif
@@ -14,6 +14,7 @@ typedef struct {
     float t;
     int hit;
     int material_id;
+    int object;  // Index of the sphere hit in the list searched (0 from sphere_hit)
 } RayHit;
 
 Ray ray_create(Vec3 origin, Vec3 direction);
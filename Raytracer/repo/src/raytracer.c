@@ -1,33 +1,39 @@
 #include "raytracer.h"
+#include "parallel.h"
 #include <stdlib.h>
+#include <string.h>
 
-static Vec3 random_in_unit_sphere() {
-    while (1) {
-        Vec3 p = vec3_new(
-            random_float_range(-1.0f, 1.0f),
-            random_float_range(-1.0f, 1.0f),
-            random_float_range(-1.0f, 1.0f)
-        );
-        if (vec3_length(p) < 1.0f) {
-            return p;
-        }
-    }
-}
-
-static Vec3 random_unit_vector() {
-    return vec3_normalize(random_in_unit_sphere());
-}
+#define PI 3.14159265f
+#define SHADOW_EPSILON 0.001f  // Shadow rays stop this far short of the light, relative to its distance
 
 Scene* scene_create() {
     Scene* scene = (Scene*)malloc(sizeof(Scene));
     scene->material_count = 0;
     scene->scene = sphere_list_create(32);
+    scene->bvh = NULL;
+    scene->revision = 0;
+    scene->dynamic = sphere_list_create(32);
+    scene->dynamic_bvh = NULL;
+    scene->free_handles = NULL;
+    scene->free_count = 0;
+    scene->free_capacity = 0;
+    scene->dynamic_builds = 0;
+    scene->lights = NULL;
+    scene->light_count = 0;
+    scene->light_capacity = 0;
+    scene->light_sampling = 1;
+    scene->sky_intensity = 1.0f;
     return scene;
 }
 
 void scene_free(Scene* scene) {
     if (scene) {
         sphere_list_free(scene->scene);
+        bvh_free(scene->bvh);
+        sphere_list_free(scene->dynamic);
+        bvh_free(scene->dynamic_bvh);
+        free(scene->free_handles);
+        free(scene->lights);
         free(scene);
     }
 }
@@ -43,44 +49,283 @@ int scene_add_material(Scene* scene, Material mat) {
 
 void scene_add_object(Scene* scene, Sphere sphere) {
     sphere_list_add(scene->scene, sphere);
+    scene->revision++;
+    
+    if (scene->materials[sphere.material_id].type == MAT_EMISSIVE && sphere.radius > 0.0f) {
+        if (scene->light_count == scene->light_capacity) {
+            scene->light_capacity = scene->light_capacity ? scene->light_capacity * 2 : 8;
+            scene->lights = (int*)realloc(scene->lights, scene->light_capacity * sizeof(int));
+        }
+        scene->lights[scene->light_count++] = scene->scene->count - 1;
+    }
+    
+    // The tree no longer covers every object, fall back to the linear list until rebuilt
+    bvh_free(scene->bvh);
+    scene->bvh = NULL;
+}
+
+void scene_clear_objects(Scene* scene) {
+    scene->scene->count = 0;
+    if (scene->scene->soa) scene->scene->soa->count = 0;
+    scene->light_count = 0;
+    scene->revision++;
+    bvh_free(scene->bvh);
+    scene->bvh = NULL;
+}
+
+void scene_build_bvh(Scene* scene) {
+    bvh_free(scene->bvh);
+    scene->bvh = bvh_build(scene->scene, parallel_cpu_count());
+}
+
+int scene_add_dynamic(Scene* scene, Sphere sphere) {
+    if (scene->free_count > 0) {
+        int handle = scene->free_handles[--scene->free_count];
+        scene_set_dynamic(scene, handle, sphere);
+        return handle;
+    }
+    
+    // A new object past the end: the tree gets rebuilt on the next refit
+    sphere_list_add(scene->dynamic, sphere);
+    return scene->dynamic->count - 1;
+}
+
+void scene_set_dynamic(Scene* scene, int handle, Sphere sphere) {
+    scene->dynamic->spheres[handle] = sphere;
+    if (scene->dynamic->soa) sphere_soa_set(scene->dynamic->soa, handle, sphere);
+}
+
+void scene_remove_dynamic(Scene* scene, int handle) {
+    Sphere hidden = scene->dynamic->spheres[handle];
+    hidden.radius = 0.0f;
+    scene_set_dynamic(scene, handle, hidden);
+    if (scene->free_count == scene->free_capacity) {
+        scene->free_capacity = scene->free_capacity ? scene->free_capacity * 2 : 16;
+        scene->free_handles = (int*)realloc(scene->free_handles, scene->free_capacity * sizeof(int));
+    }
+    scene->free_handles[scene->free_count++] = handle;
 }
 
-Color trace_ray(Ray ray, Scene* scene, int depth) {
+void scene_refit(Scene* scene) {
+    // bvh->area stays what the build made it
+    BVH* bvh = scene->dynamic_bvh;
+    if (bvh && bvh->index_count == scene->dynamic->count) {
+        if (bvh_refit(bvh, scene->dynamic) <= bvh->area * SCENE_REFIT_SLACK) return;
+    }
+    bvh_free(bvh);
+    scene->dynamic_bvh = bvh_build(scene->dynamic, parallel_cpu_count());
+    scene->dynamic_builds++;
+}
+
+// Dynamic objects are only refit in place, so the tree is usable whenever
+// it still covers every one of them
+static BVH* dynamic_tree(Scene* scene) {
+    BVH* bvh = scene->dynamic_bvh;
+    return bvh && bvh->index_count == scene->dynamic->count ? bvh : NULL;
+}
+
+static int static_hit(Scene* scene, Ray ray, float t_min, float t_max, RayHit* hit) {
+    if (scene->bvh) {
+        return bvh_hit(scene->bvh, scene->scene, ray, t_min, t_max, hit);
+    }
+    return sphere_list_hit_any(scene->scene, ray, t_min, t_max, hit);
+}
+
+int scene_hit_dynamic(Scene* scene, Ray ray, float t_min, float t_max, RayHit* hit) {
+    BVH* bvh = dynamic_tree(scene);
+    int found = bvh ? bvh_hit(bvh, scene->dynamic, ray, t_min, t_max, hit)
+                    : sphere_list_hit_any(scene->dynamic, ray, t_min, t_max, hit);
+    if (found) hit->object += SCENE_DYNAMIC_OBJECT;
+    return found;
+}
+
+int scene_hit(Scene* scene, Ray ray, float t_min, float t_max, RayHit* hit) {
+    int found = static_hit(scene, ray, t_min, t_max, hit);
+    if (scene->dynamic->count == 0) return found;
+    
+    // Dynamic objects only matter in front of the static hit
+    RayHit dynamic;
+    if (scene_hit_dynamic(scene, ray, t_min, found ? hit->t : t_max, &dynamic)) {
+        *hit = dynamic;
+        return 1;
+    }
+    return found;
+}
+
+int scene_occluded(Scene* scene, Ray ray, float t_min, float t_max) {
+    int blocked = scene->bvh ? bvh_occluded(scene->bvh, ray, t_min, t_max)
+                             : sphere_list_occluded(scene->scene, ray, t_min, t_max);
+    if (blocked || scene->dynamic->count == 0) return blocked;
+    
+    BVH* bvh = dynamic_tree(scene);
+    return bvh ? bvh_occluded(bvh, ray, t_min, t_max) : sphere_list_occluded(scene->dynamic, ray, t_min, t_max);
+}
+
+// 1 - cos of the half angle a sphere of squared radius radius2 subtends from
+// squared distance distance2, kept accurate for small or far lights
+static float cone_extent(float radius2, float distance2) {
+    float sin2 = radius2 / distance2;
+    return sin2 / (1.0f + sqrtf(1.0f - sin2));
+}
+
+int scene_sample_light(Scene* scene, Vec3 point, Rng* rng, LightSample* sample) {
+    if (scene->light_count == 0) return 0;
+    int pick = (int)(rng_float(rng) * scene->light_count);
+    if (pick >= scene->light_count) pick = scene->light_count - 1;
+    Sphere light = scene->scene->spheres[scene->lights[pick]];
+    
+    Vec3 to_center = vec3_sub(light.center, point);
+    float distance2 = vec3_dot(to_center, to_center);
+    float radius2 = light.radius * light.radius;
+    if (distance2 <= radius2) return 0;
+    float extent = cone_extent(radius2, distance2);
+    
+    // Uniform over the cone around w: 1 - cos theta is uniform in [0, extent]
+    Vec3 w = vec3_mul(to_center, 1.0f / sqrtf(distance2));
+    Vec3 u, v;
+    vec3_basis(w, &u, &v);
+    float s1, s2;
+    rng_sample_2d(rng, &s1, &s2);
+    float one_minus_cos = s1 * extent;
+    float cos_theta = 1.0f - one_minus_cos;
+    float sin_theta = sqrtf(fmaxf(0.0f, one_minus_cos * (2.0f - one_minus_cos)));
+    float sin_phi, cos_phi;
+    sincos_turns(s2, &sin_phi, &cos_phi);
+    sample->direction = vec3_add(vec3_add(vec3_mul(u, cos_phi * sin_theta), vec3_mul(v, sin_phi * sin_theta)),
+                                 vec3_mul(w, cos_theta));
+    
+    // Nearer of the two crossings; the direction can only graze the sphere
+    float b = vec3_dot(sample->direction, to_center);
+    float discriminant = radius2 - (distance2 - b * b);
+    sample->distance = b - sqrtf(fmaxf(0.0f, discriminant));
+    sample->pdf = 1.0f / (2.0f * PI * extent * scene->light_count);
+    Vec3 emission = scene->materials[light.material_id].emission;
+    sample->emission = (Color){emission.x, emission.y, emission.z};
+    return 1;
+}
+
+float scene_light_pdf(Scene* scene, Vec3 origin, const RayHit* hit) {
+    // Every emissive static object is in the light list, dynamic ones never
+    if (!scene->light_sampling || hit->object >= SCENE_DYNAMIC_OBJECT) return 0.0f;
+    Sphere light = scene->scene->spheres[hit->object];
+    if (scene->materials[light.material_id].type != MAT_EMISSIVE) return 0.0f;
+    
+    Vec3 to_center = vec3_sub(light.center, origin);
+    float distance2 = vec3_dot(to_center, to_center);
+    float radius2 = light.radius * light.radius;
+    if (distance2 <= radius2) return 0.0f;
+    return 1.0f / (2.0f * PI * cone_extent(radius2, distance2) * scene->light_count);
+}
+
+Color scene_direct_light(Scene* scene, const RayHit* hit, int bounce_follows, Rng* rng) {
+    Color none = {0.0f, 0.0f, 0.0f};
+    LightSample sample;
+    if (!scene->light_sampling || !scene_sample_light(scene, hit->point, rng, &sample)) return none;
+    
+    float bsdf_pdf = diffuse_pdf(hit->normal, sample.direction);
+    if (bsdf_pdf <= 0.0f) return none;
+    Ray shadow = {hit->point, sample.direction};
+    if (scene_occluded(scene, shadow, 0.001f, sample.distance * (1.0f - SHADOW_EPSILON))) return none;
+    
+    // Emission * cos / pi / pdf, with cos / pi being bsdf_pdf
+    float scale = bsdf_pdf / sample.pdf;
+    if (bounce_follows) scale *= mis_weight(sample.pdf, bsdf_pdf);
+    return (Color){sample.emission.r * scale, sample.emission.g * scale, sample.emission.b * scale};
+}
+
+static uint32_t list_hit_packet(SphereList* list, const RayPacket* packet, float t_min, float t_max, RayHit* hits) {
+    uint32_t mask = 0;
+    for (int k = 0; k < packet->count; k++) {
+        if (sphere_list_hit_any(list, ray_packet_get(packet, k), t_min, t_max, &hits[k])) {
+            mask |= 1u << k;
+        }
+    }
+    return mask;
+}
+
+uint32_t scene_hit_static_packet(Scene* scene, const RayPacket* packet, float t_min, float t_max, RayHit* hits) {
+    return scene->bvh ? bvh_hit_packet(scene->bvh, scene->scene, packet, t_min, t_max, hits)
+                      : list_hit_packet(scene->scene, packet, t_min, t_max, hits);
+}
+
+uint32_t scene_hit_packet(Scene* scene, const RayPacket* packet, float t_min, float t_max, RayHit* hits) {
+    uint32_t mask = scene_hit_static_packet(scene, packet, t_min, t_max, hits);
+    if (scene->dynamic->count == 0) return mask;
+    
+    RayHit dynamic[RAY_PACKET_MAX];
+    BVH* bvh = dynamic_tree(scene);
+    uint32_t dynamic_mask = bvh ? bvh_hit_packet(bvh, scene->dynamic, packet, t_min, t_max, dynamic)
+                                : list_hit_packet(scene->dynamic, packet, t_min, t_max, dynamic);
+    for (int k = 0; k < packet->count; k++) {
+        uint32_t bit = 1u << k;
+        if ((dynamic_mask & bit) && (!(mask & bit) || dynamic[k].t < hits[k].t)) {
+            hits[k] = dynamic[k];
+            hits[k].object += SCENE_DYNAMIC_OBJECT;
+            mask |= bit;
+        }
+    }
+    return mask;
+}
+
+static Color shade_path(Ray ray, RayHit* hit, Scene* scene, int depth, Rng* rng, float bsdf_pdf);
+
+// bsdf_pdf is the pdf the diffuse bounce that made ray drew it with, or 0
+// when no light sample competes for what it finds (camera rays, metal)
+static Color trace_path(Ray ray, Scene* scene, int depth, Rng* rng, float bsdf_pdf) {
     if (depth <= 0) {
         return (Color){0.0f, 0.0f, 0.0f};
     }
     
     RayHit hit = {0};
-    if (sphere_list_hit_any(scene->scene, ray, 0.001f, 1e6f, &hit)) {
-        Material mat = scene->materials[hit.material_id];
+    scene_hit(scene, ray, 0.001f, 1e6f, &hit);
+    return shade_path(ray, &hit, scene, depth, rng, bsdf_pdf);
+}
+
+Color trace_ray(Ray ray, Scene* scene, int depth, Rng* rng) {
+    return trace_path(ray, scene, depth, rng, 0.0f);
+}
+
+Color trace_ray_shade(Ray ray, RayHit* hit, Scene* scene, int depth, Rng* rng) {
+    return shade_path(ray, hit, scene, depth, rng, 0.0f);
+}
+
+static Color shade_path(Ray ray, RayHit* hit, Scene* scene, int depth, Rng* rng, float bsdf_pdf) {
+    if (depth <= 0) {
+        return (Color){0.0f, 0.0f, 0.0f};
+    }
+    
+    if (hit->hit) {
+        Material mat = scene->materials[hit->material_id];
         
         if (mat.type == MAT_DIFFUSE) {
-            // Diffuse scattering
-            Vec3 scatter_dir = vec3_add(hit.normal, random_unit_vector());
-            if (vec3_length(scatter_dir) < 0.001f) {
-                scatter_dir = hit.normal;
-            }
-            Ray scattered = ray_create(hit.point, scatter_dir);
-            Color recursive = trace_ray(scattered, scene, depth - 1);
+            // Light sampled directly, then diffuse scattering for the rest
+            Color direct = scene_direct_light(scene, hit, depth > 1, rng);
+            float u, v;
+            rng_sample_2d(rng, &u, &v);
+            Ray scattered = {hit->point, vec3_cosine_direction(hit->normal, u, v)};
+            float pdf = scene->light_count > 0 ? diffuse_pdf(hit->normal, scattered.direction) : 0.0f;
+            Color recursive = trace_path(scattered, scene, depth - 1, rng, pdf);
             
             return (Color){
-                mat.albedo.x * recursive.r * 0.7f,
-                mat.albedo.y * recursive.g * 0.7f,
-                mat.albedo.z * recursive.b * 0.7f
+                mat.albedo.x * (recursive.r + direct.r) * DIFFUSE_ATTENUATION,
+                mat.albedo.y * (recursive.g + direct.g) * DIFFUSE_ATTENUATION,
+                mat.albedo.z * (recursive.b + direct.b) * DIFFUSE_ATTENUATION
             };
         }
         else if (mat.type == MAT_METAL) {
             // Metal reflection
             Vec3 reflected = vec3_sub(ray.direction, 
-                vec3_mul(hit.normal, 2.0f * vec3_dot(ray.direction, hit.normal)));
+                vec3_mul(hit->normal, 2.0f * vec3_dot(ray.direction, hit->normal)));
             
-            Vec3 fuzz = vec3_mul(random_in_unit_sphere(), mat.roughness);
+            float u, v;
+            rng_sample_2d(rng, &u, &v);
+            Vec3 fuzz = vec3_mul(vec3_in_unit_sphere(u, v, rng_float(rng)), mat.roughness);
             reflected = vec3_add(reflected, fuzz);
             reflected = vec3_normalize(reflected);
             
-            if (vec3_dot(reflected, hit.normal) > 0) {
-                Ray scattered = ray_create(hit.point, reflected);
-                Color recursive = trace_ray(scattered, scene, depth - 1);
+            if (vec3_dot(reflected, hit->normal) > 0) {
+                Ray scattered = ray_create(hit->point, reflected);
+                Color recursive = trace_path(scattered, scene, depth - 1, rng, 0.0f);
                 
                 return (Color){
                     mat.albedo.x * recursive.r,
@@ -91,18 +336,43 @@ Color trace_ray(Ray ray, Scene* scene, int depth) {
                 return (Color){0.0f, 0.0f, 0.0f};
             }
         }
+        else if (mat.type == MAT_EMISSIVE) {
+            // Shares what it gives with the light sample that could have found it
+            float weight = bsdf_pdf > 0.0f ? mis_weight(bsdf_pdf, scene_light_pdf(scene, ray.origin, hit)) : 1.0f;
+            return (Color){mat.emission.x * weight, mat.emission.y * weight, mat.emission.z * weight};
+        }
         
         // Fallback shading
-        float r = (hit.normal.x + 1.0f) / 2.0f;
-        float g = (hit.normal.y + 1.0f) / 2.0f;
-        float b = (hit.normal.z + 1.0f) / 2.0f;
+        float r = (hit->normal.x + 1.0f) / 2.0f;
+        float g = (hit->normal.y + 1.0f) / 2.0f;
+        float b = (hit->normal.z + 1.0f) / 2.0f;
         return (Color){r, g, b};
     }
     
-    // Sky gradient
-    float t = (ray.direction.y + 1.0f) / 2.0f;
+    Color sky = sky_color(ray.direction);
+    return (Color){sky.r * scene->sky_intensity, sky.g * scene->sky_intensity, sky.b * scene->sky_intensity};
+}
+
+Color sky_color(Vec3 direction) {
+    float t = (direction.y + 1.0f) / 2.0f;
     float r = 1.0f * (1.0f - t) + 0.5f * t;
     float g = 1.0f * (1.0f - t) + 0.7f * t;
     float b = 1.0f * (1.0f - t) + 1.0f * t;
     return (Color){r, g, b};
 }
+
+void trace_packet(Scene* scene, const Ray* rays, int count, int depth, Rng* rngs, Color* colors) {
+    if (count > RAY_PACKET_MAX) count = RAY_PACKET_MAX;
+    
+    RayPacket packet;
+    RayHit hits[RAY_PACKET_MAX];
+    memset(hits, 0, sizeof(hits));
+    ray_packet_init(&packet, rays, count);
+    
+    if (depth > 0) {
+        scene_hit_packet(scene, &packet, 0.001f, 1e6f, hits);
+    }
+    for (int k = 0; k < count; k++) {
+        colors[k] = trace_ray_shade(rays[k], &hits[k], scene, depth, &rngs[k]);
+    }
+}
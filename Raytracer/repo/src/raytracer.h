@@ -5,21 +5,128 @@
 #include "ray.h"
 #include "sphere.h"
 #include "material.h"
+#include "bvh.h"
+#include "packet.h"
 
 #define MAX_MATERIALS 64
 #define MAX_DEPTH 5
 
+// Rebuild the dynamic tree once refitting has left its boxes this many
+// times bigger in total than a fresh build had them
+#define SCENE_REFIT_SLACK 2.0f
+
+// RayHit.object from scene_hit names static objects by index and dynamic
+// ones by handle plus this
+#define SCENE_DYNAMIC_OBJECT 0x40000000
+
+// Share of the light a diffuse surface reflects, on top of its albedo
+#define DIFFUSE_ATTENUATION 0.7f
+
 typedef struct {
     Material materials[MAX_MATERIALS];
     int material_count;
     SphereList* scene;
+    BVH* bvh;  // Built by scene_build_bvh, dropped whenever an object is added
+    int revision;  // Bumped whenever the static objects change
+    
+    // Static objects with emissive materials, sampled directly from diffuse
+    // hits. Emissive dynamic objects light the scene only where bounces
+    // happen to hit them.
+    int* lights;
+    int light_count;
+    int light_capacity;
+    int light_sampling;   // 1 = next-event estimation at diffuse hits, 0 = bounces only
+    float sky_intensity;  // Scales sky_color; 0 for scenes lit only by their own lights
+    
+    // Objects that move, in a tree of their own. Each keeps the handle
+    // scene_add_dynamic returned (its index in dynamic) for its lifetime, and
+    // moving them only refits the tree, so that costs in proportion to the
+    // dynamic objects however big the static part is.
+    SphereList* dynamic;
+    BVH* dynamic_bvh;    // Over the first dynamic_bvh->index_count objects; see scene_refit
+    int* free_handles;   // Removed objects, reused by scene_add_dynamic
+    int free_count;
+    int free_capacity;
+    int dynamic_builds;  // Times the dynamic tree was built rather than refit
 } Scene;
 
 Scene* scene_create();
 void scene_free(Scene* scene);
 int scene_add_material(Scene* scene, Material mat);
 void scene_add_object(Scene* scene, Sphere sphere);
+void scene_clear_objects(Scene* scene);  // Static objects only
+void scene_build_bvh(Scene* scene);
+
+// Dynamic objects. Removed objects are hidden (radius 0) until their handle
+// is reused. Call scene_refit after moving, adding or removing, before
+// tracing; until then the dynamic objects are hit by a linear scan.
+int scene_add_dynamic(Scene* scene, Sphere sphere);
+void scene_set_dynamic(Scene* scene, int handle, Sphere sphere);
+void scene_remove_dynamic(Scene* scene, int handle);
+void scene_refit(Scene* scene);
+
+int scene_hit(Scene* scene, Ray ray, float t_min, float t_max, RayHit* hit);
+uint32_t scene_hit_packet(Scene* scene, const RayPacket* packet, float t_min, float t_max, RayHit* hits);
+
+// The static and dynamic halves scene_hit_packet combines, for callers that
+// keep static hits from frame to frame
+uint32_t scene_hit_static_packet(Scene* scene, const RayPacket* packet, float t_min, float t_max, RayHit* hits);
+int scene_hit_dynamic(Scene* scene, Ray ray, float t_min, float t_max, RayHit* hit);
+
+// 1 if anything at all is hit within [t_min, t_max], without finding the
+// closest hit, for shadow rays
+int scene_occluded(Scene* scene, Ray ray, float t_min, float t_max);
+
+// A direction from a point toward one of the scene's lights
+typedef struct {
+    Vec3 direction;  // Unit length
+    float distance;  // To the light's surface along direction
+    float pdf;       // Per unit solid angle, over the pick of light too
+    Color emission;
+} LightSample;
+
+// Pick a light uniformly and a direction uniformly within the cone it
+// subtends from point. Returns 0 when there are no lights or point is inside
+// the one picked.
+int scene_sample_light(Scene* scene, Vec3 point, Rng* rng, LightSample* sample);
+
+// The pdf scene_sample_light would have given the direction from origin to
+// hit, 0 when hit is not on a sampled light
+float scene_light_pdf(Scene* scene, Vec3 origin, const RayHit* hit);
+
+// Power heuristic weight of a sample drawn with pdf against one other
+// strategy that could have drawn it with other_pdf
+static inline float mis_weight(float pdf, float other_pdf) {
+    float a = pdf * pdf;
+    return a > 0.0f ? a / (a + other_pdf * other_pdf) : 0.0f;
+}
+
+// Light arriving at a diffuse hit straight from one sampled light, times
+// cos / pi: multiply by the albedo and DIFFUSE_ATTENUATION for the reflected
+// radiance. Weighted against the cosine-sampled bounce finding the same light
+// when bounce_follows, otherwise counted in full.
+Color scene_direct_light(Scene* scene, const RayHit* hit, int bounce_follows, Rng* rng);
+
+// The cosine-weighted bounce direction's pdf for a diffuse hit with normal
+static inline float diffuse_pdf(Vec3 normal, Vec3 direction) {
+    float cosine = normal.x * direction.x + normal.y * direction.y + normal.z * direction.z;
+    return cosine > 0.0f ? cosine * (1.0f / 3.14159265f) : 0.0f;
+}
+
+// Random numbers for scattering come from rng, so a path seeded the same way
+// always traces the same way
+Color trace_ray(Ray ray, Scene* scene, int depth, Rng* rng);
+
+// Shade a ray whose first hit is already known (hit->hit == 0 means it
+// escaped to the sky). Bounces are traced with trace_ray.
+Color trace_ray_shade(Ray ray, RayHit* hit, Scene* scene, int depth, Rng* rng);
+
+// Background seen by rays that leave the scene, before sky_intensity
+Color sky_color(Vec3 direction);
 
-Color trace_ray(Ray ray, Scene* scene, int depth);
+// Trace up to RAY_PACKET_MAX coherent primary rays: first hits are found as
+// one packet, secondary bounces fall back to single rays. Each ray draws from
+// its own generator in rngs.
+void trace_packet(Scene* scene, const Ray* rays, int count, int depth, Rng* rngs, Color* colors);
 
 #endif
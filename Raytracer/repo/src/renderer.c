@@ -1,14 +1,78 @@
 #include "renderer.h"
+#include "parallel.h"
+#include "shade.h"
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define RENDERER_FAR_DEPTH 999999.0f
+
+// Top-down projection scale
+#define PIXELS_PER_UNIT 50
+
+// The sky brightens and darkens in this many steps, so the background layer
+// is redrawn about once every ten seconds of game time rather than each frame
+#define SKY_DARKNESS_LEVELS 64
+
+typedef struct {
+    int x0, y0, x1, y1;
+} ClipRect;
+
+// Fast clear: mark every tile far without touching depthbuffer
+static void tile_depth_clear(Renderer* renderer) {
+    int tile_count = renderer->draws.tiles_x * renderer->draws.tiles_y;
+    for (int t = 0; t < tile_count; t++) {
+        renderer->tile_depth[t].min = RENDERER_FAR_DEPTH;
+        renderer->tile_depth[t].max = RENDERER_FAR_DEPTH;
+        renderer->tile_depth[t].cleared = 1;
+    }
+}
+
 Renderer* renderer_create(int width, int height) {
     Renderer* renderer = (Renderer*)malloc(sizeof(Renderer));
     renderer->width = width;
     renderer->height = height;
     renderer->framebuffer = (uint32_t*)malloc(width * height * sizeof(uint32_t));
     renderer->depthbuffer = (float*)malloc(width * height * sizeof(float));
+    
+    DrawList* draws = &renderer->draws;
+    draws->capacity = 256;
+    draws->count = 0;
+    draws->commands = (DrawCommand*)malloc(draws->capacity * sizeof(DrawCommand));
+    draws->tiles_x = (width + RENDERER_TILE_SIZE - 1) / RENDERER_TILE_SIZE;
+    draws->tiles_y = (height + RENDERER_TILE_SIZE - 1) / RENDERER_TILE_SIZE;
+    draws->start = (int*)malloc((draws->tiles_x * draws->tiles_y + 1) * sizeof(int));
+    draws->item_capacity = 1024;
+    draws->items = (int*)malloc(draws->item_capacity * sizeof(int));
+    
+    int tile_count = draws->tiles_x * draws->tiles_y;
+    renderer->tile_depth = (TileDepth*)malloc(tile_count * sizeof(TileDepth));
+    tile_depth_clear(renderer);
+    
+    BackgroundLayer* background = &renderer->background;
+    background->color = (uint32_t*)malloc(width * height * sizeof(uint32_t));
+    background->depth = (float*)malloc(width * height * sizeof(float));
+    background->tile_depth = (TileDepth*)malloc(tile_count * sizeof(TileDepth));
+    background->sky_level = -1;
+    background->env = NULL;
+    background->structure_revision = 0;
+    background->valid = 0;
+    background->rebuilds = 0;
+    
+    renderer->sprites.colors = NULL;
+    renderer->sprites.sets = NULL;
+    renderer->sprites.color_count = 0;
+    renderer->sprites.builds = 0;
+    renderer->humanoid_sprites = 1;
+    renderer->visible = NULL;
+    renderer->visible_capacity = 0;
+    
+    renderer->thread_count = parallel_cpu_count();
+    renderer->fragments = 0;
     return renderer;
 }
 
@@ -16,15 +80,75 @@ void renderer_free(Renderer* renderer) {
     if (renderer) {
         free(renderer->framebuffer);
         free(renderer->depthbuffer);
+        free(renderer->tile_depth);
+        free(renderer->draws.commands);
+        free(renderer->draws.start);
+        free(renderer->draws.items);
+        free(renderer->background.color);
+        free(renderer->background.depth);
+        free(renderer->background.tile_depth);
+        for (int set = 0; set < renderer->sprites.color_count; set++) {
+            for (int i = 0; i < RENDERER_SPRITE_SET_SIZE; i++) {
+                free(renderer->sprites.sets[set][i].color);
+                free(renderer->sprites.sets[set][i].depth);
+            }
+            free(renderer->sprites.sets[set]);
+        }
+        free(renderer->sprites.sets);
+        free(renderer->sprites.colors);
+        free(renderer->visible);
         free(renderer);
     }
 }
 
+void renderer_set_threads(Renderer* renderer, int threads) {
+    if (!renderer) return;
+    renderer->thread_count = threads > 0 ? threads : parallel_cpu_count();
+}
+
+void renderer_invalidate_background(Renderer* renderer) {
+    if (renderer) renderer->background.valid = 0;
+}
+
+void renderer_set_humanoid_sprites(Renderer* renderer, int enabled) {
+    if (renderer) renderer->humanoid_sprites = enabled;
+}
+
+static void tile_rect(Renderer* renderer, int t, ClipRect* tile) {
+    tile->x0 = (t % renderer->draws.tiles_x) * RENDERER_TILE_SIZE;
+    tile->y0 = (t / renderer->draws.tiles_x) * RENDERER_TILE_SIZE;
+    tile->x1 = tile->x0 + RENDERER_TILE_SIZE < renderer->width ? tile->x0 + RENDERER_TILE_SIZE : renderer->width;
+    tile->y1 = tile->y0 + RENDERER_TILE_SIZE < renderer->height ? tile->y0 + RENDERER_TILE_SIZE : renderer->height;
+}
+
+// Give a fast-cleared tile real far depth texels before something is drawn into it
+static void tile_depth_resolve(Renderer* renderer, int t) {
+    ClipRect tile;
+    tile_rect(renderer, t, &tile);
+    for (int y = tile.y0; y < tile.y1; y++) {
+        float* row = renderer->depthbuffer + y * renderer->width;
+        for (int x = tile.x0; x < tile.x1; x++) {
+            row[x] = RENDERER_FAR_DEPTH;
+        }
+    }
+    renderer->tile_depth[t].cleared = 0;
+}
+
 void renderer_clear(Renderer* renderer, uint32_t color) {
     if (!renderer) return;
     for (int i = 0; i < renderer->width * renderer->height; i++) {
         renderer->framebuffer[i] = color;
-        renderer->depthbuffer[i] = 999999.0f;  // Far depth
+    }
+    
+    // Depth is cleared through the tile flags alone
+    tile_depth_clear(renderer);
+}
+
+void renderer_resolve_depth(Renderer* renderer) {
+    if (!renderer) return;
+    int tile_count = renderer->draws.tiles_x * renderer->draws.tiles_y;
+    for (int t = 0; t < tile_count; t++) {
+        if (renderer->tile_depth[t].cleared) tile_depth_resolve(renderer, t);
     }
 }
 
@@ -40,53 +164,206 @@ static uint32_t color_from_rgb(float r, float g, float b) {
     return (ri << 16) | (gi << 8) | bi;
 }
 
-static void set_pixel(Renderer* renderer, int x, int y, uint32_t color) {
-    if (x >= 0 && x < renderer->width && y >= 0 && y < renderer->height) {
-        renderer->framebuffer[y * renderer->width + x] = color;
+// Write colors[0 .. count - 1] at depth to row y from x. Callers clip to
+// the screen, so only the depth test is left, and they drop even that when
+// the tile's hierarchical Z says it always passes.
+static inline void write_span(Renderer* renderer, int x, int y, int count, const uint32_t* colors, float depth, int depth_test) {
+    uint32_t* frame = renderer->framebuffer + y * renderer->width + x;
+    float* depths = renderer->depthbuffer + y * renderer->width + x;
+    int i = 0;
+    
+#if defined(__SSE2__)
+    __m128 z = _mm_set1_ps(depth);
+    for (; i + 4 <= count; i += 4) {
+        __m128i c = _mm_loadu_si128((const __m128i*)(colors + i));
+        if (!depth_test) {
+            _mm_storeu_si128((__m128i*)(frame + i), c);
+            _mm_storeu_ps(depths + i, z);
+            continue;
+        }
+        __m128 old = _mm_loadu_ps(depths + i);
+        __m128 pass = _mm_cmplt_ps(z, old);
+        __m128i mask = _mm_castps_si128(pass);
+        __m128i kept = _mm_loadu_si128((const __m128i*)(frame + i));
+        _mm_storeu_si128((__m128i*)(frame + i), _mm_or_si128(_mm_and_si128(mask, c), _mm_andnot_si128(mask, kept)));
+        _mm_storeu_ps(depths + i, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, old)));
     }
-}
-
-static void set_pixel_depth(Renderer* renderer, int x, int y, uint32_t color, float depth) {
-    if (x >= 0 && x < renderer->width && y >= 0 && y < renderer->height) {
-        int idx = y * renderer->width + x;
-        if (depth < renderer->depthbuffer[idx]) {
-            renderer->framebuffer[idx] = color;
-            renderer->depthbuffer[idx] = depth;
+#endif
+    
+    for (; i < count; i++) {
+        if (!depth_test || depth < depths[i]) {
+            frame[i] = colors[i];
+            depths[i] = depth;
         }
     }
 }
 
-void renderer_draw_sky_gothic(Renderer* renderer, float time_of_day) {
-    if (!renderer) return;
+static inline int project_x(Renderer* renderer, Vec3 pos) {
+    return (int)(pos.x * PIXELS_PER_UNIT + renderer->width / 2);
+}
+
+static inline int project_y(Renderer* renderer, Vec3 pos) {
+    return (int)(-pos.z * PIXELS_PER_UNIT + renderer->height / 2);
+}
+
+// ---- Command builders ----
+// Each fills cmd and returns 0 if nothing of it lands on screen
+
+static int command_bounds(Renderer* renderer, DrawCommand* cmd, int x0, int y0, int x1, int y1) {
+    cmd->x0 = x0 < 0 ? 0 : x0;
+    cmd->y0 = y0 < 0 ? 0 : y0;
+    cmd->x1 = x1 > renderer->width ? renderer->width : x1;
+    cmd->y1 = y1 > renderer->height ? renderer->height : y1;
+    return cmd->x0 < cmd->x1 && cmd->y0 < cmd->y1;
+}
+
+static int command_sky(Renderer* renderer, DrawCommand* cmd, float time_of_day) {
+    cmd->type = DRAW_SKY;
+    cmd->time_of_day = time_of_day;
+    return command_bounds(renderer, cmd, 0, 0, renderer->width, renderer->height / 2);
+}
+
+static int command_ground(Renderer* renderer, DrawCommand* cmd) {
+    cmd->type = DRAW_GROUND;
+    return command_bounds(renderer, cmd, 0, renderer->height / 2, renderer->width, renderer->height);
+}
+
+static int command_box(Renderer* renderer, DrawCommand* cmd, Vec3 pos, Vec3 size, uint32_t color) {
+    cmd->type = DRAW_BOX;
+    cmd->ax = project_x(renderer, pos);
+    cmd->ay = project_y(renderer, pos);
+    cmd->size_x = (int)(size.x * PIXELS_PER_UNIT / 2);
+    cmd->size_y = (int)(size.y * PIXELS_PER_UNIT);
+    cmd->color = color;
+    cmd->depth = pos.z;
+    
+    // Front face spans y = -height .. 0 above the anchor
+    return command_bounds(renderer, cmd, cmd->ax - cmd->size_x, cmd->ay - cmd->size_y,
+                          cmd->ax + cmd->size_x + 1, cmd->ay + 1);
+}
+
+static int command_sphere(Renderer* renderer, DrawCommand* cmd, Vec3 pos, float radius, uint32_t color) {
+    cmd->type = DRAW_SPHERE;
+    cmd->ax = project_x(renderer, pos);
+    cmd->ay = project_y(renderer, pos);
+    cmd->size_x = (int)(radius * PIXELS_PER_UNIT);
+    cmd->color = color;
+    cmd->depth = pos.z;
+    int r = cmd->size_x;
+    return command_bounds(renderer, cmd, cmd->ax - r, cmd->ay - r, cmd->ax + r + 1, cmd->ay + r + 1);
+}
+
+static int command_cylinder(Renderer* renderer, DrawCommand* cmd, Vec3 start, Vec3 end, float radius, uint32_t color) {
+    cmd->type = DRAW_CYLINDER;
+    cmd->ax = project_x(renderer, start);
+    cmd->ay = project_y(renderer, start);
+    cmd->bx = project_x(renderer, end);
+    cmd->by = project_y(renderer, end);
+    cmd->size_x = (int)(radius * PIXELS_PER_UNIT);
+    cmd->color = color;
+    cmd->depth = (start.z + end.z) * 0.5f;
+    int r = cmd->size_x;
+    int min_x = cmd->ax < cmd->bx ? cmd->ax : cmd->bx;
+    int max_x = cmd->ax > cmd->bx ? cmd->ax : cmd->bx;
+    int min_y = cmd->ay < cmd->by ? cmd->ay : cmd->by;
+    int max_y = cmd->ay > cmd->by ? cmd->ay : cmd->by;
+    return command_bounds(renderer, cmd, min_x - r, min_y - r, max_x + r + 1, max_y + r + 1);
+}
+
+static int command_projectile(Renderer* renderer, DrawCommand* cmd, Vec3 pos, uint32_t color) {
+    cmd->type = DRAW_PROJECTILE;
+    cmd->ax = project_x(renderer, pos);
+    cmd->ay = project_y(renderer, pos);
+    cmd->color = color;
+    cmd->depth = pos.z;
+    return command_bounds(renderer, cmd, cmd->ax - 2, cmd->ay - 2, cmd->ax + 3, cmd->ay + 3);
+}
+
+static int command_rect(Renderer* renderer, DrawCommand* cmd, Vec3 pos, Vec3 size, uint32_t color) {
+    cmd->type = DRAW_RECT;
+    cmd->ax = project_x(renderer, pos);
+    cmd->ay = project_y(renderer, pos);
+    cmd->size_x = (int)(size.x * PIXELS_PER_UNIT / 2);
+    cmd->size_y = (int)(size.z * PIXELS_PER_UNIT / 2);
+    cmd->color = color;
+    cmd->depth = pos.z;
+    return command_bounds(renderer, cmd, cmd->ax - cmd->size_x, cmd->ay - cmd->size_y,
+                          cmd->ax + cmd->size_x + 1, cmd->ay + cmd->size_y + 1);
+}
+
+// A pre-rasterized humanoid whose position's pixel is the sprite's origin
+static int command_sprite(Renderer* renderer, DrawCommand* cmd, const HumanoidSprite* sprite, Vec3 pos) {
+    cmd->type = DRAW_SPRITE;
+    cmd->ax = (int)floorf(pos.x * PIXELS_PER_UNIT + renderer->width / 2) - sprite->origin_x;
+    cmd->ay = (int)floorf(-pos.z * PIXELS_PER_UNIT + renderer->height / 2) - sprite->origin_y;
+    cmd->sprite = sprite;
+    cmd->depth = pos.z + sprite->near;
+    return command_bounds(renderer, cmd, cmd->ax, cmd->ay, cmd->ax + sprite->width, cmd->ay + sprite->height);
+}
+
+// Legs, torso, arms, then head; returns the number of commands written to cmds (up to 6)
+static int command_humanoid(Renderer* renderer, DrawCommand* cmds, Humanoid* humanoid, uint32_t color) {
+    int count = 0;
+    float limb_radius = humanoid->limb_scale * 0.6f;
+    Vec3 torso_top = vec3_add(humanoid->torso_pos, vec3_new(0.0f, 0.3f, 0.0f));
     
+    count += command_cylinder(renderer, &cmds[count], humanoid->torso_pos, humanoid->left_leg_pos, limb_radius, color);
+    count += command_cylinder(renderer, &cmds[count], humanoid->torso_pos, humanoid->right_leg_pos, limb_radius, color);
+    count += command_cylinder(renderer, &cmds[count], humanoid->torso_pos, torso_top, humanoid->limb_scale * 1.2f, color);
+    count += command_cylinder(renderer, &cmds[count], torso_top, humanoid->left_arm_pos, limb_radius, color);
+    count += command_cylinder(renderer, &cmds[count], torso_top, humanoid->right_arm_pos, limb_radius, color);
+    count += command_sphere(renderer, &cmds[count], humanoid->head_pos, humanoid->head_radius, color);
+    return count;
+}
+
+// ---- Rasterizers ----
+// Each draws the part of cmd inside the clip rectangle [x0, x1) x [y0, y1),
+// which must lie on screen. Pixels come out exactly as from an unclipped draw.
+
+static int clip_command(const DrawCommand* cmd, const ClipRect* tile, ClipRect* clip) {
+    clip->x0 = cmd->x0 > tile->x0 ? cmd->x0 : tile->x0;
+    clip->y0 = cmd->y0 > tile->y0 ? cmd->y0 : tile->y0;
+    clip->x1 = cmd->x1 < tile->x1 ? cmd->x1 : tile->x1;
+    clip->y1 = cmd->y1 < tile->y1 ? cmd->y1 : tile->y1;
+    return clip->x0 < clip->x1 && clip->y0 < clip->y1;
+}
+
+static int sky_level(float time_of_day) {
     // Gothic/dark atmosphere with time-based lighting
     float hour_cycle = fmodf(time_of_day / 24.0f, 1.0f);
     float darkness = sinf(hour_cycle * 3.14159f);  // 0 at night, 1 at day
     darkness = darkness < 0.0f ? 0.0f : darkness;
+    return (int)(darkness * SKY_DARKNESS_LEVELS + 0.5f);
+}
+
+static uint32_t sky_row_color(Renderer* renderer, float darkness, int y) {
+    float t = (float)y / (renderer->height / 2);
     
-    for (int y = 0; y < renderer->height / 2; y++) {
-        float t = (float)y / (renderer->height / 2);
-        
-        // Gothic dark purple/blue gradient
-        float r_val = 0.1f + (0.2f * darkness) + (t * 0.15f);
-        float g_val = 0.05f + (0.1f * darkness) + (t * 0.1f);
-        float b_val = 0.3f + (0.2f * darkness) + (t * 0.3f);
-        
-        // Add some mist/fog effect
-        float mist = sinf(y * 0.01f) * 0.05f;
-        b_val += mist;
-        
-        uint32_t sky_color = color_from_rgb(r_val, g_val, b_val);
-        
-        for (int x = 0; x < renderer->width; x++) {
-            set_pixel(renderer, x, y, sky_color);
+    // Gothic dark purple/blue gradient
+    float r_val = 0.1f + (0.2f * darkness) + (t * 0.15f);
+    float g_val = 0.05f + (0.1f * darkness) + (t * 0.1f);
+    float b_val = 0.3f + (0.2f * darkness) + (t * 0.3f);
+    
+    // Add some mist/fog effect
+    float mist = sinf(y * 0.01f) * 0.05f;
+    b_val += mist;
+    
+    return color_from_rgb(r_val, g_val, b_val);
+}
+
+static void raster_sky(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip) {
+    float darkness = (float)sky_level(cmd->time_of_day) / SKY_DARKNESS_LEVELS;
+    
+    for (int y = clip->y0; y < clip->y1; y++) {
+        uint32_t sky_color = sky_row_color(renderer, darkness, y);
+        uint32_t* row = renderer->framebuffer + y * renderer->width;
+        for (int x = clip->x0; x < clip->x1; x++) {
+            row[x] = sky_color;
         }
     }
 }
 
-void renderer_draw_ground_gothic(Renderer* renderer) {
-    if (!renderer) return;
-    
+static void raster_ground(Renderer* renderer, const ClipRect* clip) {
     // Dark gothic stone ground
     uint32_t ground_colors[3] = {
         color_from_rgb(0.15f, 0.15f, 0.2f),   // Dark stone
@@ -95,262 +372,754 @@ void renderer_draw_ground_gothic(Renderer* renderer) {
     };
     
     // Checkered stone pattern
-    for (int y = renderer->height / 2; y < renderer->height; y++) {
-        for (int x = 0; x < renderer->width; x++) {
+    for (int y = clip->y0; y < clip->y1; y++) {
+        uint32_t* row = renderer->framebuffer + y * renderer->width;
+        for (int x = clip->x0; x < clip->x1; x++) {
             int pattern = ((x / 32) + (y / 32)) % 3;
-            set_pixel(renderer, x, y, ground_colors[pattern]);
+            row[x] = ground_colors[pattern];
         }
     }
 }
 
-static void renderer_draw_box_3d(Renderer* renderer, Vec3 pos, Vec3 size, uint32_t color) {
-    if (!renderer) return;
-    
-    // Project center to 2D
-    int cx = (int)(pos.x * 50 + renderer->width / 2);
-    int cy = (int)(-pos.z * 50 + renderer->height / 2);
-    
-    // Dimensions in screen space
-    int half_w = (int)(size.x * 50 / 2);
-    int half_h = (int)(size.z * 50 / 2);
-    int height_pixels = (int)(size.y * 50);
+// Largest w with w * w <= n
+static inline int isqrt(int n) {
+    int w = (int)sqrtf((float)n);
+    while (w * w > n) w--;
+    while ((w + 1) * (w + 1) <= n) w++;
+    return w;
+}
+
+// Sphere shading falls off with distance from the centre. The ramp maps
+// d^2 >> shift to an 8.8 shade, with shift just large enough to keep it
+// under SHADE_RAMP_SIZE entries, so it is exact for radii up to 31 pixels.
+#define SHADE_RAMP_SIZE 1024
+
+static int radial_ramp(int r, uint16_t* ramp) {
+    int shift = 0;
+    while ((r * r >> shift) >= SHADE_RAMP_SIZE) shift++;
+    for (int i = 0; i <= r * r >> shift; i++) {
+        float depth = sqrtf((float)(i << shift)) / r;
+        ramp[i] = r > 0 ? shade_fixed(1.0f - depth * 0.3f) : SHADE_ONE;
+    }
+    return shift;
+}
+
+// The rasterizers below walk scanlines, work out where the shape starts and
+// ends on each one, and visit every covered pixel exactly once: shade
+// factors for the span, then the span's colors in one shade_span call,
+// then one write_span. Clip rectangles are at most a tile wide, which
+// bounds the span buffers. Each returns the number of pixels it shaded.
+
+static inline int raster_box(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip, int depth_test) {
+    // Shading only varies across the face, so work out each column once
+    uint16_t shades[RENDERER_TILE_SIZE];
+    uint32_t colors[RENDERER_TILE_SIZE];
+    int half_w = cmd->size_x;
+    int width = clip->x1 - clip->x0;
+    for (int i = 0; i < width; i++) {
+        int x = clip->x0 + i - cmd->ax;
+        float depth_factor = half_w > 0 ? 1.0f - ((float)abs(x) / half_w) * 0.2f : 1.0f;
+        shades[i] = shade_fixed(depth_factor);
+    }
+    shade_span(cmd->color, shades, width, colors);
     
     // Draw front face (solid)
-    for (int y = -height_pixels; y <= 0; y++) {
-        for (int x = -half_w; x <= half_w; x++) {
-            float depth_factor = 1.0f - (fabsf((float)x) / half_w) * 0.2f;
-            
-            uint32_t r_val = ((color >> 16) & 0xFF);
-            uint32_t g_val = ((color >> 8) & 0xFF);
-            uint32_t b_val = (color & 0xFF);
-            
-            r_val = (uint32_t)(r_val * depth_factor);
-            g_val = (uint32_t)(g_val * depth_factor);
-            b_val = (uint32_t)(b_val * depth_factor);
-            
-            uint32_t shaded = (r_val << 16) | (g_val << 8) | b_val;
-            set_pixel_depth(renderer, cx + x, cy + y, shaded, pos.z);
+    for (int py = clip->y0; py < clip->y1; py++) {
+        write_span(renderer, clip->x0, py, width, colors, cmd->depth, depth_test);
+    }
+    return width * (clip->y1 - clip->y0);
+}
+
+static inline int raster_sphere(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip, int depth_test) {
+    uint16_t ramp[SHADE_RAMP_SIZE];
+    uint16_t shades[RENDERER_TILE_SIZE];
+    uint32_t colors[RENDERER_TILE_SIZE];
+    int r = cmd->size_x;
+    if (r < 0) return 0;
+    int shift = radial_ramp(r, ramp);
+    int y0 = cmd->ay - r > clip->y0 ? cmd->ay - r : clip->y0;
+    int y1 = cmd->ay + r + 1 < clip->y1 ? cmd->ay + r + 1 : clip->y1;
+    int fragments = 0;
+    
+    // Draw filled circle
+    for (int py = y0; py < y1; py++) {
+        int y = py - cmd->ay;
+        int w = isqrt(r * r - y * y);
+        int x0 = cmd->ax - w > clip->x0 ? cmd->ax - w : clip->x0;
+        int x1 = cmd->ax + w + 1 < clip->x1 ? cmd->ax + w + 1 : clip->x1;
+        if (x0 >= x1) continue;
+        
+        for (int px = x0; px < x1; px++) {
+            int x = px - cmd->ax;
+            shades[px - x0] = ramp[(x * x + y * y) >> shift];
         }
+        shade_span(cmd->color, shades, x1 - x0, colors);
+        write_span(renderer, x0, py, x1 - x0, colors, cmd->depth, depth_test);
+        fragments += x1 - x0;
     }
+    return fragments;
 }
 
-void renderer_draw_sphere(Renderer* renderer, Vec3 pos, float radius, uint32_t color, Vec3 light) {
-    if (!renderer) return;
+// Widen [lo, hi] to take in the row of the disc of radius r centred dx, dy away
+static inline void disc_row(int r, int dx, int dy, double* lo, double* hi) {
+    if (dy < -r || dy > r) return;
+    int w = isqrt(r * r - dy * dy);
+    if (dx - w < *lo) *lo = dx - w;
+    if (dx + w > *hi) *hi = dx + w;
+}
+
+// Intersect [lo, hi] with the u that satisfy a <= u * k + c <= b
+static inline void slab_row(double k, double c, double a, double b, double* lo, double* hi) {
+    if (k == 0.0) {
+        if (c < a || c > b) *lo = 1.0, *hi = 0.0;
+        return;
+    }
+    double u0 = (a - c) / k;
+    double u1 = (b - c) / k;
+    if (u0 > u1) {
+        double swap = u0;
+        u0 = u1;
+        u1 = swap;
+    }
+    if (u0 > *lo) *lo = u0;
+    if (u1 < *hi) *hi = u1;
+}
+
+// A limb is the capsule of radius r around the segment a-b: the two end
+// discs plus the band between them. Each scanline of it is one span.
+static inline int raster_cylinder(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip, int depth_test) {
+    uint16_t shades[RENDERER_TILE_SIZE];
+    uint32_t colors[RENDERER_TILE_SIZE];
+    int r = cmd->size_x;
+    if (r < 0) return 0;
+    int dx = cmd->bx - cmd->ax;
+    int dy = cmd->by - cmd->ay;
     
-    // Simple sphere projection (orthogonal)
-    int cx = (int)(pos.x * 50 + renderer->width / 2);
-    int cy = (int)(-pos.z * 50 + renderer->height / 2);
-    int r = (int)(radius * 50);
+    // u, v are pixel offsets from a. Along the segment t = u*dx + v*dy runs
+    // from 0 to length^2; across it s = u*dy - v*dx stays within r*length.
+    double length2 = (double)dx * dx + (double)dy * dy;
+    double reach = r * sqrt(length2);
     
-    // Draw filled circle
-    for (int y = -r; y <= r; y++) {
-        for (int x = -r; x <= r; x++) {
-            if (x * x + y * y <= r * r) {
-                int px = cx + x;
-                int py = cy + y;
-                
-                if (px >= 0 && px < renderer->width && py >= 0 && py < renderer->height) {
-                    // Simple lighting
-                    float depth = sqrtf((float)(x * x + y * y)) / r;
-                    float shade = 1.0f - depth * 0.3f;
-                    
-                    uint32_t base_color = color;
-                    uint32_t r_val = ((base_color >> 16) & 0xFF);
-                    uint32_t g_val = ((base_color >> 8) & 0xFF);
-                    uint32_t b_val = (base_color & 0xFF);
-                    
-                    r_val = (uint32_t)(r_val * shade);
-                    g_val = (uint32_t)(g_val * shade);
-                    b_val = (uint32_t)(b_val * shade);
-                    
-                    uint32_t shaded_color = (r_val << 16) | (g_val << 8) | b_val;
-                    set_pixel_depth(renderer, px, py, shaded_color, pos.z);
-                }
+    // Shade by distance from the axis, as the old per-disc shading did for
+    // upright limbs: a linear ramp from SHADE_ONE on the axis down to 0.8
+    // of it at the rim, in fixed point. A zero-length limb is a disc shaded
+    // by horizontal offset.
+    float sx = (float)dy, sy = (float)-dx;
+    float shade_scale = reach > 0.0 ? (float)(0.2 * SHADE_ONE / reach) : (r > 0 ? 0.2f * SHADE_ONE / r : 0.0f);
+    float shade_floor = 0.8f * SHADE_ONE;
+    if (length2 == 0.0) sx = 1.0f;
+    
+    int fragments = 0;
+    for (int py = clip->y0; py < clip->y1; py++) {
+        int v = py - cmd->ay;
+        double lo = 1e30, hi = -1e30;
+        disc_row(r, 0, v, &lo, &hi);
+        disc_row(r, dx, py - cmd->by, &lo, &hi);
+        if (length2 > 0.0) {
+            double band_lo = -1e30, band_hi = 1e30;
+            slab_row(dx, (double)v * dy, 0.0, length2, &band_lo, &band_hi);
+            slab_row(dy, -(double)v * dx, -reach, reach, &band_lo, &band_hi);
+            if (band_lo <= band_hi) {
+                if (band_lo < lo) lo = band_lo;
+                if (band_hi > hi) hi = band_hi;
             }
         }
+        if (lo > hi) continue;
+        
+        int x0 = cmd->ax + (int)ceil(lo);
+        int x1 = cmd->ax + (int)floor(hi) + 1;
+        x0 = x0 > clip->x0 ? x0 : clip->x0;
+        x1 = x1 < clip->x1 ? x1 : clip->x1;
+        if (x0 >= x1) continue;
+        
+        float s = (x0 - cmd->ax) * sx + v * sy;
+        for (int i = 0; i < x1 - x0; i++, s += sx) {
+            float shade = SHADE_ONE - fabsf(s) * shade_scale;
+            shades[i] = (uint16_t)((shade < shade_floor ? shade_floor : shade) + 0.5f);
+        }
+        shade_span(cmd->color, shades, x1 - x0, colors);
+        write_span(renderer, x0, py, x1 - x0, colors, cmd->depth, depth_test);
+        fragments += x1 - x0;
     }
+    return fragments;
 }
 
-static void renderer_draw_cylinder(Renderer* renderer, Vec3 start, Vec3 end, float radius, uint32_t color) {
-    if (!renderer) return;
+static inline int raster_projectile(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip, int depth_test) {
+    uint32_t colors[5] = {cmd->color, cmd->color, cmd->color, cmd->color, cmd->color};
+    int fragments = 0;
+    for (int py = clip->y0; py < clip->y1; py++) {
+        int y = py - cmd->ay;
+        int w = isqrt(4 - y * y);
+        int x0 = cmd->ax - w > clip->x0 ? cmd->ax - w : clip->x0;
+        int x1 = cmd->ax + w + 1 < clip->x1 ? cmd->ax + w + 1 : clip->x1;
+        if (x0 >= x1) continue;
+        write_span(renderer, x0, py, x1 - x0, colors, cmd->depth, depth_test);
+        fragments += x1 - x0;
+    }
+    return fragments;
+}
+
+static inline int raster_rect(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip, int depth_test) {
+    uint32_t colors[RENDERER_TILE_SIZE];
+    int width = clip->x1 - clip->x0;
+    for (int i = 0; i < width; i++) {
+        colors[i] = cmd->color;
+    }
+    for (int py = clip->y0; py < clip->y1; py++) {
+        write_span(renderer, clip->x0, py, width, colors, cmd->depth, depth_test);
+    }
+    return width * (clip->y1 - clip->y0);
+}
+
+// Blit count sprite texels to row y from x, each at depth plus its own
+// offset; empty texels are infinitely far and never pass. Returns the
+// number of texels that are not empty.
+static inline int blit_span(Renderer* renderer, int x, int y, int count, const uint32_t* colors, const float* offsets, float depth) {
+    uint32_t* frame = renderer->framebuffer + y * renderer->width + x;
+    float* depths = renderer->depthbuffer + y * renderer->width + x;
+    int fragments = 0;
+    int i = 0;
     
-    // Simple cylinder rendering as a thick line
-    int x1 = (int)(start.x * 50 + renderer->width / 2);
-    int y1 = (int)(-start.z * 50 + renderer->height / 2);
-    int x2 = (int)(end.x * 50 + renderer->width / 2);
-    int y2 = (int)(-end.z * 50 + renderer->height / 2);
+#if defined(__SSE2__)
+    static const int bit_count[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    __m128 z = _mm_set1_ps(depth);
+    __m128 empty = _mm_set1_ps(INFINITY);
+    for (; i + 4 <= count; i += 4) {
+        __m128 offset = _mm_loadu_ps(offsets + i);
+        fragments += bit_count[_mm_movemask_ps(_mm_cmplt_ps(offset, empty))];
+        __m128 texel = _mm_add_ps(z, offset);
+        __m128 old = _mm_loadu_ps(depths + i);
+        __m128 pass = _mm_cmplt_ps(texel, old);
+        __m128i mask = _mm_castps_si128(pass);
+        __m128i c = _mm_loadu_si128((const __m128i*)(colors + i));
+        __m128i kept = _mm_loadu_si128((const __m128i*)(frame + i));
+        _mm_storeu_si128((__m128i*)(frame + i), _mm_or_si128(_mm_and_si128(mask, c), _mm_andnot_si128(mask, kept)));
+        _mm_storeu_ps(depths + i, _mm_or_ps(_mm_and_ps(pass, texel), _mm_andnot_ps(pass, old)));
+    }
+#endif
     
-    int r = (int)(radius * 50);
+    for (; i < count; i++) {
+        if (offsets[i] == INFINITY) continue;
+        fragments++;
+        float texel = depth + offsets[i];
+        if (texel < depths[i]) {
+            frame[i] = colors[i];
+            depths[i] = texel;
+        }
+    }
+    return fragments;
+}
+
+// Sprite texels have their own depths, so the blit always depth-tests
+static inline int raster_sprite(Renderer* renderer, const DrawCommand* cmd, const ClipRect* clip) {
+    const HumanoidSprite* sprite = cmd->sprite;
+    int fragments = 0;
+    for (int py = clip->y0; py < clip->y1; py++) {
+        int offset = (py - cmd->ay) * sprite->width + clip->x0 - cmd->ax;
+        fragments += blit_span(renderer, clip->x0, py, clip->x1 - clip->x0, sprite->color + offset,
+                               sprite->depth + offset, cmd->depth);
+    }
+    return fragments;
+}
+
+// Draw the part of cmd inside tile t; returns the pixels shaded
+static int raster_command(Renderer* renderer, const DrawCommand* cmd, int t) {
+    ClipRect tile, clip;
+    tile_rect(renderer, t, &tile);
+    if (!clip_command(cmd, &tile, &clip)) return 0;
     
-    // Bresenham line algorithm with thickness
-    int dx = abs(x2 - x1);
-    int dy = abs(y2 - y1);
-    int sx = (x1 < x2) ? 1 : -1;
-    int sy = (y1 < y2) ? 1 : -1;
-    int err = dx - dy;
+    // Sky and ground only write color
+    if (cmd->type == DRAW_SKY) {
+        raster_sky(renderer, cmd, &clip);
+        return 0;
+    }
+    if (cmd->type == DRAW_GROUND) {
+        raster_ground(renderer, &clip);
+        return 0;
+    }
     
-    float avg_z = (start.z + end.z) * 0.5f;
+    // Nothing passes "depth < texel" if no texel is farther (also true of NaN depths)
+    TileDepth* tile_depth = &renderer->tile_depth[t];
+    if (!(cmd->depth < tile_depth->max)) return 0;
+    if (tile_depth->cleared) tile_depth_resolve(renderer, t);
+    int depth_test = !(cmd->depth < tile_depth->min);
     
-    while (1) {
-        // Draw circle at this point
-        for (int cy = -r; cy <= r; cy++) {
-            for (int cx = -r; cx <= r; cx++) {
-                if (cx * cx + cy * cy <= r * r) {
-                    int px = x1 + cx;
-                    int py = y1 + cy;
-                    float shade = 1.0f - (fabsf((float)cx) / r) * 0.2f;
-                    
-                    uint32_t r_val = ((color >> 16) & 0xFF);
-                    uint32_t g_val = ((color >> 8) & 0xFF);
-                    uint32_t b_val = (color & 0xFF);
-                    
-                    r_val = (uint32_t)(r_val * shade);
-                    g_val = (uint32_t)(g_val * shade);
-                    b_val = (uint32_t)(b_val * shade);
-                    
-                    uint32_t shaded = (r_val << 16) | (g_val << 8) | b_val;
-                    set_pixel_depth(renderer, px, py, shaded, avg_z);
-                }
+    // Constant arguments let the compiler drop the per-pixel branch
+    int fragments = 0;
+    switch (cmd->type) {
+        case DRAW_BOX:
+            fragments = depth_test ? raster_box(renderer, cmd, &clip, 1) : raster_box(renderer, cmd, &clip, 0);
+            break;
+        case DRAW_SPHERE:
+            fragments = depth_test ? raster_sphere(renderer, cmd, &clip, 1) : raster_sphere(renderer, cmd, &clip, 0);
+            break;
+        case DRAW_CYLINDER:
+            fragments = depth_test ? raster_cylinder(renderer, cmd, &clip, 1) : raster_cylinder(renderer, cmd, &clip, 0);
+            break;
+        case DRAW_PROJECTILE:
+            fragments = depth_test ? raster_projectile(renderer, cmd, &clip, 1) : raster_projectile(renderer, cmd, &clip, 0);
+            break;
+        case DRAW_RECT:
+            fragments = depth_test ? raster_rect(renderer, cmd, &clip, 1) : raster_rect(renderer, cmd, &clip, 0);
+            break;
+        case DRAW_SPRITE:
+            fragments = raster_sprite(renderer, cmd, &clip);
+            break;
+        default:
+            break;
+    }
+    
+    if (cmd->depth < tile_depth->min) tile_depth->min = cmd->depth;
+    
+    // Solid boxes and rectangles that cover the whole tile leave no texel farther
+    if ((cmd->type == DRAW_BOX || cmd->type == DRAW_RECT) &&
+        clip.x0 == tile.x0 && clip.y0 == tile.y0 && clip.x1 == tile.x1 && clip.y1 == tile.y1) {
+        tile_depth->max = cmd->depth;
+    }
+    return fragments;
+}
+
+// Immediate mode for the single-primitive entry points
+static void raster_now(Renderer* renderer, const DrawCommand* cmds, int count) {
+    int tiles_x = renderer->draws.tiles_x;
+    for (int i = 0; i < count; i++) {
+        const DrawCommand* cmd = &cmds[i];
+        int tx0 = cmd->x0 / RENDERER_TILE_SIZE, tx1 = (cmd->x1 - 1) / RENDERER_TILE_SIZE;
+        int ty0 = cmd->y0 / RENDERER_TILE_SIZE, ty1 = (cmd->y1 - 1) / RENDERER_TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                renderer->fragments += raster_command(renderer, cmd, ty * tiles_x + tx);
             }
         }
-        
-        if (x1 == x2 && y1 == y2) break;
-        int e2 = 2 * err;
-        if (e2 > -dy) { err -= dy; x1 += sx; }
-        if (e2 < dx) { err += dx; y1 += sy; }
     }
 }
 
-void renderer_draw_humanoid_3d(Renderer* renderer, Humanoid* humanoid, uint32_t color) {
-    if (!renderer || !humanoid) return;
+// ---- Command list and tile bins ----
+
+static DrawCommand* draw_list_reserve(DrawList* draws, int count) {
+    if (draws->count + count > draws->capacity) {
+        while (draws->count + count > draws->capacity) draws->capacity *= 2;
+        draws->commands = (DrawCommand*)realloc(draws->commands, draws->capacity * sizeof(DrawCommand));
+    }
+    return &draws->commands[draws->count];
+}
+
+// Sort command indices into per-tile lists, keeping submission order in each
+static void draw_list_bin(DrawList* draws) {
+    int tile_count = draws->tiles_x * draws->tiles_y;
+    int* start = draws->start;
+    memset(start, 0, (tile_count + 1) * sizeof(int));
     
-    // Draw legs (back to front for proper depth)
-    float limb_radius = humanoid->limb_scale * 0.6f;
+    // Count into start[t + 1]
+    for (int i = 0; i < draws->count; i++) {
+        const DrawCommand* cmd = &draws->commands[i];
+        int tx0 = cmd->x0 / RENDERER_TILE_SIZE, tx1 = (cmd->x1 - 1) / RENDERER_TILE_SIZE;
+        int ty0 = cmd->y0 / RENDERER_TILE_SIZE, ty1 = (cmd->y1 - 1) / RENDERER_TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                start[ty * draws->tiles_x + tx + 1]++;
+            }
+        }
+    }
+    for (int t = 0; t < tile_count; t++) {
+        start[t + 1] += start[t];
+    }
+    
+    int total = start[tile_count];
+    if (total > draws->item_capacity) {
+        while (total > draws->item_capacity) draws->item_capacity *= 2;
+        free(draws->items);
+        draws->items = (int*)malloc(draws->item_capacity * sizeof(int));
+    }
+    
+    // Fill using start[t] as the cursor, which leaves it at the old start[t + 1]
+    for (int i = 0; i < draws->count; i++) {
+        const DrawCommand* cmd = &draws->commands[i];
+        int tx0 = cmd->x0 / RENDERER_TILE_SIZE, tx1 = (cmd->x1 - 1) / RENDERER_TILE_SIZE;
+        int ty0 = cmd->y0 / RENDERER_TILE_SIZE, ty1 = (cmd->y1 - 1) / RENDERER_TILE_SIZE;
+        for (int ty = ty0; ty <= ty1; ty++) {
+            for (int tx = tx0; tx <= tx1; tx++) {
+                draws->items[start[ty * draws->tiles_x + tx]++] = i;
+            }
+        }
+    }
+    memmove(start + 1, start, tile_count * sizeof(int));
+    start[0] = 0;
+}
+
+typedef struct {
+    Renderer* renderer;
+    int next_tile;
+    int fragments;
+} DrawJob;
+
+// Copy depth texels and tile metadata, skipping texels of cleared tiles.
+// Runs of live tiles go row by row, as whole rows copy much faster than
+// tile-shaped blocks.
+static void copy_depth(Renderer* renderer, float* dst, TileDepth* dst_tiles, const float* src, const TileDepth* src_tiles) {
+    int tiles_x = renderer->draws.tiles_x;
+    int tile_count = tiles_x * renderer->draws.tiles_y;
+    memcpy(dst_tiles, src_tiles, tile_count * sizeof(TileDepth));
     
-    // Left leg
-    renderer_draw_cylinder(renderer, humanoid->torso_pos, humanoid->left_leg_pos, limb_radius, color);
+    for (int ty = 0; ty < renderer->draws.tiles_y; ty++) {
+        const TileDepth* row_tiles = src_tiles + ty * tiles_x;
+        int y0 = ty * RENDERER_TILE_SIZE;
+        int y1 = y0 + RENDERER_TILE_SIZE < renderer->height ? y0 + RENDERER_TILE_SIZE : renderer->height;
+        for (int tx = 0; tx < tiles_x; ) {
+            if (row_tiles[tx].cleared) {
+                tx++;
+                continue;
+            }
+            int run = tx;
+            while (run < tiles_x && !row_tiles[run].cleared) run++;
+            int x0 = tx * RENDERER_TILE_SIZE;
+            int x1 = run * RENDERER_TILE_SIZE < renderer->width ? run * RENDERER_TILE_SIZE : renderer->width;
+            for (int y = y0; y < y1; y++) {
+                memcpy(dst + y * renderer->width + x0, src + y * renderer->width + x0, (x1 - x0) * sizeof(float));
+            }
+            tx = run;
+        }
+    }
+}
+
+static void draw_worker(void* arg, int thread_index) {
+    (void)thread_index;
+    DrawJob* job = (DrawJob*)arg;
+    Renderer* renderer = job->renderer;
+    DrawList* draws = &renderer->draws;
+    int tile_count = draws->tiles_x * draws->tiles_y;
     
-    // Right leg  
-    renderer_draw_cylinder(renderer, humanoid->torso_pos, humanoid->right_leg_pos, limb_radius, color);
+    int fragments = 0;
+    while (1) {
+        int t = parallel_fetch_add(&job->next_tile, 1);
+        if (t >= tile_count) break;
+        
+        for (int i = draws->start[t]; i < draws->start[t + 1]; i++) {
+            fragments += raster_command(renderer, &draws->commands[draws->items[i]], t);
+        }
+    }
+    parallel_fetch_add(&job->fragments, fragments);
+}
+
+// Bin the recorded commands, rasterize every tile, and empty the list
+static void draw_list_flush(Renderer* renderer) {
+    DrawList* draws = &renderer->draws;
+    draw_list_bin(draws);
     
-    // Draw torso as a cylinder
-    Vec3 torso_top = vec3_add(humanoid->torso_pos, vec3_new(0.0f, 0.3f, 0.0f));
-    renderer_draw_cylinder(renderer, humanoid->torso_pos, torso_top, humanoid->limb_scale * 1.2f, color);
+    DrawJob job;
+    job.renderer = renderer;
+    job.next_tile = 0;
+    job.fragments = 0;
+    int tile_count = draws->tiles_x * draws->tiles_y;
+    int threads = renderer->thread_count < tile_count ? renderer->thread_count : tile_count;
+    parallel_run(threads > 1 ? threads : 1, draw_worker, &job);
+    renderer->fragments += job.fragments;
     
-    // Draw arms
-    renderer_draw_cylinder(renderer, torso_top, humanoid->left_arm_pos, limb_radius, color);
-    renderer_draw_cylinder(renderer, torso_top, humanoid->right_arm_pos, limb_radius, color);
+    draws->count = 0;
+}
+
+// ---- Humanoid sprites ----
+
+// Big enough for a humanoid's parts around the centre at 50 pixels per unit
+#define SPRITE_SCRATCH_SIZE 128
+
+// Rasterize a humanoid on its own, at the centre of the scratch's middle
+// pixel's (offset_x, offset_y) sub-pixel cell, then crop to what it covered
+static void sprite_build(HumanoidSprite* sprite, uint32_t color, int phase, int offset_x, int offset_y) {
+    float sub_x = (offset_x + 0.5f) / RENDERER_SPRITE_OFFSETS / PIXELS_PER_UNIT;
+    float sub_y = (offset_y + 0.5f) / RENDERER_SPRITE_OFFSETS / PIXELS_PER_UNIT;
+    Humanoid humanoid = humanoid_create(vec3_new(sub_x, 0.0f, -sub_y), vec3_new(0.0f, 0.0f, 1.0f));
+    humanoid.animation_time = phase * (6.2831853f / HUMANOID_WALK_RATE) / RENDERER_SPRITE_PHASES;
+    humanoid_compute_parts(&humanoid);
+    
+    Renderer* scratch = renderer_create(SPRITE_SCRATCH_SIZE, SPRITE_SCRATCH_SIZE);
+    DrawCommand cmds[6];
+    renderer_clear(scratch, 0);
+    raster_now(scratch, cmds, command_humanoid(scratch, cmds, &humanoid, color));
+    renderer_resolve_depth(scratch);
+    
+    int x0 = SPRITE_SCRATCH_SIZE, y0 = SPRITE_SCRATCH_SIZE, x1 = 0, y1 = 0;
+    float near = RENDERER_FAR_DEPTH;
+    for (int y = 0; y < SPRITE_SCRATCH_SIZE; y++) {
+        for (int x = 0; x < SPRITE_SCRATCH_SIZE; x++) {
+            float depth = scratch->depthbuffer[y * SPRITE_SCRATCH_SIZE + x];
+            if (depth >= RENDERER_FAR_DEPTH) continue;
+            if (x < x0) x0 = x;
+            if (y < y0) y0 = y;
+            if (x >= x1) x1 = x + 1;
+            if (y >= y1) y1 = y + 1;
+            if (depth < near) near = depth;
+        }
+    }
+    if (x0 >= x1) x0 = x1 = y0 = y1 = 0;
     
-    // Draw head as sphere
-    uint32_t head_color = color;  // Skin tone
-    renderer_draw_sphere(renderer, humanoid->head_pos, humanoid->head_radius, head_color, vec3_new(1.0f, 1.0f, 1.0f));
+    sprite->width = x1 - x0;
+    sprite->height = y1 - y0;
+    sprite->origin_x = SPRITE_SCRATCH_SIZE / 2 - x0;
+    sprite->origin_y = SPRITE_SCRATCH_SIZE / 2 - y0;
+    sprite->near = near - humanoid.position.z;
+    sprite->color = (uint32_t*)malloc(sprite->width * sprite->height * sizeof(uint32_t));
+    sprite->depth = (float*)malloc(sprite->width * sprite->height * sizeof(float));
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int i = (y - y0) * sprite->width + x - x0;
+            float depth = scratch->depthbuffer[y * SPRITE_SCRATCH_SIZE + x];
+            sprite->color[i] = scratch->framebuffer[y * SPRITE_SCRATCH_SIZE + x];
+            sprite->depth[i] = depth < RENDERER_FAR_DEPTH ? depth - near : INFINITY;
+        }
+    }
+    sprite->built = 1;
+    renderer_free(scratch);
 }
 
-void renderer_draw_structure_3d(Renderer* renderer, Structure* structure) {
-    if (!renderer || !structure) return;
+// The sprite for this color at the walk-cycle phase nearest animation_time
+// and position's sub-pixel cell, rasterized on first use. Only called while
+// recording, from one thread.
+static const HumanoidSprite* sprite_lookup(Renderer* renderer, uint32_t color, float animation_time, Vec3 position) {
+    SpriteCache* cache = &renderer->sprites;
+    int set = 0;
+    while (set < cache->color_count && cache->colors[set] != color) set++;
+    if (set == cache->color_count) {
+        cache->color_count++;
+        cache->colors = (uint32_t*)realloc(cache->colors, cache->color_count * sizeof(uint32_t));
+        cache->sets = (HumanoidSprite**)realloc(cache->sets, cache->color_count * sizeof(HumanoidSprite*));
+        cache->colors[set] = color;
+        cache->sets[set] = (HumanoidSprite*)calloc(RENDERER_SPRITE_SET_SIZE, sizeof(HumanoidSprite));
+    }
     
+    float cycles = animation_time * HUMANOID_WALK_RATE / 6.2831853f;
+    int phase = (int)((cycles - floorf(cycles)) * RENDERER_SPRITE_PHASES + 0.5f) % RENDERER_SPRITE_PHASES;
+    float x = position.x * PIXELS_PER_UNIT + renderer->width / 2;
+    float y = -position.z * PIXELS_PER_UNIT + renderer->height / 2;
+    int offset_x = (int)((x - floorf(x)) * RENDERER_SPRITE_OFFSETS);
+    int offset_y = (int)((y - floorf(y)) * RENDERER_SPRITE_OFFSETS);
+    if (offset_x >= RENDERER_SPRITE_OFFSETS) offset_x = RENDERER_SPRITE_OFFSETS - 1;
+    if (offset_y >= RENDERER_SPRITE_OFFSETS) offset_y = RENDERER_SPRITE_OFFSETS - 1;
+    int index = (phase * RENDERER_SPRITE_OFFSETS + offset_y) * RENDERER_SPRITE_OFFSETS + offset_x;
+    HumanoidSprite* sprite = &cache->sets[set][index];
+    if (!sprite->built) {
+        sprite_build(sprite, color, phase, offset_x, offset_y);
+        cache->builds++;
+    }
+    return sprite;
+}
+
+// Record a humanoid as a sprite blit or as its parts
+static void record_humanoid(Renderer* renderer, Humanoid* humanoid, uint32_t color) {
+    DrawList* draws = &renderer->draws;
+    if (renderer->humanoid_sprites) {
+        const HumanoidSprite* sprite = sprite_lookup(renderer, color, humanoid->animation_time, humanoid->position);
+        draws->count += command_sprite(renderer, draw_list_reserve(draws, 1), sprite, humanoid->position);
+    } else {
+        humanoid_compute_parts(humanoid);
+        draws->count += command_humanoid(renderer, draw_list_reserve(draws, 6), humanoid, color);
+    }
+}
+
+// ---- Culling ----
+
+// How far from its position a humanoid or a projectile can reach on screen,
+// in world units. Sprites are cropped from the scratch, so they fit in it.
+#define HUMANOID_CULL_RADIUS ((float)SPRITE_SCRATCH_SIZE / 2 / PIXELS_PER_UNIT)
+#define PROJECTILE_CULL_RADIUS (3.0f / PIXELS_PER_UNIT)
+
+// The part of the ground plane that projects onto the screen, grown by margin
+static SpatialBox view_box(Renderer* renderer, float margin) {
+    float half_x = renderer->width * 0.5f / PIXELS_PER_UNIT + margin;
+    float half_z = renderer->height * 0.5f / PIXELS_PER_UNIT + margin;
+    return (SpatialBox){-half_x, -half_z, half_x, half_z};
+}
+
+// Write the indices of the points (x[i], z[i]) inside box to
+// renderer->visible, in increasing order, and return how many there are.
+// Runs before anything per entity, so off-screen entities cost one compare.
+static int cull_points(Renderer* renderer, const float* x, const float* z, int count, SpatialBox box) {
+    if (count > renderer->visible_capacity) {
+        renderer->visible_capacity = count;
+        free(renderer->visible);
+        renderer->visible = (int*)malloc(count * sizeof(int));
+    }
+    int* visible = renderer->visible;
+    int n = 0;
+    int i = 0;
+#if defined(__SSE2__)
+    __m128 min_x = _mm_set1_ps(box.min_x), max_x = _mm_set1_ps(box.max_x);
+    __m128 min_z = _mm_set1_ps(box.min_z), max_z = _mm_set1_ps(box.max_z);
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i), pz = _mm_loadu_ps(z + i);
+        __m128 inside_x = _mm_and_ps(_mm_cmpge_ps(px, min_x), _mm_cmple_ps(px, max_x));
+        __m128 inside_z = _mm_and_ps(_mm_cmpge_ps(pz, min_z), _mm_cmple_ps(pz, max_z));
+        int mask = _mm_movemask_ps(_mm_and_ps(inside_x, inside_z));
+        if (!mask) continue;
+        
+        // Branch-free append: write every lane, advance past the inside ones
+        for (int lane = 0; lane < 4; lane++) {
+            visible[n] = i + lane;
+            n += (mask >> lane) & 1;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        visible[n] = i;
+        n += x[i] >= box.min_x && x[i] <= box.max_x && z[i] >= box.min_z && z[i] <= box.max_z;
+    }
+    return n;
+}
+
+// ---- Public drawing ----
+
+void renderer_draw_sky_gothic(Renderer* renderer, float time_of_day) {
+    if (!renderer) return;
+    DrawCommand cmd;
+    if (command_sky(renderer, &cmd, time_of_day)) raster_now(renderer, &cmd, 1);
+}
+
+void renderer_draw_ground_gothic(Renderer* renderer) {
+    if (!renderer) return;
+    DrawCommand cmd;
+    if (command_ground(renderer, &cmd)) raster_now(renderer, &cmd, 1);
+}
+
+void renderer_draw_sphere(Renderer* renderer, Vec3 pos, float radius, uint32_t color, Vec3 light) {
+    if (!renderer) return;
+    DrawCommand cmd;
+    if (command_sphere(renderer, &cmd, pos, radius, color)) raster_now(renderer, &cmd, 1);
+}
+
+void renderer_draw_humanoid_3d(Renderer* renderer, Humanoid* humanoid, uint32_t color) {
+    if (!renderer || !humanoid) return;
+    DrawCommand cmds[6];
+    raster_now(renderer, cmds, command_humanoid(renderer, cmds, humanoid, color));
+}
+
+static uint32_t structure_color(Structure* structure) {
     // Color based on structure type for gothic aesthetics
-    uint32_t color;
     switch (structure->type) {
         case ARCH_COLUMN:
-            color = color_from_rgb(0.3f, 0.3f, 0.35f);  // Gray stone
-            break;
+            return color_from_rgb(0.3f, 0.3f, 0.35f);  // Gray stone
         case ARCH_WALL:
-            color = color_from_rgb(0.25f, 0.25f, 0.3f);  // Dark stone
-            break;
+            return color_from_rgb(0.25f, 0.25f, 0.3f);  // Dark stone
         case ARCH_ARCH:
-            color = color_from_rgb(0.35f, 0.35f, 0.4f);  // Lighter arch
-            break;
+            return color_from_rgb(0.35f, 0.35f, 0.4f);  // Lighter arch
         case ARCH_TOWER:
-            color = color_from_rgb(0.2f, 0.2f, 0.25f);  // Very dark tower
-            break;
+            return color_from_rgb(0.2f, 0.2f, 0.25f);  // Very dark tower
         case ARCH_RUIN:
-            color = color_from_rgb(0.28f, 0.28f, 0.32f);  // Ruin stone
-            break;
+            return color_from_rgb(0.28f, 0.28f, 0.32f);  // Ruin stone
         default:
-            color = color_from_rgb(0.3f, 0.3f, 0.3f);
+            return color_from_rgb(0.3f, 0.3f, 0.3f);
     }
+}
+
+void renderer_draw_structure_3d(Renderer* renderer, Structure* structure) {
+    if (!renderer || !structure) return;
     
     // Draw as 3D box
-    renderer_draw_box_3d(renderer, structure->position, structure->size, color);
+    DrawCommand cmd;
+    if (command_box(renderer, &cmd, structure->position, structure->size, structure_color(structure))) {
+        raster_now(renderer, &cmd, 1);
+    }
 }
 
 void renderer_draw_projectile(Renderer* renderer, Vec3 pos, uint32_t color) {
     if (!renderer) return;
-    
-    // Project to 2D
-    int px = (int)(pos.x * 50 + renderer->width / 2);
-    int py = (int)(-pos.z * 50 + renderer->height / 2);
-    
-    // Draw small projectile (2x2 or 3x3)
-    for (int y = -2; y <= 2; y++) {
-        for (int x = -2; x <= 2; x++) {
-            if (x * x + y * y <= 4) {
-                set_pixel_depth(renderer, px + x, py + y, color, pos.z);
-            }
-        }
-    }
+    DrawCommand cmd;
+    if (command_projectile(renderer, &cmd, pos, color)) raster_now(renderer, &cmd, 1);
 }
 
 void renderer_draw_obstacle(Renderer* renderer, Vec3 pos, Vec3 size, uint32_t color) {
     if (!renderer) return;
     
-    // Project to 2D
-    int cx = (int)(pos.x * 50 + renderer->width / 2);
-    int cy = (int)(-pos.z * 50 + renderer->height / 2);
-    
     // Draw as rectangle
-    int half_w = (int)(size.x * 50 / 2);
-    int half_h = (int)(size.z * 50 / 2);
-    
-    for (int y = -half_h; y <= half_h; y++) {
-        for (int x = -half_w; x <= half_w; x++) {
-            set_pixel_depth(renderer, cx + x, cy + y, color, pos.z);
-        }
-    }
+    DrawCommand cmd;
+    if (command_rect(renderer, &cmd, pos, size, color)) raster_now(renderer, &cmd, 1);
 }
 
-void renderer_draw_game(Renderer* renderer, GameState* game, Environment* env, Vec3 camera_pos, Vec3 camera_dir) {
-    if (!renderer || !game || !env) return;
-    
-    // Draw gothic sky
-    renderer_draw_sky_gothic(renderer, env->time_of_day);
+// The frame renderer_draw_game and renderer_draw_snapshot draw, from either source
+static void draw_world(Renderer* renderer, const Player* player, const EnemyPool* enemies,
+                       const ProjectilePool* projectiles, const Environment* env) {
+    DrawList* draws = &renderer->draws;
+    BackgroundLayer* background = &renderer->background;
     
-    // Draw gothic ground
-    renderer_draw_ground_gothic(renderer);
+    // The background layer is still good if the sky is at the same level
+    // and the structures are the same
+    int level = sky_level(env->time_of_day);
+    int rebuild = !background->valid || background->env != env || background->sky_level != level ||
+                  background->structure_revision != env->structure_revision;
     
-    // Draw all architectural structures
-    for (int i = 0; i < env->structure_count; i++) {
-        renderer_draw_structure_3d(renderer, &env->structures[i]);
+    size_t pixels = (size_t)renderer->width * renderer->height;
+    if (rebuild) {
+        // Gothic sky, ground and all architectural structures, kept for later frames
+        DrawCommand* cmd = draw_list_reserve(draws, 2 + env->structure_count);
+        if (command_sky(renderer, cmd, env->time_of_day)) cmd++;
+        if (command_ground(renderer, cmd)) cmd++;
+        for (int i = 0; i < env->structure_count; i++) {
+            Structure* structure = &env->structures[i];
+            if (command_box(renderer, cmd, structure->position, structure->size, structure_color(structure))) cmd++;
+        }
+        draws->count = (int)(cmd - draws->commands);
+        
+        renderer_clear(renderer, 0x000000);
+        draw_list_flush(renderer);
+        memcpy(background->color, renderer->framebuffer, pixels * sizeof(uint32_t));
+        copy_depth(renderer, background->depth, background->tile_depth, renderer->depthbuffer, renderer->tile_depth);
+        
+        background->env = env;
+        background->sky_level = level;
+        background->structure_revision = env->structure_revision;
+        background->valid = 1;
+        background->rebuilds++;
+    } else {
+        // Rows are contiguous across tiles, so one bulk copy beats copying per tile.
+        // Depth only comes back for tiles that structures were drawn into.
+        memcpy(renderer->framebuffer, background->color, pixels * sizeof(uint32_t));
+        copy_depth(renderer, renderer->depthbuffer, renderer->tile_depth, background->depth, background->tile_depth);
     }
     
-    // Draw enemies as humanoids
+    // Record the moving parts in painter's order, then rasterize tile by tile.
+    // Enemies as humanoids, past those too far off screen to reach it
     uint32_t enemy_color = color_from_rgb(0.8f, 0.1f, 0.1f);
-    for (int i = 0; i < game->enemy_count; i++) {
-        if (game->enemies[i].radius <= 0.0f) continue;  // Skip dead enemies
-        
-        Vec3 enemy_pos = game->enemies[i].position;
-        Vec3 to_player = vec3_sub(game->player.position, enemy_pos);
+    int visible = cull_points(renderer, enemies->x, enemies->z, enemies->count,
+                              view_box(renderer, HUMANOID_CULL_RADIUS));
+    for (int v = 0; v < visible; v++) {
+        int i = renderer->visible[v];
+        Vec3 enemy_pos = enemy_pool_position(enemies, i);
+        Vec3 to_player = vec3_sub(player->position, enemy_pos);
         Vec3 enemy_dir = vec3_normalize(to_player);
         
         // Create temporary humanoid for rendering
         Humanoid enemy_h = humanoid_create(enemy_pos, enemy_dir);
-        enemy_h.animation_time = env->time_of_day * 10.0f + i;  // Offset for varied animation
-        humanoid_compute_parts(&enemy_h);
-        
-        renderer_draw_humanoid_3d(renderer, &enemy_h, enemy_color);
+        enemy_h.animation_time = env->time_of_day * 10.0f + enemies->phase[i];  // Offset for varied animation
+        record_humanoid(renderer, &enemy_h, enemy_color);
     }
     
-    // Draw projectiles
+    // Projectiles
     uint32_t projectile_color = color_from_rgb(1.0f, 0.8f, 0.0f);
-    for (int i = 0; i < game->projectile_count; i++) {
-        renderer_draw_projectile(renderer, game->projectiles[i].position, projectile_color);
+    visible = cull_points(renderer, projectiles->x, projectiles->z, projectiles->count,
+                          view_box(renderer, PROJECTILE_CULL_RADIUS));
+    DrawCommand* cmd = draw_list_reserve(draws, visible);
+    for (int v = 0; v < visible; v++) {
+        Vec3 pos = projectile_pool_position(projectiles, renderer->visible[v]);
+        if (command_projectile(renderer, cmd, pos, projectile_color)) cmd++;
     }
+    draws->count = (int)(cmd - draws->commands);
     
-    // Draw player as humanoid
+    // Player as humanoid
     uint32_t player_color = color_from_rgb(0.0f, 0.8f, 0.0f);
-    Humanoid player_h = humanoid_create(game->player.position, game->player.direction);
+    Humanoid player_h = humanoid_create(player->position, player->direction);
     player_h.animation_time = env->time_of_day * 10.0f;
-    humanoid_compute_parts(&player_h);
-    renderer_draw_humanoid_3d(renderer, &player_h, player_color);
+    record_humanoid(renderer, &player_h, player_color);
+    
+    draw_list_flush(renderer);
+}
+
+void renderer_draw_game(Renderer* renderer, GameState* game, Environment* env, Vec3 camera_pos, Vec3 camera_dir) {
+    if (!renderer || !game || !env) return;
+    draw_world(renderer, &game->player, &game->enemies, &game->projectiles, env);
+}
+
+void renderer_draw_snapshot(Renderer* renderer, const GameSnapshot* snapshot, Vec3 camera_pos, Vec3 camera_dir) {
+    (void)camera_pos;
+    (void)camera_dir;  // Fixed top-down view, as in renderer_draw_game
+    if (!renderer || !snapshot) return;
+    draw_world(renderer, &snapshot->player, &snapshot->enemies, &snapshot->projectiles, &snapshot->environment);
 }
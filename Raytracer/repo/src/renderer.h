@@ -4,26 +4,141 @@
 #include "math_utils.h"
 #include "sphere.h"
 #include "game.h"
+#include "snapshot.h"
 #include "humanoid.h"
 #include "environment.h"
 #include <stdint.h>
 
+// Screen tiles for renderer_draw_game: draws are recorded as commands,
+// binned into every tile their bounding box touches, and the tiles are then
+// rasterized in parallel. A tile only ever touches its own pixels, so the
+// buffers need no locking, and commands keep their submission order within
+// a tile, so the image is the same as drawing serially.
+#define RENDERER_TILE_SIZE 64
+
+typedef enum {
+    DRAW_SKY,
+    DRAW_GROUND,
+    DRAW_BOX,
+    DRAW_SPHERE,
+    DRAW_CYLINDER,
+    DRAW_PROJECTILE,
+    DRAW_RECT,
+    DRAW_SPRITE
+} DrawType;
+
+// Humanoids drawn by renderer_draw_game come from pre-rasterized sprites.
+// In this orthographic view a humanoid's pixels depend only on its color,
+// walk-cycle phase and where its position falls inside a pixel (each limb
+// rounds to pixels on its own), so each (color, phase, sub-pixel cell) is
+// rasterized once, on first use, into color and relative depth bitmaps, and
+// every humanoid after that is one depth-tested blit. Phases are quantized
+// to RENDERER_SPRITE_PHASES steps, which moves a limb by at most about a
+// pixel, and positions to RENDERER_SPRITE_OFFSETS cells a side.
+#define RENDERER_SPRITE_PHASES 32
+#define RENDERER_SPRITE_OFFSETS 4
+#define RENDERER_SPRITE_SET_SIZE (RENDERER_SPRITE_PHASES * RENDERER_SPRITE_OFFSETS * RENDERER_SPRITE_OFFSETS)
+
+typedef struct {
+    int built;
+    int width;
+    int height;
+    int origin_x, origin_y;  // Sprite pixel holding the humanoid's projected position
+    uint32_t* color;
+    float* depth;            // Relative to the nearest texel; INFINITY where empty
+    float near;              // Nearest texel's depth relative to the humanoid's position
+} HumanoidSprite;
+
+typedef struct {
+    uint32_t* colors;         // Color of each set of phases
+    HumanoidSprite** sets;    // RENDERER_SPRITE_SET_SIZE sprites per color, never moved once recorded
+    int color_count;
+    int builds;               // Sprites rasterized so far
+} SpriteCache;
+
+typedef struct {
+    DrawType type;
+    int x0, y0, x1, y1;  // Screen rectangle the command can touch (x1, y1 exclusive)
+    int ax, ay;          // Centre, start of a cylinder, or top left of a sprite
+    int bx, by;          // End of a cylinder
+    int size_x, size_y;  // Radius, or box half width and height, or rectangle half extents
+    uint32_t color;
+    float depth;
+    float time_of_day;   // Sky only
+    const HumanoidSprite* sprite;  // Sprite only
+} DrawCommand;
+
+typedef struct {
+    DrawCommand* commands;
+    int count;
+    int capacity;
+    
+    // Tile bins in CSR form: tile t holds items[start[t]] .. items[start[t + 1] - 1]
+    int tiles_x;
+    int tiles_y;
+    int* start;
+    int* items;
+    int item_capacity;
+} DrawList;
+
+// Hierarchical Z, one entry per screen tile. Every draw has a single depth,
+// so a tile is skipped outright when the draw is not nearer than max, and
+// drawn without reading depthbuffer when it is nearer than min. A cleared
+// tile's texels are logically far and only written when something lands
+// in the tile, so renderer_clear touches no depth texels at all.
+typedef struct {
+    float min;    // No texel in the tile is nearer
+    float max;    // No texel in the tile is farther
+    int cleared;  // depthbuffer texels are stale and mean far
+} TileDepth;
+
+// Sky, ground and structures as drawn by renderer_draw_game, with depth.
+// Each frame starts from a copy of it instead of a clear; it is redrawn only
+// when the quantized sky brightness or the environment's structures change.
+typedef struct {
+    uint32_t* color;
+    float* depth;              // Only valid in tiles that tile_depth says are not cleared
+    TileDepth* tile_depth;
+    int sky_level;             // Quantized sky darkness the layer was drawn with
+    const Environment* env;
+    int structure_revision;
+    int valid;
+    int rebuilds;              // Times the layer has been redrawn
+} BackgroundLayer;
+
 typedef struct {
     int width;
     int height;
     uint32_t* framebuffer;
-    float* depthbuffer;  // For depth sorting
+    float* depthbuffer;  // For depth sorting; see renderer_resolve_depth
+    TileDepth* tile_depth;
+    DrawList draws;
+    BackgroundLayer background;
+    SpriteCache sprites;
+    int humanoid_sprites; // renderer_draw_game blits humanoids from sprites instead of rasterizing their parts
+    int* visible;         // Scratch: indices of the entities that survive culling
+    int visible_capacity;
+    int thread_count;    // Workers for tiled drawing, 1 = serial
+    long long fragments; // Pixels shaded by depth-tested draws so far, for overdraw stats
 } Renderer;
 
 Renderer* renderer_create(int width, int height);
 void renderer_free(Renderer* renderer);
 void renderer_clear(Renderer* renderer, uint32_t color);
+void renderer_set_threads(Renderer* renderer, int threads);  // 0 = one per CPU
+void renderer_invalidate_background(Renderer* renderer);
+void renderer_set_humanoid_sprites(Renderer* renderer, int enabled);  // On by default
+void renderer_resolve_depth(Renderer* renderer);  // Write out fast-cleared depth before reading depthbuffer directly
 void renderer_draw_sky_gothic(Renderer* renderer, float time_of_day);
 void renderer_draw_ground_gothic(Renderer* renderer);
 void renderer_draw_structure_3d(Renderer* renderer, Structure* structure);
 void renderer_draw_sphere(Renderer* renderer, Vec3 pos, float radius, uint32_t color, Vec3 light);
 void renderer_draw_humanoid_3d(Renderer* renderer, Humanoid* humanoid, uint32_t color);
 void renderer_draw_projectile(Renderer* renderer, Vec3 pos, uint32_t color);
+// Draws the whole frame; no renderer_clear is needed first
 void renderer_draw_game(Renderer* renderer, GameState* game, Environment* env, Vec3 camera_pos, Vec3 camera_dir);
+// The same from a snapshot. Keep drawing the same snapshot object so the
+// background layer sees the same environment from frame to frame.
+void renderer_draw_snapshot(Renderer* renderer, const GameSnapshot* snapshot, Vec3 camera_pos, Vec3 camera_dir);
 
 #endif
@@ -0,0 +1,100 @@
+#include "rng.h"
+
+static uint64_t splitmix64(uint64_t* x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed_value(Rng* rng, uint64_t seed) {
+    // Expand through splitmix64 so nearby seeds give unrelated states and the
+    // state is never all zero
+    uint64_t a = splitmix64(&seed);
+    uint64_t b = splitmix64(&seed);
+    rng->s[0] = (uint32_t)a;
+    rng->s[1] = (uint32_t)(a >> 32);
+    rng->s[2] = (uint32_t)b;
+    rng->s[3] = (uint32_t)(b >> 32);
+    if ((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+        rng->s[0] = 1;
+    }
+    rng->scramble = 0;
+    rng->index = 0;
+    rng->dimension = 0;
+}
+
+void rng_seed(Rng* rng, uint32_t pixel, uint32_t sample, uint32_t stream) {
+    // Hash the counters in one at a time so no two triples share a seed by
+    // simple arithmetic coincidence
+    uint64_t x = pixel;
+    uint64_t h = splitmix64(&x) ^ sample;
+    h = splitmix64(&h) ^ stream;
+    rng_seed_value(rng, h);
+    
+    // The sequence is the pixel's, shared by its samples
+    uint64_t p = ((uint64_t)stream << 32) | pixel;
+    uint32_t scramble = (uint32_t)splitmix64(&p);
+    rng->scramble = scramble ? scramble : 1;
+    rng->index = sample;
+}
+
+static uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Owen scrambling as a hash (Burley, "Practical Hash-based Owen
+// Scrambling"), on bit-reversed values: flips each bit depending only on
+// the bits below it here, above it in the value, which keeps the
+// sequence's stratification while randomising it
+static uint32_t owen_scramble_reversed(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+static uint32_t hash_combine(uint32_t seed, uint32_t v) {
+    return seed ^ (v + (seed << 6) + (seed >> 2));
+}
+
+static uint32_t hash_u32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x21f0aaadu;
+    x ^= x >> 15;
+    x *= 0x735a2d97u;
+    x ^= x >> 15;
+    return x;
+}
+
+void rng_sample_2d(Rng* rng, float* u, float* v) {
+    if (rng->scramble == 0) {
+        *u = rng_float(rng);
+        *v = rng_float(rng);
+        return;
+    }
+    
+    uint32_t seed = hash_u32(hash_combine(rng->scramble, rng->dimension++));
+    uint32_t index = reverse_bits(owen_scramble_reversed(reverse_bits(rng->index), hash_combine(seed, 0x1u)));
+    
+    // Both Sobol dimensions bit-reversed: the first is the index itself, the
+    // second the index times the Pascal matrix mod 2, bit j being the parity
+    // of the index bits at positions whose binary digits include j's
+    uint32_t x = index;
+    uint32_t y = index;
+    y ^= (y >> 1) & 0x55555555u;
+    y ^= (y >> 2) & 0x33333333u;
+    y ^= (y >> 4) & 0x0f0f0f0fu;
+    y ^= (y >> 8) & 0x00ff00ffu;
+    y ^= (y >> 16) & 0x0000ffffu;
+    x = reverse_bits(owen_scramble_reversed(x, hash_combine(seed, 0x2u)));
+    y = reverse_bits(owen_scramble_reversed(y, hash_combine(seed, 0x3u)));
+    *u = (x >> 8) * (1.0f / 16777216.0f);
+    *v = (y >> 8) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,55 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// xoshiro128+ generator. State is a plain value owned by whoever draws from
+// it (a thread, a path), so there is no shared state and no locking.
+// Generators seeded per pixel sample also carry a low-discrepancy sequence,
+// see rng_sample_2d.
+typedef struct {
+    uint32_t s[4];
+    uint32_t scramble;   // Of the pixel's sequence; 0 = no sequence, plain random numbers
+    uint32_t index;      // Sample number within the pixel
+    uint32_t dimension;  // Next 2D dimension pair rng_sample_2d draws
+} Rng;
+
+// Counter-based seeding: the same (pixel, sample, stream) always gives the
+// same sequence, whichever thread or tile draws it. stream separates
+// independent uses of one sample, e.g. camera jitter and the path itself.
+// Samples of one pixel and stream share a scrambled sequence indexed by sample.
+void rng_seed(Rng* rng, uint32_t pixel, uint32_t sample, uint32_t stream);
+void rng_seed_value(Rng* rng, uint64_t seed);
+
+// The next 2D point of the pixel's sequence: the Owen-scrambled Sobol (0,2)
+// sequence at this sample, with each dimension pair drawn from its own
+// scramble and index shuffle (padding), so the points of the pixel's samples
+// stratify each pair of dimensions a path uses. Plain random numbers from
+// rng_float when the generator was seeded by value.
+void rng_sample_2d(Rng* rng, float* u, float* v);
+
+// Defined here so the per-sample hot loops can inline them
+static inline uint32_t rng_next(Rng* rng) {
+    uint32_t* s = rng->s;
+    uint32_t result = s[0] + s[3];
+    uint32_t t = s[1] << 9;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 11) | (s[3] >> 21);
+    return result;
+}
+
+// Uniform in [0, 1), from the high 24 bits (the low bits of xoshiro128+ are weak)
+static inline float rng_float(Rng* rng) {
+    return (rng_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline float rng_float_range(Rng* rng, float min, float max) {
+    return min + (max - min) * rng_float(rng);
+}
+
+#endif
@@ -0,0 +1,560 @@
+#include "scene_render.h"
+#include "wavefront.h"
+#include "parallel.h"
+#include "timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PACKET_SIDE 4
+
+typedef struct {
+    Scene* scene;
+    Camera* camera;
+    Image* image;
+    RenderMode mode;
+    int spp;  // Samples per pixel this run, or per pass when progressive
+    int max_depth;
+    int low_discrepancy;
+    int stream;
+    int tiles_x;
+    int tile_count;
+    int next_tile;  // Shared work queue: the next tile nobody has claimed
+    int* tiles_done;
+    long long* samples_done;
+    
+    // Progressive passes only
+    AccumBuffer* accum;
+    int min_spp;
+    int max_spp;
+    float pixel_error;
+    
+    // Temporal frames only
+    TemporalBuffer* temporal;
+    int reuse_static;  // Static first hits are still valid
+    
+    // Guide passes only
+    DenoiseGuide* guide;
+} RenderJob;
+
+typedef struct {
+    Color* sum;         // Per tile pixel, fixed-spp runs only
+    Color* colors;      // One sample per listed pixel
+    int* order;         // Tile pixels, 4x4 block by block
+    int* pixels;        // Pixels to sample this round
+    int* sample_index;  // Which sample of its pixel each one is
+    PathQueue* paths;   // Wavefront mode only
+    long long samples;
+} RenderScratch;
+
+// List the tile's pixels one 4x4 block at a time so consecutive runs of 16
+// make coherent packets
+static int tile_pixel_order(RenderJob* job, int x0, int y0, int x1, int y1, int* order) {
+    int n = 0;
+    for (int by = y0; by < y1; by += PACKET_SIDE) {
+        for (int bx = x0; bx < x1; bx += PACKET_SIDE) {
+            for (int y = by; y < by + PACKET_SIDE && y < y1; y++) {
+                for (int x = bx; x < bx + PACKET_SIDE && x < x1; x++) {
+                    order[n++] = y * job->image->width + x;
+                }
+            }
+        }
+    }
+    return n;
+}
+
+static Ray primary_ray(RenderJob* job, int pixel, int sample, Rng* rng) {
+    // Every sample seeds its own generator from (pixel, sample), so the image
+    // does not depend on tiling, threads or the order samples are taken in
+    Image* image = job->image;
+    int x = pixel % image->width;
+    int y = pixel / image->width;
+    rng_seed(rng, (uint32_t)pixel, (uint32_t)sample, (uint32_t)job->stream);
+    if (!job->low_discrepancy) rng->scramble = 0;
+    float jitter_x, jitter_y;
+    rng_sample_2d(rng, &jitter_x, &jitter_y);
+    float u = (x + jitter_x) / image->width;
+    float v = 1.0f - (y + jitter_y) / image->height;
+    return camera_get_ray(job->camera, u, v);
+}
+
+// Trace one sample for each of the count listed pixels into scratch->colors
+static void trace_samples(RenderJob* job, RenderScratch* scratch, int count) {
+    const int* pixels = scratch->pixels;
+    const int* sample_index = scratch->sample_index;
+    Color* colors = scratch->colors;
+    
+    if (job->mode == RENDER_WAVEFRONT) {
+        // One wavefront for the whole list
+        memset(colors, 0, count * sizeof(Color));
+        for (int k = 0; k < count; k++) {
+            Rng rng;
+            Ray ray = primary_ray(job, pixels[k], sample_index[k], &rng);
+            path_queue_push(scratch->paths, ray, k, &rng);
+        }
+        wavefront_trace(job->scene, scratch->paths, job->max_depth, colors);
+    } else {
+        // Jittered primary rays in packets of up to 16
+        for (int k = 0; k < count; k += RAY_PACKET_MAX) {
+            Ray rays[RAY_PACKET_MAX];
+            Rng rngs[RAY_PACKET_MAX];
+            int n = count - k < RAY_PACKET_MAX ? count - k : RAY_PACKET_MAX;
+            for (int i = 0; i < n; i++) {
+                rays[i] = primary_ray(job, pixels[k + i], sample_index[k + i], &rngs[i]);
+            }
+            trace_packet(job->scene, rays, n, job->max_depth, rngs, &colors[k]);
+        }
+    }
+    scratch->samples += count;
+}
+
+static void render_tile_fixed(RenderJob* job, int n, RenderScratch* scratch) {
+    memcpy(scratch->pixels, scratch->order, n * sizeof(int));
+    memset(scratch->sum, 0, n * sizeof(Color));
+    
+    for (int s = 0; s < job->spp; s++) {
+        for (int k = 0; k < n; k++) {
+            scratch->sample_index[k] = s;
+        }
+        trace_samples(job, scratch, n);
+        for (int k = 0; k < n; k++) {
+            scratch->sum[k].r += scratch->colors[k].r;
+            scratch->sum[k].g += scratch->colors[k].g;
+            scratch->sum[k].b += scratch->colors[k].b;
+        }
+    }
+    
+    float scale = 1.0f / job->spp;
+    for (int k = 0; k < n; k++) {
+        Color c = scratch->sum[k];
+        job->image->pixels[scratch->pixels[k]] = (Color){c.r * scale, c.g * scale, c.b * scale};
+    }
+}
+
+static int pixel_needs_samples(RenderJob* job, int pixel) {
+    int samples = job->accum->samples[pixel];
+    if (samples < job->min_spp) return 1;
+    if (samples >= job->max_spp) return 0;
+    // Scrambled Sobol samples stratify fully at powers of two, so stop there
+    if (job->low_discrepancy && (samples & (samples - 1))) return 1;
+    return accum_pixel_error(job->accum, pixel, job->low_discrepancy) > job->pixel_error;
+}
+
+// Pixels are sampled while any pixel of their 4x4 block is above the error
+// target: the variance estimate of a single pixel with few samples is too
+// noisy to trust on its own
+static int block_needs_samples(RenderJob* job, int pixel) {
+    int width = job->image->width;
+    int height = job->image->height;
+    int x0 = pixel % width / PACKET_SIDE * PACKET_SIDE;
+    int y0 = pixel / width / PACKET_SIDE * PACKET_SIDE;
+    for (int y = y0; y < y0 + PACKET_SIDE && y < height; y++) {
+        for (int x = x0; x < x0 + PACKET_SIDE && x < width; x++) {
+            if (pixel_needs_samples(job, y * width + x)) return 1;
+        }
+    }
+    return 0;
+}
+
+static int block_of(RenderJob* job, int pixel) {
+    int width = job->image->width;
+    return (pixel / width / PACKET_SIDE) * width + pixel % width / PACKET_SIDE;
+}
+
+// One progressive pass over a tile: up to spp more samples for every block
+// that has not converged yet. Converged tiles cost one scan.
+static void render_tile_adaptive(RenderJob* job, int n, RenderScratch* scratch) {
+    AccumBuffer* accum = job->accum;
+    
+    for (int s = 0; s < job->spp; s++) {
+        int count = 0;
+        int block = -1;
+        int needs = 0;
+        for (int k = 0; k < n; k++) {
+            // The order list visits blocks one after another
+            int pixel = scratch->order[k];
+            if (block_of(job, pixel) != block) {
+                block = block_of(job, pixel);
+                needs = block_needs_samples(job, pixel);
+            }
+            if (needs && accum->samples[pixel] < job->max_spp) {
+                scratch->pixels[count] = pixel;
+                scratch->sample_index[count] = accum->samples[pixel];
+                count++;
+            }
+        }
+        if (count == 0) break;
+        
+        trace_samples(job, scratch, count);
+        for (int k = 0; k < count; k++) {
+            accum_add(accum, scratch->pixels[k], scratch->colors[k]);
+        }
+    }
+}
+
+// First hits through the centres of count pixels, as one packet
+static void trace_first_hits(RenderJob* job, const int* pixels, int count, Ray* rays, RayHit* hits) {
+    TemporalBuffer* temporal = job->temporal;
+    Image* image = job->image;
+    for (int i = 0; i < count; i++) {
+        int x = pixels[i] % image->width;
+        int y = pixels[i] / image->width;
+        rays[i] = camera_get_ray(job->camera, (x + 0.5f) / image->width, 1.0f - (y + 0.5f) / image->height);
+    }
+    
+    if (job->reuse_static) {
+        for (int i = 0; i < count; i++) {
+            hits[i] = temporal->static_hits[pixels[i]];
+        }
+    } else {
+        RayPacket packet;
+        memset(hits, 0, count * sizeof(RayHit));
+        ray_packet_init(&packet, rays, count);
+        scene_hit_static_packet(job->scene, &packet, 0.001f, 1e6f, hits);
+        for (int i = 0; i < count; i++) {
+            temporal->static_hits[pixels[i]] = hits[i];
+        }
+    }
+    
+    // Dynamic objects only matter in front of the static hit
+    if (job->scene->dynamic->count == 0) return;
+    for (int i = 0; i < count; i++) {
+        RayHit dynamic;
+        if (scene_hit_dynamic(job->scene, rays[i], 0.001f, hits[i].hit ? hits[i].t : 1e6f, &dynamic)) {
+            hits[i] = dynamic;
+        }
+    }
+}
+
+// G-buffer and traced colours of a tile for temporal_resolve. Samples are
+// seeded by frame as well, so every frame adds new ones to the history.
+static void render_tile_temporal(RenderJob* job, int n, RenderScratch* scratch) {
+    TemporalBuffer* temporal = job->temporal;
+    float scale = 1.0f / job->spp;
+    for (int k = 0; k < n; k += RAY_PACKET_MAX) {
+        Ray rays[RAY_PACKET_MAX];
+        RayHit hits[RAY_PACKET_MAX];
+        int count = n - k < RAY_PACKET_MAX ? n - k : RAY_PACKET_MAX;
+        const int* pixels = &scratch->order[k];
+        trace_first_hits(job, pixels, count, rays, hits);
+        
+        for (int i = 0; i < count; i++) {
+            Color sum = {0.0f, 0.0f, 0.0f};
+            for (int s = 0; s < job->spp; s++) {
+                Rng rng;
+                rng_seed(&rng, (uint32_t)pixels[i], (uint32_t)(temporal->frame * job->spp + s), (uint32_t)job->stream);
+                if (!job->low_discrepancy) rng.scramble = 0;
+                Color c = trace_ray_shade(rays[i], &hits[i], job->scene, job->max_depth, &rng);
+                sum.r += c.r;
+                sum.g += c.g;
+                sum.b += c.b;
+            }
+            temporal->hits[pixels[i]] = hits[i];
+            temporal->color[pixels[i]] = (Color){sum.r * scale, sum.g * scale, sum.b * scale};
+        }
+    }
+    scratch->samples += (long long)n * job->spp;
+}
+
+static void guide_set(DenoiseGuide* guide, Scene* scene, int pixel, const RayHit* hit) {
+    if (!hit->hit) {
+        guide->albedo_r[pixel] = guide->albedo_g[pixel] = guide->albedo_b[pixel] = 1.0f;
+        guide->normal_x[pixel] = guide->normal_y[pixel] = guide->normal_z[pixel] = 0.0f;
+        guide->depth[pixel] = DENOISE_SKY_DEPTH;
+        return;
+    }
+    Vec3 albedo = scene->materials[hit->material_id].albedo;
+    guide->albedo_r[pixel] = albedo.x;
+    guide->albedo_g[pixel] = albedo.y;
+    guide->albedo_b[pixel] = albedo.z;
+    guide->normal_x[pixel] = hit->normal.x;
+    guide->normal_y[pixel] = hit->normal.y;
+    guide->normal_z[pixel] = hit->normal.z;
+    guide->depth[pixel] = hit->t;
+}
+
+static void render_tile_guide(RenderJob* job, int n, RenderScratch* scratch) {
+    Image* image = job->image;
+    for (int k = 0; k < n; k += RAY_PACKET_MAX) {
+        Ray rays[RAY_PACKET_MAX];
+        RayHit hits[RAY_PACKET_MAX];
+        RayPacket packet;
+        int count = n - k < RAY_PACKET_MAX ? n - k : RAY_PACKET_MAX;
+        const int* pixels = &scratch->order[k];
+        for (int i = 0; i < count; i++) {
+            int x = pixels[i] % image->width;
+            int y = pixels[i] / image->width;
+            rays[i] = camera_get_ray(job->camera, (x + 0.5f) / image->width, 1.0f - (y + 0.5f) / image->height);
+        }
+        memset(hits, 0, count * sizeof(RayHit));
+        ray_packet_init(&packet, rays, count);
+        scene_hit_packet(job->scene, &packet, 0.001f, 1e6f, hits);
+        for (int i = 0; i < count; i++) {
+            guide_set(job->guide, job->scene, pixels[i], &hits[i]);
+        }
+    }
+}
+
+static void render_tile(RenderJob* job, int tile, RenderScratch* scratch) {
+    Image* image = job->image;
+    int x0 = (tile % job->tiles_x) * RENDER_TILE_SIZE;
+    int y0 = (tile / job->tiles_x) * RENDER_TILE_SIZE;
+    int x1 = x0 + RENDER_TILE_SIZE < image->width ? x0 + RENDER_TILE_SIZE : image->width;
+    int y1 = y0 + RENDER_TILE_SIZE < image->height ? y0 + RENDER_TILE_SIZE : image->height;
+    int n = tile_pixel_order(job, x0, y0, x1, y1, scratch->order);
+    
+    if (job->guide) {
+        render_tile_guide(job, n, scratch);
+    } else if (job->temporal) {
+        render_tile_temporal(job, n, scratch);
+    } else if (job->accum) {
+        render_tile_adaptive(job, n, scratch);
+    } else {
+        render_tile_fixed(job, n, scratch);
+    }
+}
+
+static void render_worker(void* arg, int thread_index) {
+    RenderJob* job = (RenderJob*)arg;
+    int tile_pixels = RENDER_TILE_SIZE * RENDER_TILE_SIZE;
+    RenderScratch scratch;
+    scratch.sum = (Color*)malloc(tile_pixels * sizeof(Color));
+    scratch.colors = (Color*)malloc(tile_pixels * sizeof(Color));
+    scratch.order = (int*)malloc(tile_pixels * sizeof(int));
+    scratch.pixels = (int*)malloc(tile_pixels * sizeof(int));
+    scratch.sample_index = (int*)malloc(tile_pixels * sizeof(int));
+    scratch.paths = job->mode == RENDER_WAVEFRONT ? path_queue_create(tile_pixels) : NULL;
+    scratch.samples = 0;
+    int done = 0;
+    
+    while (1) {
+        int tile = parallel_fetch_add(&job->next_tile, 1);
+        if (tile >= job->tile_count) break;
+        render_tile(job, tile, &scratch);
+        done++;
+    }
+    
+    job->tiles_done[thread_index] = done;
+    job->samples_done[thread_index] = scratch.samples;
+    path_queue_free(scratch.paths);
+    free(scratch.sum);
+    free(scratch.colors);
+    free(scratch.order);
+    free(scratch.pixels);
+    free(scratch.sample_index);
+}
+
+RenderSettings render_settings_default() {
+    RenderSettings settings;
+    settings.mode = RENDER_RECURSIVE;
+    settings.spp = 4;
+    settings.max_depth = MAX_DEPTH;
+    settings.threads = 0;
+    settings.low_discrepancy = 1;
+    settings.stream = 0;
+    return settings;
+}
+
+static void render_job_init(RenderJob* job, Scene* scene, Camera* camera, Image* image, const RenderSettings* settings, int threads) {
+    job->scene = scene;
+    job->camera = camera;
+    job->image = image;
+    job->mode = settings->mode;
+    job->spp = settings->spp < 1 ? 1 : settings->spp;
+    job->max_depth = settings->max_depth;
+    job->low_discrepancy = settings->low_discrepancy;
+    job->stream = settings->stream;
+    job->tiles_x = (image->width + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE;
+    job->tile_count = job->tiles_x * ((image->height + RENDER_TILE_SIZE - 1) / RENDER_TILE_SIZE);
+    job->next_tile = 0;
+    job->tiles_done = (int*)calloc(threads, sizeof(int));
+    job->samples_done = (long long*)calloc(threads, sizeof(long long));
+    job->accum = NULL;
+    job->temporal = NULL;
+    job->reuse_static = 0;
+    job->guide = NULL;
+}
+
+static int render_thread_count(const RenderSettings* settings) {
+    int threads = settings->threads;
+    if (threads <= 0) threads = parallel_cpu_count();
+    if (threads > RENDER_MAX_THREADS) threads = RENDER_MAX_THREADS;
+    return threads;
+}
+
+// Hand every tile of the job to threads workers; returns the samples traced
+static long long render_job_run(RenderJob* job, int threads) {
+    job->next_tile = 0;
+    parallel_run(threads, render_worker, job);
+    
+    long long samples = 0;
+    for (int i = 0; i < threads; i++) {
+        samples += job->samples_done[i];
+    }
+    return samples;
+}
+
+static void render_job_free(RenderJob* job) {
+    free(job->tiles_done);
+    free(job->samples_done);
+}
+
+void render_scene(Scene* scene, Camera* camera, Image* image, const RenderSettings* settings, RenderStats* stats) {
+    if (!scene || !camera || !image || !settings) return;
+    int threads = render_thread_count(settings);
+    
+    double start = timer_seconds();
+    if (!scene->bvh) {
+        scene_build_bvh(scene);
+    }
+    
+    RenderJob job;
+    render_job_init(&job, scene, camera, image, settings, threads);
+    render_job_run(&job, threads);
+    
+    if (stats) {
+        stats->thread_count = threads;
+        stats->tile_count = job.tile_count;
+        memcpy(stats->tiles_per_thread, job.tiles_done, threads * sizeof(int));
+        stats->seconds = timer_seconds() - start;
+    }
+    render_job_free(&job);
+}
+
+ProgressiveSettings progressive_settings_default() {
+    ProgressiveSettings settings;
+    settings.render = render_settings_default();
+    settings.render.spp = 8;
+    settings.max_spp = 256;
+    settings.batch_spp = 4;
+    settings.pixel_error = 0.05f;
+    settings.target_error = 0.0f;
+    settings.time_budget = 0.0;
+    return settings;
+}
+
+void render_progressive(Scene* scene, Camera* camera, Image* image, AccumBuffer* accum,
+                        const ProgressiveSettings* settings, ProgressiveStats* stats) {
+    if (!scene || !camera || !image || !accum || !settings) return;
+    int threads = render_thread_count(&settings->render);
+    
+    double start = timer_seconds();
+    if (!scene->bvh) {
+        scene_build_bvh(scene);
+    }
+    
+    RenderJob job;
+    render_job_init(&job, scene, camera, image, &settings->render, threads);
+    job.accum = accum;
+    job.min_spp = settings->render.spp < 2 ? 2 : settings->render.spp;  // Variance needs two samples
+    job.max_spp = settings->max_spp < job.min_spp ? job.min_spp : settings->max_spp;
+    job.pixel_error = settings->pixel_error;
+    
+    int pixel_count = image->width * image->height;
+    int passes = 0;
+    long long samples = 0;
+    int converged = 0;
+    float error = 0.0f;
+    
+    while (1) {
+        // The first pass brings every pixel up to min_spp, later ones only
+        // add batches where the error is still too high
+        job.spp = passes == 0 ? job.min_spp : (settings->batch_spp < 1 ? 1 : settings->batch_spp);
+        samples += render_job_run(&job, threads);
+        passes++;
+        
+        int active = 0;
+        double error_sum = 0.0;
+        converged = 0;
+        for (int i = 0; i < pixel_count; i++) {
+            float e = accum_pixel_error(accum, i, job.low_discrepancy);
+            error_sum += e;
+            if (e <= job.pixel_error) converged++;
+            if (pixel_needs_samples(&job, i)) active++;
+        }
+        error = (float)(error_sum / pixel_count);
+        
+        if (active == 0) break;
+        if (settings->target_error > 0.0f && error <= settings->target_error) break;
+        if (settings->time_budget > 0.0 && timer_seconds() - start >= settings->time_budget) break;
+    }
+    
+    accum_resolve(accum, image);
+    
+    if (stats) {
+        stats->passes = passes;
+        stats->samples = samples;
+        stats->converged = converged;
+        stats->error = error;
+        stats->seconds = timer_seconds() - start;
+    }
+    render_job_free(&job);
+}
+
+void render_temporal(Scene* scene, Camera* camera, Image* image, TemporalBuffer* temporal,
+                     const RenderSettings* settings, RenderStats* stats) {
+    if (!scene || !camera || !image || !temporal || !settings) return;
+    int threads = render_thread_count(settings);
+    
+    double start = timer_seconds();
+    if (!scene->bvh) {
+        scene_build_bvh(scene);
+    }
+    
+    RenderJob job;
+    render_job_init(&job, scene, camera, image, settings, threads);
+    job.mode = RENDER_RECURSIVE;
+    job.temporal = temporal;
+    job.reuse_static = temporal_static_valid(temporal, scene, camera);
+    temporal_begin_frame(temporal);
+    render_job_run(&job, threads);
+    temporal->static_revision = scene->revision;
+    temporal_resolve(temporal, scene, camera, image);
+    
+    if (stats) {
+        stats->thread_count = threads;
+        stats->tile_count = job.tile_count;
+        memcpy(stats->tiles_per_thread, job.tiles_done, threads * sizeof(int));
+        stats->seconds = timer_seconds() - start;
+    }
+    render_job_free(&job);
+}
+
+void render_guide(Scene* scene, Camera* camera, DenoiseGuide* guide, const RenderSettings* settings) {
+    if (!scene || !camera || !guide || !settings) return;
+    int threads = render_thread_count(settings);
+    if (!scene->bvh) {
+        scene_build_bvh(scene);
+    }
+    
+    // The job only needs an image for its size
+    Image size = {guide->width, guide->height, NULL};
+    RenderJob job;
+    render_job_init(&job, scene, camera, &size, settings, threads);
+    job.mode = RENDER_RECURSIVE;
+    job.guide = guide;
+    render_job_run(&job, threads);
+    render_job_free(&job);
+}
+
+void render_guide_from_hits(Scene* scene, const RayHit* hits, DenoiseGuide* guide) {
+    int n = guide->width * guide->height;
+    for (int i = 0; i < n; i++) {
+        guide_set(guide, scene, i, &hits[i]);
+    }
+}
+
+void render_stats_print(RenderStats* stats) {
+    if (!stats) return;
+    
+    int min_tiles = stats->tile_count;
+    int max_tiles = 0;
+    printf("Rendered %d tiles on %d threads in %.3f s\n", stats->tile_count, stats->thread_count, stats->seconds);
+    for (int i = 0; i < stats->thread_count; i++) {
+        int n = stats->tiles_per_thread[i];
+        if (n < min_tiles) min_tiles = n;
+        if (n > max_tiles) max_tiles = n;
+        printf("  thread %3d: %d tiles\n", i, n);
+    }
+    printf("  tiles per thread: min %d, max %d\n", min_tiles, max_tiles);
+}
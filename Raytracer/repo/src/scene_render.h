@@ -0,0 +1,86 @@
+#ifndef SCENE_RENDER_H
+#define SCENE_RENDER_H
+
+#include "raytracer.h"
+#include "camera.h"
+#include "image.h"
+#include "accum.h"
+#include "temporal.h"
+#include "denoise.h"
+
+#define RENDER_TILE_SIZE 32
+#define RENDER_MAX_THREADS 256
+
+typedef enum {
+    RENDER_RECURSIVE,  // trace_ray per sample, primary rays in 4x4 packets
+    RENDER_WAVEFRONT   // Iterative, material-sorted bounces (wavefront.h)
+} RenderMode;
+
+typedef struct {
+    RenderMode mode;
+    int spp;
+    int max_depth;
+    int threads;  // 0 = one per CPU
+    int low_discrepancy;  // 1 = scrambled Sobol samples (see rng_sample_2d), 0 = independent random numbers
+    int stream;           // Renders on different streams draw unrelated samples, e.g. for a reference
+} RenderSettings;
+
+// Adaptive sampling: every pixel gets render.spp samples up front, then
+// passes of batch_spp more go only to pixels whose relative error is above
+// pixel_error. With low_discrepancy samples a pixel only stops at a power of
+// two samples. Stops when no pixel needs more, when the mean pixel error
+// reaches target_error or when time_budget seconds have passed (0 = off).
+typedef struct {
+    RenderSettings render;
+    int max_spp;
+    int batch_spp;
+    float pixel_error;
+    float target_error;
+    double time_budget;
+} ProgressiveSettings;
+
+typedef struct {
+    int passes;
+    long long samples;  // Camera paths traced
+    int converged;      // Pixels under pixel_error
+    float error;        // Mean relative error over all pixels
+    double seconds;
+} ProgressiveStats;
+
+typedef struct {
+    int thread_count;
+    int tile_count;
+    int tiles_per_thread[RENDER_MAX_THREADS];
+    double seconds;
+} RenderStats;
+
+RenderSettings render_settings_default();
+
+// Path trace every pixel of image. Tiles are handed out to the worker threads
+// from a shared atomic counter. Builds the scene BVH if it is missing.
+// stats may be NULL.
+void render_scene(Scene* scene, Camera* camera, Image* image, const RenderSettings* settings, RenderStats* stats);
+void render_stats_print(RenderStats* stats);
+
+ProgressiveSettings progressive_settings_default();
+
+// Refine accum (same size as image) until settings says stop, then write its
+// means into image. accum is not cleared, so calling again keeps refining.
+void render_progressive(Scene* scene, Camera* camera, Image* image, AccumBuffer* accum,
+                        const ProgressiveSettings* settings, ProgressiveStats* stats);
+
+// One real-time frame: settings->spp samples per pixel from first hits
+// through pixel centres (kept from the last frame where the camera and the
+// static objects have not changed), blended with temporal's history into
+// image. settings->mode is ignored; bounces are traced recursively.
+void render_temporal(Scene* scene, Camera* camera, Image* image, TemporalBuffer* temporal,
+                     const RenderSettings* settings, RenderStats* stats);
+
+// First-hit albedo, normal and depth through pixel centres, to guide
+// denoise_image. Only settings->threads is used.
+void render_guide(Scene* scene, Camera* camera, DenoiseGuide* guide, const RenderSettings* settings);
+
+// The same from first hits already traced, e.g. a TemporalBuffer's
+void render_guide_from_hits(Scene* scene, const RayHit* hits, DenoiseGuide* guide);
+
+#endif
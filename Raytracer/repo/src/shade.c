@@ -0,0 +1,57 @@
+#include "shade.h"
+
+#if SHADE_SIMD_WIDTH == 16
+#include <immintrin.h>
+#elif SHADE_SIMD_WIDTH == 8
+#include <emmintrin.h>
+#endif
+
+void shade_span_scalar(uint32_t color, const uint16_t* shades, int count, uint32_t* out) {
+    for (int i = 0; i < count; i++) {
+        out[i] = shade_pixel(color, shades[i]);
+    }
+}
+
+void shade_span(uint32_t color, const uint16_t* shades, int count, uint32_t* out) {
+    int i = 0;
+    
+    // The color is the same for the whole span, so each channel is one
+    // 16-bit multiply across a vector of shades. channel * shade fits in 16
+    // bits since both are at most 255 and 256.
+#if SHADE_SIMD_WIDTH == 16
+    __m256i r = _mm256_set1_epi16((short)((color >> 16) & 0xFF));
+    __m256i g = _mm256_set1_epi16((short)((color >> 8) & 0xFF));
+    __m256i b = _mm256_set1_epi16((short)(color & 0xFF));
+    for (; i + 16 <= count; i += 16) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(shades + i));
+        __m256i sr = _mm256_srli_epi16(_mm256_mullo_epi16(s, r), 8);
+        __m256i sg = _mm256_srli_epi16(_mm256_mullo_epi16(s, g), 8);
+        __m256i sb = _mm256_srli_epi16(_mm256_mullo_epi16(s, b), 8);
+        
+        // Low halves 0xGGBB, high halves 0x00RR; unpacking works per 128-bit
+        // lane, so pixels come out as 0-3, 8-11 and 4-7, 12-15
+        __m256i gb = _mm256_or_si256(_mm256_slli_epi16(sg, 8), sb);
+        __m256i lo = _mm256_unpacklo_epi16(gb, sr);
+        __m256i hi = _mm256_unpackhi_epi16(gb, sr);
+        _mm256_storeu_si256((__m256i*)(out + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+#elif SHADE_SIMD_WIDTH == 8
+    __m128i r = _mm_set1_epi16((short)((color >> 16) & 0xFF));
+    __m128i g = _mm_set1_epi16((short)((color >> 8) & 0xFF));
+    __m128i b = _mm_set1_epi16((short)(color & 0xFF));
+    for (; i + 8 <= count; i += 8) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(shades + i));
+        __m128i sr = _mm_srli_epi16(_mm_mullo_epi16(s, r), 8);
+        __m128i sg = _mm_srli_epi16(_mm_mullo_epi16(s, g), 8);
+        __m128i sb = _mm_srli_epi16(_mm_mullo_epi16(s, b), 8);
+        
+        // Low halves 0xGGBB, high halves 0x00RR
+        __m128i gb = _mm_or_si128(_mm_slli_epi16(sg, 8), sb);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi16(gb, sr));
+        _mm_storeu_si128((__m128i*)(out + i + 4), _mm_unpackhi_epi16(gb, sr));
+    }
+#endif
+    
+    shade_span_scalar(color, shades + i, count - i, out + i);
+}
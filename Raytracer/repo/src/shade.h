@@ -0,0 +1,39 @@
+#ifndef SHADE_H
+#define SHADE_H
+
+#include <stdint.h>
+
+// Packed 0xRRGGBB colors scaled by 8.8 fixed-point shade factors: each
+// channel becomes (channel * shade) >> 8, with shade in [0, SHADE_ONE]
+
+#define SHADE_ONE 256
+
+// Pixels shaded per SIMD instruction (16 with AVX2, 8 with SSE2, 1 otherwise)
+#if defined(__AVX2__)
+#define SHADE_SIMD_WIDTH 16
+#elif defined(__SSE2__)
+#define SHADE_SIMD_WIDTH 8
+#else
+#define SHADE_SIMD_WIDTH 1
+#endif
+
+// A float shade factor in [0, 1] as 8.8 fixed point, rounded
+static inline uint16_t shade_fixed(float shade) {
+    int s = (int)(shade * SHADE_ONE + 0.5f);
+    return (uint16_t)(s < 0 ? 0 : (s > SHADE_ONE ? SHADE_ONE : s));
+}
+
+static inline uint32_t shade_pixel(uint32_t color, uint32_t shade) {
+    uint32_t r = (((color >> 16) & 0xFF) * shade) >> 8;
+    uint32_t g = (((color >> 8) & 0xFF) * shade) >> 8;
+    uint32_t b = ((color & 0xFF) * shade) >> 8;
+    return (r << 16) | (g << 8) | b;
+}
+
+// out[i] = color shaded by shades[i]
+void shade_span(uint32_t color, const uint16_t* shades, int count, uint32_t* out);
+
+// The same one pixel at a time, for reference
+void shade_span_scalar(uint32_t color, const uint16_t* shades, int count, uint32_t* out);
+
+#endif
@@ -0,0 +1,85 @@
+#include "simulation.h"
+#include <stdlib.h>
+
+static void run_tick(Simulation* simulation, GameInput input) {
+    GameState* game = simulation->game;
+    game_handle_input(game, input.up, input.down, input.left, input.right, input.fire);
+    game_update(game, simulation->tick_dt);
+    simulation->completed++;
+    
+    snapshot_capture(snapshot_buffer_back(&simulation->snapshots), game, simulation->completed);
+    snapshot_buffer_publish(&simulation->snapshots);
+}
+
+static void simulation_main(void* ctx) {
+    Simulation* simulation = (Simulation*)ctx;
+    for (;;) {
+        parallel_semaphore_wait(simulation->work);
+        
+        // Every tick is posted once, so waking with none queued means stop
+        if (simulation->completed == parallel_load(&simulation->queued)) break;
+        
+        run_tick(simulation, simulation->queue[simulation->completed % SIMULATION_QUEUE_SIZE]);
+        parallel_semaphore_post(simulation->space);
+    }
+}
+
+Simulation* simulation_create(GameState* game, float tick_dt, int threaded) {
+    Simulation* simulation = (Simulation*)calloc(1, sizeof(Simulation));
+    simulation->game = game;
+    simulation->tick_dt = tick_dt;
+    snapshot_buffer_init(&simulation->snapshots);
+    snapshot_capture(snapshot_buffer_back(&simulation->snapshots), game, 0);
+    snapshot_buffer_publish(&simulation->snapshots);
+    
+    if (threaded) {
+        simulation->work = parallel_semaphore_create(0);
+        simulation->space = parallel_semaphore_create(SIMULATION_QUEUE_SIZE);
+        simulation->thread = parallel_thread_start(simulation_main, simulation);
+    }
+    return simulation;
+}
+
+void simulation_free(Simulation* simulation) {
+    if (!simulation) return;
+    if (simulation->thread) {
+        parallel_semaphore_post(simulation->work);
+        parallel_thread_join(simulation->thread);
+    }
+    parallel_semaphore_free(simulation->work);
+    parallel_semaphore_free(simulation->space);
+    snapshot_buffer_free(&simulation->snapshots);
+    free(simulation);
+}
+
+void simulation_queue(Simulation* simulation, GameInput input) {
+    if (!simulation->thread) {
+        simulation->queued++;
+        run_tick(simulation, input);
+        return;
+    }
+    
+    parallel_semaphore_wait(simulation->space);
+    simulation->queue[simulation->queued % SIMULATION_QUEUE_SIZE] = input;
+    parallel_store(&simulation->queued, simulation->queued + 1);
+    parallel_semaphore_post(simulation->work);
+}
+
+void simulation_frame(Simulation* simulation, GameSnapshot* frame, float tick_fraction) {
+    SnapshotBuffer* snapshots = &simulation->snapshots;
+    snapshot_buffer_acquire(snapshots);
+    const GameSnapshot* newest = snapshot_buffer_front(snapshots);
+    const GameSnapshot* previous = snapshot_buffer_previous(snapshots);
+    if (previous->tick < 0 || previous->tick >= newest->tick) {
+        snapshot_copy(frame, newest);
+        return;
+    }
+    
+    // Draw one tick behind the queue, so there is usually a snapshot on
+    // either side of the frame's time
+    float tick = (float)(simulation->queued - 1) + tick_fraction;
+    float t = (tick - previous->tick) / (float)(newest->tick - previous->tick);
+    if (t > 1.0f) t = 1.0f;
+    if (t < 0.0f) t = 0.0f;
+    snapshot_lerp(frame, previous, newest, t);
+}
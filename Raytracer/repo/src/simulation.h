@@ -0,0 +1,50 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "game.h"
+#include "snapshot.h"
+#include "parallel.h"
+
+// Runs the game's ticks for the frame loop, on a thread of its own when it
+// can, so tick N+1 is simulated while tick N is being drawn. The loop
+// queues fixed-length ticks with the input for each and draws from
+// snapshots; since each tick's input is fixed when it is queued, a run
+// comes out the same whether ticks run on the thread or inline.
+
+typedef struct {
+    int up, down, left, right, fire;
+} GameInput;
+
+#define SIMULATION_QUEUE_SIZE 64
+
+typedef struct {
+    GameState* game;     // Only touched by the simulation until simulation_free
+    float tick_dt;
+    SnapshotBuffer snapshots;
+    
+    // Ticks waiting to run are queue[i % SIMULATION_QUEUE_SIZE] for
+    // completed <= i < queued
+    GameInput queue[SIMULATION_QUEUE_SIZE];
+    int queued;          // Written by the caller only
+    int completed;       // Written by the simulation only
+    ParallelSemaphore* work;   // Posted once per queued tick, and once more to stop
+    ParallelSemaphore* space;  // Free queue entries
+    ParallelThread* thread;    // NULL: ticks run inline in simulation_queue
+} Simulation;
+
+// Publishes a snapshot of the game as it is, as tick 0
+Simulation* simulation_create(GameState* game, float tick_dt, int threaded);
+// Runs whatever is still queued and stops the thread; the game is the caller's again
+void simulation_free(Simulation* simulation);
+
+// Run one more tick with this input. Waits only if the simulation is a
+// whole queue behind.
+void simulation_queue(Simulation* simulation, GameInput input);
+
+// Fill frame with the game as it was tick_fraction of a tick after the
+// newest queued tick's start, one tick behind the queue, interpolating
+// between the two newest snapshots. Shows the newest snapshot as is when
+// the simulation has fallen further behind than that.
+void simulation_frame(Simulation* simulation, GameSnapshot* frame, float tick_fraction);
+
+#endif
@@ -0,0 +1,129 @@
+#include "snapshot.h"
+#include "parallel.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Set in SnapshotBuffer.middle while the reader has not taken that slot
+#define SNAPSHOT_FRESH 0x100
+
+void snapshot_init(GameSnapshot* snapshot) {
+    memset(snapshot, 0, sizeof(GameSnapshot));
+    snapshot->tick = -1;
+    enemy_pool_init(&snapshot->enemies);
+    projectile_pool_init(&snapshot->projectiles);
+}
+
+void snapshot_free(GameSnapshot* snapshot) {
+    enemy_pool_free(&snapshot->enemies);
+    projectile_pool_free(&snapshot->projectiles);
+    free(snapshot->environment.structures);
+}
+
+void snapshot_capture(GameSnapshot* snapshot, const GameState* game, int tick) {
+    snapshot->tick = tick;
+    snapshot->time = game->time_elapsed;
+    snapshot->player = game->player;
+    enemy_pool_copy(&snapshot->enemies, &game->enemies);
+    projectile_pool_copy(&snapshot->projectiles, &game->projectiles);
+    environment_copy(&snapshot->environment, game->environment);
+    snapshot->score = game->score;
+}
+
+void snapshot_copy(GameSnapshot* dst, const GameSnapshot* src) {
+    dst->tick = src->tick;
+    dst->time = src->time;
+    dst->player = src->player;
+    enemy_pool_copy(&dst->enemies, &src->enemies);
+    projectile_pool_copy(&dst->projectiles, &src->projectiles);
+    environment_copy(&dst->environment, &src->environment);
+    dst->score = src->score;
+}
+
+static float lerp(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+static Vec3 lerp_vec3(Vec3 a, Vec3 b, float t) {
+    return vec3_add(a, vec3_mul(vec3_sub(b, a), t));
+}
+
+void snapshot_lerp(GameSnapshot* dst, const GameSnapshot* from, const GameSnapshot* to, float t) {
+    snapshot_copy(dst, to);
+    dst->time = lerp(from->time, to->time, t);
+    
+    Player* player = &dst->player;
+    player->position = lerp_vec3(from->player.position, to->player.position, t);
+    Vec3 direction = lerp_vec3(from->player.direction, to->player.direction, t);
+    if (vec3_length(direction) > 1e-3f) player->direction = vec3_normalize(direction);
+    
+    // The clock wraps at 24 hours; go the short way round
+    float from_hour = from->environment.time_of_day;
+    float to_hour = to->environment.time_of_day;
+    if (to_hour < from_hour - 12.0f) from_hour -= 24.0f;
+    float hour = lerp(from_hour, to_hour, t);
+    dst->environment.time_of_day = hour < 0.0f ? hour + 24.0f : hour;
+    
+    // Entities keep their handle across snapshots even when swap-removal
+    // has moved them to another index
+    EnemyPool* enemies = &dst->enemies;
+    for (int i = 0; i < enemies->count; i++) {
+        int j = enemy_pool_find(&from->enemies, enemy_pool_handle(enemies, i));
+        if (j < 0) continue;
+        enemies->x[i] = lerp(from->enemies.x[j], enemies->x[i], t);
+        enemies->y[i] = lerp(from->enemies.y[j], enemies->y[i], t);
+        enemies->z[i] = lerp(from->enemies.z[j], enemies->z[i], t);
+    }
+    
+    ProjectilePool* projectiles = &dst->projectiles;
+    for (int i = 0; i < projectiles->count; i++) {
+        int j = projectile_pool_find(&from->projectiles, projectile_pool_handle(projectiles, i));
+        if (j < 0) continue;
+        projectiles->x[i] = lerp(from->projectiles.x[j], projectiles->x[i], t);
+        projectiles->y[i] = lerp(from->projectiles.y[j], projectiles->y[i], t);
+        projectiles->z[i] = lerp(from->projectiles.z[j], projectiles->z[i], t);
+    }
+}
+
+void snapshot_buffer_init(SnapshotBuffer* buffer) {
+    for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+        snapshot_init(&buffer->slots[i]);
+    }
+    buffer->back = 0;
+    buffer->middle = 1;
+    buffer->front = 2;
+    buffer->previous = 3;
+}
+
+void snapshot_buffer_free(SnapshotBuffer* buffer) {
+    for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+        snapshot_free(&buffer->slots[i]);
+    }
+}
+
+GameSnapshot* snapshot_buffer_back(SnapshotBuffer* buffer) {
+    return &buffer->slots[buffer->back];
+}
+
+void snapshot_buffer_publish(SnapshotBuffer* buffer) {
+    // Whatever the reader has not taken yet is stale now; write over it next
+    int old = parallel_exchange(&buffer->middle, buffer->back | SNAPSHOT_FRESH);
+    buffer->back = old & ~SNAPSHOT_FRESH;
+}
+
+int snapshot_buffer_acquire(SnapshotBuffer* buffer) {
+    if (!(parallel_load(&buffer->middle) & SNAPSHOT_FRESH)) return 0;
+    
+    // Hand back the oldest slot; the newest becomes the previous one
+    int taken = parallel_exchange(&buffer->middle, buffer->previous);
+    buffer->previous = buffer->front;
+    buffer->front = taken & ~SNAPSHOT_FRESH;
+    return 1;
+}
+
+const GameSnapshot* snapshot_buffer_front(const SnapshotBuffer* buffer) {
+    return &buffer->slots[buffer->front];
+}
+
+const GameSnapshot* snapshot_buffer_previous(const SnapshotBuffer* buffer) {
+    return &buffer->slots[buffer->previous];
+}
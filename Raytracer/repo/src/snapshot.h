@@ -0,0 +1,58 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "game.h"
+
+// What the renderer reads from a GameState and its Environment, copied at
+// the end of a simulation tick so the render thread can draw it while the
+// next tick runs. Snapshots are never written once published.
+
+typedef struct {
+    int tick;                  // Ticks simulated when it was taken, -1 = empty
+    float time;                // Simulation time of that tick
+    Player player;
+    EnemyPool enemies;
+    ProjectilePool projectiles;
+    Environment environment;   // Owns its copy of the structures
+    int score;
+} GameSnapshot;
+
+void snapshot_init(GameSnapshot* snapshot);
+void snapshot_free(GameSnapshot* snapshot);
+void snapshot_capture(GameSnapshot* snapshot, const GameState* game, int tick);
+void snapshot_copy(GameSnapshot* dst, const GameSnapshot* src);
+
+// dst = to, with everything that is also in from placed a fraction t of the
+// way from its position in from to its position in to. Entities spawned
+// since from stay where to has them.
+void snapshot_lerp(GameSnapshot* dst, const GameSnapshot* from, const GameSnapshot* to, float t);
+
+// Lock-free exchange of snapshots between one writer and one reader: the
+// writer fills its back slot and publishes it, the reader takes the newest
+// published one. Neither ever waits for the other. On top of the usual
+// three slots the reader keeps its previous snapshot, to interpolate from.
+#define SNAPSHOT_SLOTS 4
+
+typedef struct {
+    GameSnapshot slots[SNAPSHOT_SLOTS];
+    int back;      // Writer's slot
+    int middle;    // Latest published slot, ORed with SNAPSHOT_FRESH until the reader takes it
+    int front;     // Reader's newest slot
+    int previous;  // Reader's slot before that
+} SnapshotBuffer;
+
+void snapshot_buffer_init(SnapshotBuffer* buffer);
+void snapshot_buffer_free(SnapshotBuffer* buffer);
+
+// Writer side
+GameSnapshot* snapshot_buffer_back(SnapshotBuffer* buffer);
+void snapshot_buffer_publish(SnapshotBuffer* buffer);
+
+// Reader side: take the newest published snapshot if there is one the
+// reader has not seen, and return 1 if so. The reader's snapshots stay valid
+// until its next acquire.
+int snapshot_buffer_acquire(SnapshotBuffer* buffer);
+const GameSnapshot* snapshot_buffer_front(const SnapshotBuffer* buffer);
+const GameSnapshot* snapshot_buffer_previous(const SnapshotBuffer* buffer);
+
+#endif
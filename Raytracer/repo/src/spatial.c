@@ -0,0 +1,141 @@
+#include "spatial.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define SPATIAL_MIN_BUCKETS 64
+
+typedef struct {
+    int x0, z0, x1, z1;  // Inclusive cell range
+} CellRange;
+
+static CellRange cell_range(const SpatialHash* hash, SpatialBox box) {
+    CellRange range;
+    float inv = 1.0f / hash->cell_size;
+    range.x0 = (int)floorf(box.min_x * inv);
+    range.z0 = (int)floorf(box.min_z * inv);
+    range.x1 = (int)floorf(box.max_x * inv);
+    range.z1 = (int)floorf(box.max_z * inv);
+    return range;
+}
+
+// A range with more cells than there are buckets touches every bucket
+static int covers_all(const SpatialHash* hash, CellRange range) {
+    return (long long)(range.x1 - range.x0 + 1) * (range.z1 - range.z0 + 1) > hash->bucket_mask;
+}
+
+static inline int bucket(const SpatialHash* hash, int x, int z) {
+    return (int)(((unsigned)x * 73856093u ^ (unsigned)z * 19349663u) & (unsigned)hash->bucket_mask);
+}
+
+void spatial_hash_init(SpatialHash* hash, float cell_size) {
+    hash->cell_size = cell_size;
+    hash->bucket_mask = SPATIAL_MIN_BUCKETS - 1;
+    hash->start = (int*)calloc(SPATIAL_MIN_BUCKETS + 1, sizeof(int));
+    hash->item_capacity = 256;
+    hash->items = (int*)malloc(hash->item_capacity * sizeof(int));
+    hash->stamps = NULL;
+    hash->stamp = 0;
+    hash->box_count = 0;
+    hash->box_capacity = 0;
+}
+
+void spatial_hash_free(SpatialHash* hash) {
+    free(hash->start);
+    free(hash->items);
+    free(hash->stamps);
+}
+
+void spatial_hash_build(SpatialHash* hash, const SpatialBox* boxes, int count) {
+    // About two buckets per box keeps chains short without a sparse table
+    int buckets = SPATIAL_MIN_BUCKETS;
+    while (buckets < 2 * count) buckets *= 2;
+    if (buckets != hash->bucket_mask + 1) {
+        hash->bucket_mask = buckets - 1;
+        free(hash->start);
+        hash->start = (int*)malloc((buckets + 1) * sizeof(int));
+    }
+    if (count > hash->box_capacity) {
+        hash->box_capacity = count;
+        free(hash->stamps);
+        hash->stamps = (int*)malloc(count * sizeof(int));
+    }
+    if (count > 0) memset(hash->stamps, 0, count * sizeof(int));
+    hash->stamp = 0;
+    hash->box_count = count;
+    
+    // Count into start[b + 1]
+    int* start = hash->start;
+    memset(start, 0, (buckets + 1) * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        CellRange range = cell_range(hash, boxes[i]);
+        if (covers_all(hash, range)) {
+            for (int b = 0; b < buckets; b++) start[b + 1]++;
+            continue;
+        }
+        for (int z = range.z0; z <= range.z1; z++) {
+            for (int x = range.x0; x <= range.x1; x++) {
+                start[bucket(hash, x, z) + 1]++;
+            }
+        }
+    }
+    for (int b = 0; b < buckets; b++) {
+        start[b + 1] += start[b];
+    }
+    
+    int total = start[buckets];
+    if (total > hash->item_capacity) {
+        while (total > hash->item_capacity) hash->item_capacity *= 2;
+        free(hash->items);
+        hash->items = (int*)malloc(hash->item_capacity * sizeof(int));
+    }
+    
+    // Fill using start[b] as the cursor, which leaves it at the old start[b + 1]
+    for (int i = 0; i < count; i++) {
+        CellRange range = cell_range(hash, boxes[i]);
+        if (covers_all(hash, range)) {
+            for (int b = 0; b < buckets; b++) hash->items[start[b]++] = i;
+            continue;
+        }
+        for (int z = range.z0; z <= range.z1; z++) {
+            for (int x = range.x0; x <= range.x1; x++) {
+                hash->items[start[bucket(hash, x, z)]++] = i;
+            }
+        }
+    }
+    memmove(start + 1, start, buckets * sizeof(int));
+    start[0] = 0;
+}
+
+static int query_bucket(SpatialHash* hash, int b, int* out, int found) {
+    for (int i = hash->start[b]; i < hash->start[b + 1]; i++) {
+        int item = hash->items[i];
+        if (hash->stamps[item] == hash->stamp) continue;
+        hash->stamps[item] = hash->stamp;
+        out[found++] = item;
+    }
+    return found;
+}
+
+int spatial_hash_query(SpatialHash* hash, SpatialBox box, int* out) {
+    if (hash->box_count == 0) return 0;
+    
+    // Stamps only need to differ from every earlier query's
+    if (++hash->stamp == 0x7fffffff) {
+        memset(hash->stamps, 0, hash->box_count * sizeof(int));
+        hash->stamp = 1;
+    }
+    
+    int found = 0;
+    CellRange range = cell_range(hash, box);
+    if (covers_all(hash, range)) {
+        for (int b = 0; b <= hash->bucket_mask; b++) found = query_bucket(hash, b, out, found);
+        return found;
+    }
+    for (int z = range.z0; z <= range.z1; z++) {
+        for (int x = range.x0; x <= range.x1; x++) {
+            found = query_bucket(hash, bucket(hash, x, z), out, found);
+        }
+    }
+    return found;
+}
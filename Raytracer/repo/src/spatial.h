@@ -0,0 +1,44 @@
+#ifndef SPATIAL_H
+#define SPATIAL_H
+
+// Uniform spatial hash over the ground (x, z) plane for collision queries.
+// Items are boxes; each is filed under every cell it overlaps, and cells
+// hash into a power-of-two bucket table, so the world needs no bounds.
+// Buckets are stored CSR-style like the renderer's tile bins, and a rebuild
+// is two counting passes over the items.
+
+typedef struct {
+    float min_x, min_z;
+    float max_x, max_z;
+} SpatialBox;
+
+typedef struct {
+    float cell_size;
+    int bucket_mask;    // Bucket count - 1
+    
+    // Bucket b holds items[start[b]] .. items[start[b + 1] - 1]
+    int* start;
+    int* items;
+    int item_capacity;
+    
+    // Items already returned by the current query, so a box filed in several
+    // cells (or several cells sharing a bucket) comes back once
+    int* stamps;
+    int stamp;
+    int box_count;      // Boxes in the last build
+    int box_capacity;
+} SpatialHash;
+
+void spatial_hash_init(SpatialHash* hash, float cell_size);
+void spatial_hash_free(SpatialHash* hash);
+
+// Replace the contents with boxes[0 .. count - 1], filed by index
+void spatial_hash_build(SpatialHash* hash, const SpatialBox* boxes, int count);
+
+// Write the indices of items filed in the cells box overlaps to out, each
+// once and in no particular order, and return how many there are (at most
+// the last build's count). These are candidates: callers still run their
+// exact test on each.
+int spatial_hash_query(SpatialHash* hash, SpatialBox box, int* out);
+
+#endif
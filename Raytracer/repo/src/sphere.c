@@ -1,60 +1,403 @@
 #include "sphere.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#if SPHERE_SIMD_WIDTH == 8
+#include <immintrin.h>
+#elif SPHERE_SIMD_WIDTH == 4
+#include <emmintrin.h>
+#endif
+
 Sphere sphere_create(Vec3 center, float radius, int material_id) {
     return (Sphere){center, radius, material_id};
 }
 
-int sphere_hit(Sphere sphere, Ray ray, float t_min, float t_max, RayHit* hit) {
-    Vec3 oc = vec3_sub(ray.origin, sphere.center);
-    
-    float a = vec3_dot(ray.direction, ray.direction);
-    float b = 2.0f * vec3_dot(oc, ray.direction);
-    float c = vec3_dot(oc, oc) - sphere.radius * sphere.radius;
-    
-    float discriminant = b * b - 4 * a * c;
+// Nearest root in [t_min, t_max] given a = dot(dir, dir). Every intersection
+// path (AoS, SoA scalar and SIMD) performs exactly this sequence of float
+// operations so that they all return bit-identical distances.
+static int sphere_intersect(float cx, float cy, float cz, float radius2, Ray ray, float a,
+                            float t_min, float t_max, float* t) {
+    float ocx = ray.origin.x - cx;
+    float ocy = ray.origin.y - cy;
+    float ocz = ray.origin.z - cz;
+
+    float half_b = ocx * ray.direction.x + ocy * ray.direction.y + ocz * ray.direction.z;
+    float c = ocx * ocx + ocy * ocy + ocz * ocz - radius2;
+
+    float discriminant = half_b * half_b - a * c;
     if (discriminant < 0) {
         return 0;
     }
-    
+
     float sqrtd = sqrtf(discriminant);
-    float root = (-b - sqrtd) / (2 * a);
-    
+    float root = (-half_b - sqrtd) / a;
+
     if (root < t_min || root > t_max) {
-        root = (-b + sqrtd) / (2 * a);
+        root = (-half_b + sqrtd) / a;
         if (root < t_min || root > t_max) {
             return 0;
         }
     }
-    
-    hit->t = root;
-    hit->point = ray_at(ray, root);
+
+    *t = root;
+    return 1;
+}
+
+static float ray_length2(Ray ray) {
+    return ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y + ray.direction.z * ray.direction.z;
+}
+
+int sphere_hit(Sphere sphere, Ray ray, float t_min, float t_max, RayHit* hit) {
+    float root;
+    if (!sphere_intersect(sphere.center.x, sphere.center.y, sphere.center.z, sphere.radius * sphere.radius,
+                          ray, ray_length2(ray), t_min, t_max, &root)) {
+        return 0;
+    }
+
+    sphere_hit_record(sphere, ray, root, hit);
+    hit->object = 0;
+    return 1;
+}
+
+void sphere_hit_record(Sphere sphere, Ray ray, float t, RayHit* hit) {
+    hit->t = t;
+    hit->point = ray_at(ray, t);
     Vec3 outward_normal = vec3_mul(vec3_sub(hit->point, sphere.center), 1.0f / sphere.radius);
-    
+
     float dot = vec3_dot(ray.direction, outward_normal);
     if (dot > 0) {
         hit->normal = vec3_mul(outward_normal, -1.0f);
     } else {
         hit->normal = outward_normal;
     }
-    
+
     hit->material_id = sphere.material_id;
     hit->hit = 1;
-    return 1;
 }
 
+static void sphere_soa_reserve(SphereSoA* soa, int capacity) {
+    int old_size = soa->capacity + SPHERE_SOA_PADDING;
+    int new_size = capacity + SPHERE_SOA_PADDING;
+
+    soa->center_x = (float*)realloc(soa->center_x, new_size * sizeof(float));
+    soa->center_y = (float*)realloc(soa->center_y, new_size * sizeof(float));
+    soa->center_z = (float*)realloc(soa->center_z, new_size * sizeof(float));
+    soa->radius2 = (float*)realloc(soa->radius2, new_size * sizeof(float));
+    soa->material_id = (int*)realloc(soa->material_id, new_size * sizeof(int));
+
+    // Padding is read by full-width loads, keep it initialized
+    if (!soa->capacity) old_size = 0;
+    int grown = new_size - old_size;
+    memset(soa->center_x + old_size, 0, grown * sizeof(float));
+    memset(soa->center_y + old_size, 0, grown * sizeof(float));
+    memset(soa->center_z + old_size, 0, grown * sizeof(float));
+    memset(soa->radius2 + old_size, 0, grown * sizeof(float));
+    memset(soa->material_id + old_size, 0, grown * sizeof(int));
+    soa->capacity = capacity;
+}
+
+SphereSoA* sphere_soa_create(int capacity) {
+    SphereSoA* soa = (SphereSoA*)calloc(1, sizeof(SphereSoA));
+    sphere_soa_reserve(soa, capacity > 0 ? capacity : 1);
+    return soa;
+}
+
+void sphere_soa_free(SphereSoA* soa) {
+    if (soa) {
+        free(soa->center_x);
+        free(soa->center_y);
+        free(soa->center_z);
+        free(soa->radius2);
+        free(soa->material_id);
+        free(soa);
+    }
+}
+
+void sphere_soa_add(SphereSoA* soa, Sphere sphere) {
+    if (soa->count >= soa->capacity) {
+        sphere_soa_reserve(soa, soa->capacity * 2);
+    }
+    sphere_soa_set(soa, soa->count++, sphere);
+}
+
+void sphere_soa_set(SphereSoA* soa, int index, Sphere sphere) {
+    soa->center_x[index] = sphere.center.x;
+    soa->center_y[index] = sphere.center.y;
+    soa->center_z[index] = sphere.center.z;
+    soa->radius2[index] = sphere.radius * sphere.radius;
+    soa->material_id[index] = sphere.material_id;
+}
+
+Sphere sphere_soa_get(const SphereSoA* soa, int index) {
+    return sphere_create(vec3_new(soa->center_x[index], soa->center_y[index], soa->center_z[index]),
+                         sqrtf(soa->radius2[index]), soa->material_id[index]);
+}
+
+int sphere_soa_hit_closest_scalar(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max, float* t) {
+    float a = ray_length2(ray);
+    float closest = t_max;
+    int best = -1;
+
+    for (int i = begin; i < end; i++) {
+        float root;
+        if (sphere_intersect(soa->center_x[i], soa->center_y[i], soa->center_z[i], soa->radius2[i],
+                             ray, a, t_min, t_max, &root) && root <= closest) {
+            closest = root;
+            best = i;
+        }
+    }
+
+    *t = closest;
+    return best;
+}
+
+int sphere_soa_occluded_scalar(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max) {
+    float a = ray_length2(ray);
+    for (int i = begin; i < end; i++) {
+        float root;
+        if (sphere_intersect(soa->center_x[i], soa->center_y[i], soa->center_z[i], soa->radius2[i],
+                             ray, a, t_min, t_max, &root)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Pick the lane result the sequential loop would have kept
+static int reduce_lanes(const float* lane_t, const int* lane_index, int width, float t_max, float* t) {
+    float closest = t_max;
+    int best = -1;
+    for (int k = 0; k < width; k++) {
+        if (lane_index[k] < 0) continue;
+        if (lane_t[k] < closest || (lane_t[k] == closest && lane_index[k] > best)) {
+            closest = lane_t[k];
+            best = lane_index[k];
+        }
+    }
+    *t = closest;
+    return best;
+}
+
+#if SPHERE_SIMD_WIDTH == 8
+
+int sphere_soa_hit_closest(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max, float* t) {
+    __m256 ox = _mm256_set1_ps(ray.origin.x);
+    __m256 oy = _mm256_set1_ps(ray.origin.y);
+    __m256 oz = _mm256_set1_ps(ray.origin.z);
+    __m256 dx = _mm256_set1_ps(ray.direction.x);
+    __m256 dy = _mm256_set1_ps(ray.direction.y);
+    __m256 dz = _mm256_set1_ps(ray.direction.z);
+    __m256 a = _mm256_set1_ps(ray_length2(ray));
+    __m256 tmin = _mm256_set1_ps(t_min);
+    __m256 tmax = _mm256_set1_ps(t_max);
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 zero = _mm256_setzero_ps();
+
+    __m256 best_t = tmax;
+    __m256i best_i = _mm256_set1_epi32(-1);
+    __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i limit = _mm256_set1_epi32(end);
+
+    for (int i = begin; i < end; i += 8) {
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(i), lanes);
+        __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(soa->center_x + i));
+        __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(soa->center_y + i));
+        __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(soa->center_z + i));
+
+        __m256 half_b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)),
+                                               _mm256_mul_ps(ocz, ocz)), _mm256_loadu_ps(soa->radius2 + i));
+        __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(a, c));
+
+        __m256 sqrtd = _mm256_sqrt_ps(discriminant);
+        __m256 neg_half_b = _mm256_xor_ps(half_b, sign);
+        __m256 near = _mm256_div_ps(_mm256_sub_ps(neg_half_b, sqrtd), a);
+        __m256 far = _mm256_div_ps(_mm256_add_ps(neg_half_b, sqrtd), a);
+
+        __m256 near_ok = _mm256_and_ps(_mm256_cmp_ps(near, tmin, _CMP_GE_OQ), _mm256_cmp_ps(near, tmax, _CMP_LE_OQ));
+        __m256 far_ok = _mm256_and_ps(_mm256_cmp_ps(far, tmin, _CMP_GE_OQ), _mm256_cmp_ps(far, tmax, _CMP_LE_OQ));
+        __m256 root = _mm256_blendv_ps(far, near, near_ok);
+
+        __m256 ok = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ), _mm256_or_ps(near_ok, far_ok));
+        ok = _mm256_and_ps(ok, _mm256_cmp_ps(root, best_t, _CMP_LE_OQ));
+        ok = _mm256_and_ps(ok, _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, index)));
+
+        best_t = _mm256_blendv_ps(best_t, root, ok);
+        best_i = _mm256_blendv_epi8(best_i, index, _mm256_castps_si256(ok));
+    }
+
+    float lane_t[8];
+    int lane_index[8];
+    _mm256_storeu_ps(lane_t, best_t);
+    _mm256_storeu_si256((__m256i*)lane_index, best_i);
+    return reduce_lanes(lane_t, lane_index, 8, t_max, t);
+}
+
+int sphere_soa_occluded(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max) {
+    __m256 ox = _mm256_set1_ps(ray.origin.x);
+    __m256 oy = _mm256_set1_ps(ray.origin.y);
+    __m256 oz = _mm256_set1_ps(ray.origin.z);
+    __m256 dx = _mm256_set1_ps(ray.direction.x);
+    __m256 dy = _mm256_set1_ps(ray.direction.y);
+    __m256 dz = _mm256_set1_ps(ray.direction.z);
+    __m256 a = _mm256_set1_ps(ray_length2(ray));
+    __m256 tmin = _mm256_set1_ps(t_min);
+    __m256 tmax = _mm256_set1_ps(t_max);
+    __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 zero = _mm256_setzero_ps();
+    __m256i lanes = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i limit = _mm256_set1_epi32(end);
+
+    for (int i = begin; i < end; i += 8) {
+        __m256i index = _mm256_add_epi32(_mm256_set1_epi32(i), lanes);
+        __m256 ocx = _mm256_sub_ps(ox, _mm256_loadu_ps(soa->center_x + i));
+        __m256 ocy = _mm256_sub_ps(oy, _mm256_loadu_ps(soa->center_y + i));
+        __m256 ocz = _mm256_sub_ps(oz, _mm256_loadu_ps(soa->center_z + i));
+
+        __m256 half_b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, dx), _mm256_mul_ps(ocy, dy)), _mm256_mul_ps(ocz, dz));
+        __m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ocx, ocx), _mm256_mul_ps(ocy, ocy)),
+                                               _mm256_mul_ps(ocz, ocz)), _mm256_loadu_ps(soa->radius2 + i));
+        __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(a, c));
+
+        __m256 sqrtd = _mm256_sqrt_ps(discriminant);
+        __m256 neg_half_b = _mm256_xor_ps(half_b, sign);
+        __m256 near = _mm256_div_ps(_mm256_sub_ps(neg_half_b, sqrtd), a);
+        __m256 far = _mm256_div_ps(_mm256_add_ps(neg_half_b, sqrtd), a);
+
+        __m256 near_ok = _mm256_and_ps(_mm256_cmp_ps(near, tmin, _CMP_GE_OQ), _mm256_cmp_ps(near, tmax, _CMP_LE_OQ));
+        __m256 far_ok = _mm256_and_ps(_mm256_cmp_ps(far, tmin, _CMP_GE_OQ), _mm256_cmp_ps(far, tmax, _CMP_LE_OQ));
+        __m256 ok = _mm256_and_ps(_mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ), _mm256_or_ps(near_ok, far_ok));
+        ok = _mm256_and_ps(ok, _mm256_castsi256_ps(_mm256_cmpgt_epi32(limit, index)));
+        if (_mm256_movemask_ps(ok)) return 1;
+    }
+    return 0;
+}
+
+#elif SPHERE_SIMD_WIDTH == 4
+
+static __m128 select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+int sphere_soa_hit_closest(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max, float* t) {
+    __m128 ox = _mm_set1_ps(ray.origin.x);
+    __m128 oy = _mm_set1_ps(ray.origin.y);
+    __m128 oz = _mm_set1_ps(ray.origin.z);
+    __m128 dx = _mm_set1_ps(ray.direction.x);
+    __m128 dy = _mm_set1_ps(ray.direction.y);
+    __m128 dz = _mm_set1_ps(ray.direction.z);
+    __m128 a = _mm_set1_ps(ray_length2(ray));
+    __m128 tmin = _mm_set1_ps(t_min);
+    __m128 tmax = _mm_set1_ps(t_max);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 zero = _mm_setzero_ps();
+
+    __m128 best_t = tmax;
+    __m128i best_i = _mm_set1_epi32(-1);
+    __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+    __m128i limit = _mm_set1_epi32(end);
+
+    for (int i = begin; i < end; i += 4) {
+        __m128i index = _mm_add_epi32(_mm_set1_epi32(i), lanes);
+        __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(soa->center_x + i));
+        __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(soa->center_y + i));
+        __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(soa->center_z + i));
+
+        __m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+                              _mm_loadu_ps(soa->radius2 + i));
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+
+        __m128 sqrtd = _mm_sqrt_ps(discriminant);
+        __m128 neg_half_b = _mm_xor_ps(half_b, sign);
+        __m128 near = _mm_div_ps(_mm_sub_ps(neg_half_b, sqrtd), a);
+        __m128 far = _mm_div_ps(_mm_add_ps(neg_half_b, sqrtd), a);
+
+        __m128 near_ok = _mm_and_ps(_mm_cmpge_ps(near, tmin), _mm_cmple_ps(near, tmax));
+        __m128 far_ok = _mm_and_ps(_mm_cmpge_ps(far, tmin), _mm_cmple_ps(far, tmax));
+        __m128 root = select_ps(near_ok, near, far);
+
+        __m128 ok = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_or_ps(near_ok, far_ok));
+        ok = _mm_and_ps(ok, _mm_cmple_ps(root, best_t));
+        ok = _mm_and_ps(ok, _mm_castsi128_ps(_mm_cmplt_epi32(index, limit)));
+
+        best_t = select_ps(ok, root, best_t);
+        best_i = _mm_castps_si128(select_ps(ok, _mm_castsi128_ps(index), _mm_castsi128_ps(best_i)));
+    }
+
+    float lane_t[4];
+    int lane_index[4];
+    _mm_storeu_ps(lane_t, best_t);
+    _mm_storeu_si128((__m128i*)lane_index, best_i);
+    return reduce_lanes(lane_t, lane_index, 4, t_max, t);
+}
+
+int sphere_soa_occluded(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max) {
+    __m128 ox = _mm_set1_ps(ray.origin.x);
+    __m128 oy = _mm_set1_ps(ray.origin.y);
+    __m128 oz = _mm_set1_ps(ray.origin.z);
+    __m128 dx = _mm_set1_ps(ray.direction.x);
+    __m128 dy = _mm_set1_ps(ray.direction.y);
+    __m128 dz = _mm_set1_ps(ray.direction.z);
+    __m128 a = _mm_set1_ps(ray_length2(ray));
+    __m128 tmin = _mm_set1_ps(t_min);
+    __m128 tmax = _mm_set1_ps(t_max);
+    __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 zero = _mm_setzero_ps();
+    __m128i lanes = _mm_set_epi32(3, 2, 1, 0);
+    __m128i limit = _mm_set1_epi32(end);
+
+    for (int i = begin; i < end; i += 4) {
+        __m128i index = _mm_add_epi32(_mm_set1_epi32(i), lanes);
+        __m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(soa->center_x + i));
+        __m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(soa->center_y + i));
+        __m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(soa->center_z + i));
+
+        __m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)),
+                              _mm_loadu_ps(soa->radius2 + i));
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+
+        __m128 sqrtd = _mm_sqrt_ps(discriminant);
+        __m128 neg_half_b = _mm_xor_ps(half_b, sign);
+        __m128 near = _mm_div_ps(_mm_sub_ps(neg_half_b, sqrtd), a);
+        __m128 far = _mm_div_ps(_mm_add_ps(neg_half_b, sqrtd), a);
+
+        __m128 near_ok = _mm_and_ps(_mm_cmpge_ps(near, tmin), _mm_cmple_ps(near, tmax));
+        __m128 far_ok = _mm_and_ps(_mm_cmpge_ps(far, tmin), _mm_cmple_ps(far, tmax));
+        __m128 ok = _mm_and_ps(_mm_cmpge_ps(discriminant, zero), _mm_or_ps(near_ok, far_ok));
+        ok = _mm_and_ps(ok, _mm_castsi128_ps(_mm_cmplt_epi32(index, limit)));
+        if (_mm_movemask_ps(ok)) return 1;
+    }
+    return 0;
+}
+
+#else
+
+int sphere_soa_hit_closest(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max, float* t) {
+    return sphere_soa_hit_closest_scalar(soa, begin, end, ray, t_min, t_max, t);
+}
+
+int sphere_soa_occluded(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max) {
+    return sphere_soa_occluded_scalar(soa, begin, end, ray, t_min, t_max);
+}
+
+#endif
+
 SphereList* sphere_list_create(int capacity) {
     SphereList* list = (SphereList*)malloc(sizeof(SphereList));
     list->spheres = (Sphere*)malloc(capacity * sizeof(Sphere));
     list->count = 0;
     list->capacity = capacity;
+    list->soa = NULL;
     return list;
 }
 
 void sphere_list_free(SphereList* list) {
     if (list) {
         free(list->spheres);
+        sphere_soa_free(list->soa);
         free(list);
     }
 }
@@ -65,20 +408,62 @@ void sphere_list_add(SphereList* list, Sphere sphere) {
         list->spheres = (Sphere*)realloc(list->spheres, list->capacity * sizeof(Sphere));
     }
     list->spheres[list->count++] = sphere;
+
+    if (list->soa) {
+        sphere_soa_add(list->soa, sphere);
+    }
+}
+
+void sphere_list_enable_soa(SphereList* list) {
+    if (list->soa) return;
+
+    list->soa = sphere_soa_create(list->capacity);
+    for (int i = 0; i < list->count; i++) {
+        sphere_soa_add(list->soa, list->spheres[i]);
+    }
 }
 
 int sphere_list_hit_any(SphereList* list, Ray ray, float t_min, float t_max, RayHit* hit) {
-    int was_hit = 0;
     float closest = t_max;
-    
+    int best = -1;
+
+    if (list->soa) {
+        best = sphere_soa_hit_closest(list->soa, 0, list->count, ray, t_min, t_max, &closest);
+    } else {
+        // Only track the distance here, the full hit is built once at the end
+        float a = ray_length2(ray);
+        for (int i = 0; i < list->count; i++) {
+            Sphere* s = &list->spheres[i];
+            float root;
+            if (sphere_intersect(s->center.x, s->center.y, s->center.z, s->radius * s->radius,
+                                 ray, a, t_min, closest, &root)) {
+                closest = root;
+                best = i;
+            }
+        }
+    }
+
+    if (best < 0) {
+        return 0;
+    }
+    sphere_hit_record(list->spheres[best], ray, closest, hit);
+    hit->object = best;
+    return 1;
+}
+
+int sphere_list_occluded(SphereList* list, Ray ray, float t_min, float t_max) {
+    if (list->soa) {
+        return sphere_soa_occluded(list->soa, 0, list->count, ray, t_min, t_max);
+    }
+
+    float a = ray_length2(ray);
     for (int i = 0; i < list->count; i++) {
-        RayHit temp_hit;
-        if (sphere_hit(list->spheres[i], ray, t_min, closest, &temp_hit)) {
-            was_hit = 1;
-            closest = temp_hit.t;
-            *hit = temp_hit;
+        Sphere* s = &list->spheres[i];
+        float root;
+        if (sphere_intersect(s->center.x, s->center.y, s->center.z, s->radius * s->radius,
+                             ray, a, t_min, t_max, &root)) {
+            return 1;
         }
     }
-    
-    return was_hit;
+    return 0;
 }
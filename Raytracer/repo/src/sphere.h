@@ -3,24 +3,71 @@
 
 #include "ray.h"
 
+// Spheres tested per SIMD instruction (8 with AVX2, 4 with SSE2, 1 otherwise)
+#if defined(__AVX2__)
+#define SPHERE_SIMD_WIDTH 8
+#elif defined(__SSE2__)
+#define SPHERE_SIMD_WIDTH 4
+#else
+#define SPHERE_SIMD_WIDTH 1
+#endif
+
 typedef struct {
     Vec3 center;
     float radius;
     int material_id;
 } Sphere;
 
+// Structure-of-arrays sphere storage for the SIMD intersection kernel.
+// Arrays always have SPHERE_SOA_PADDING spare entries past count so the
+// kernel can load full vectors from any start index.
+#define SPHERE_SOA_PADDING 8
+
+typedef struct {
+    float* center_x;
+    float* center_y;
+    float* center_z;
+    float* radius2;
+    int* material_id;
+    int count;
+    int capacity;
+} SphereSoA;
+
 typedef struct {
     Sphere* spheres;
     int count;
     int capacity;
+    SphereSoA* soa;  // Optional SoA mirror of spheres, see sphere_list_enable_soa
 } SphereList;
 
 Sphere sphere_create(Vec3 center, float radius, int material_id);
 int sphere_hit(Sphere sphere, Ray ray, float t_min, float t_max, RayHit* hit);
 
+// Fill point, normal and material of hit for a known hit distance t
+void sphere_hit_record(Sphere sphere, Ray ray, float t, RayHit* hit);
+
+SphereSoA* sphere_soa_create(int capacity);
+void sphere_soa_free(SphereSoA* soa);
+void sphere_soa_add(SphereSoA* soa, Sphere sphere);
+void sphere_soa_set(SphereSoA* soa, int index, Sphere sphere);
+Sphere sphere_soa_get(const SphereSoA* soa, int index);
+
+// Closest sphere in [begin, end) hit within [t_min, t_max]. Only the distance
+// is computed: returns the sphere index and writes *t, or returns -1.
+// On equal distances the highest index wins, matching the sequential loop.
+int sphere_soa_hit_closest(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max, float* t);
+int sphere_soa_hit_closest_scalar(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max, float* t);
+
+// 1 if any sphere in [begin, end) is hit within [t_min, t_max]. Stops at the
+// first one found rather than looking for the closest, for shadow rays.
+int sphere_soa_occluded(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max);
+int sphere_soa_occluded_scalar(const SphereSoA* soa, int begin, int end, Ray ray, float t_min, float t_max);
+
 SphereList* sphere_list_create(int capacity);
 void sphere_list_free(SphereList* list);
 void sphere_list_add(SphereList* list, Sphere sphere);
+void sphere_list_enable_soa(SphereList* list);
 int sphere_list_hit_any(SphereList* list, Ray ray, float t_min, float t_max, RayHit* hit);
+int sphere_list_occluded(SphereList* list, Ray ray, float t_min, float t_max);
 
 #endif
@@ -0,0 +1,229 @@
+#include "temporal.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+TemporalBuffer* temporal_create(int width, int height) {
+    size_t n = (size_t)width * height;
+    TemporalBuffer* temporal = (TemporalBuffer*)malloc(sizeof(TemporalBuffer));
+    temporal->width = width;
+    temporal->height = height;
+    temporal->hits = (RayHit*)calloc(n, sizeof(RayHit));
+    temporal->color = (Color*)calloc(n, sizeof(Color));
+    temporal->motion = (float*)calloc(n * 2, sizeof(float));
+    temporal->static_hits = (RayHit*)calloc(n, sizeof(RayHit));
+    temporal->previous_hits = (RayHit*)calloc(n, sizeof(RayHit));
+    temporal->history = (Color*)calloc(n, sizeof(Color));
+    temporal->history_length = (float*)calloc(n, sizeof(float));
+    temporal->dynamic = NULL;
+    temporal->dynamic_capacity = 0;
+    temporal->next_history = (Color*)malloc(n * sizeof(Color));
+    temporal->next_length = (float*)malloc(n * sizeof(float));
+    temporal->row_min = (Color*)malloc(n * sizeof(Color));
+    temporal->row_max = (Color*)malloc(n * sizeof(Color));
+    temporal_reset(temporal);
+    return temporal;
+}
+
+void temporal_free(TemporalBuffer* temporal) {
+    if (temporal) {
+        free(temporal->hits);
+        free(temporal->color);
+        free(temporal->motion);
+        free(temporal->static_hits);
+        free(temporal->previous_hits);
+        free(temporal->history);
+        free(temporal->history_length);
+        free(temporal->dynamic);
+        free(temporal->next_history);
+        free(temporal->next_length);
+        free(temporal->row_min);
+        free(temporal->row_max);
+        free(temporal);
+    }
+}
+
+void temporal_reset(TemporalBuffer* temporal) {
+    temporal->static_revision = -1;
+    temporal->dynamic_count = 0;
+    temporal->frame = 0;
+    temporal->reused = 0;
+}
+
+int temporal_static_valid(TemporalBuffer* temporal, Scene* scene, Camera* camera) {
+    return temporal->frame > 0 && temporal->static_revision == scene->revision &&
+           memcmp(&temporal->camera, camera, sizeof(Camera)) == 0;
+}
+
+// Where the hit's surface was last frame; 0 if it did not exist then
+static int previous_point(TemporalBuffer* temporal, Scene* scene, const RayHit* hit, Vec3* point) {
+    *point = hit->point;
+    if (hit->object < SCENE_DYNAMIC_OBJECT) return 1;
+    
+    // Dynamic spheres only ever move, so the surface moved with the centre
+    int handle = hit->object - SCENE_DYNAMIC_OBJECT;
+    if (handle >= temporal->dynamic_count || temporal->dynamic[handle].radius == 0.0f) return 0;
+    Vec3 moved = vec3_sub(scene->dynamic->spheres[handle].center, temporal->dynamic[handle].center);
+    *point = vec3_sub(hit->point, moved);
+    return 1;
+}
+
+// The last frame's hit at pixel is the surface this frame's hit expects there
+static int same_surface(const RayHit* previous, const RayHit* hit, float depth) {
+    float cosine = previous->normal.x * hit->normal.x + previous->normal.y * hit->normal.y +
+                   previous->normal.z * hit->normal.z;
+    return previous->hit && previous->object == hit->object && cosine >= TEMPORAL_NORMAL_TOLERANCE &&
+           fabsf(previous->t - depth) <= depth * TEMPORAL_DEPTH_TOLERANCE;
+}
+
+// Bilinear fetch of the history at (px, py), from the taps showing the same
+// surface only. Returns the weight found, 0 for a disocclusion.
+static float fetch_history(TemporalBuffer* temporal, const RayHit* hit, float depth, float px, float py,
+                           Color* color, float* length) {
+    int x0 = (int)floorf(px);
+    int y0 = (int)floorf(py);
+    float fx = px - x0;
+    float fy = py - y0;
+    float weight = 0.0f;
+    Color sum = {0.0f, 0.0f, 0.0f};
+    float length_sum = 0.0f;
+    
+    for (int tap = 0; tap < 4; tap++) {
+        int x = x0 + (tap & 1);
+        int y = y0 + (tap >> 1);
+        float w = ((tap & 1) ? fx : 1.0f - fx) * ((tap >> 1) ? fy : 1.0f - fy);
+        if (w <= 0.0f || x < 0 || y < 0 || x >= temporal->width || y >= temporal->height) continue;
+        
+        int j = y * temporal->width + x;
+        if (temporal->history_length[j] <= 0.0f) continue;
+        if (!same_surface(&temporal->previous_hits[j], hit, depth)) continue;
+        sum.r += temporal->history[j].r * w;
+        sum.g += temporal->history[j].g * w;
+        sum.b += temporal->history[j].b * w;
+        length_sum += temporal->history_length[j] * w;
+        weight += w;
+    }
+    
+    // A sliver of a tap is too little to build on
+    if (weight < 0.01f) return 0.0f;
+    float scale = 1.0f / weight;
+    *color = (Color){sum.r * scale, sum.g * scale, sum.b * scale};
+    *length = length_sum * scale;
+    return weight;
+}
+
+// Plain compares rather than fminf/fmaxf, which are library calls at -O2
+static inline float min_f(float a, float b) { return a < b ? a : b; }
+static inline float max_f(float a, float b) { return a > b ? a : b; }
+
+// The 3x3 box of this frame's colours around each pixel is found in two
+// passes: row_min/row_max over each row's three pixels here, then over three
+// rows of those when clamping
+static void row_boxes(TemporalBuffer* temporal) {
+    int width = temporal->width;
+    for (int y = 0; y < temporal->height; y++) {
+        const Color* row = &temporal->color[y * width];
+        Color* lo = &temporal->row_min[y * width];
+        Color* hi = &temporal->row_max[y * width];
+        for (int x = 0; x < width; x++) {
+            Color a = row[x > 0 ? x - 1 : x];
+            Color b = row[x];
+            Color c = row[x < width - 1 ? x + 1 : x];
+            lo[x] = (Color){min_f(min_f(a.r, b.r), c.r), min_f(min_f(a.g, b.g), c.g), min_f(min_f(a.b, b.b), c.b)};
+            hi[x] = (Color){max_f(max_f(a.r, b.r), c.r), max_f(max_f(a.g, b.g), c.g), max_f(max_f(a.b, b.b), c.b)};
+        }
+    }
+}
+
+// Clamp c into the box of this frame's colours around pixel i on row y
+static Color clamp_to_neighbourhood(TemporalBuffer* temporal, int i, int y, Color c) {
+    int up = y > 0 ? i - temporal->width : i;
+    int down = y < temporal->height - 1 ? i + temporal->width : i;
+    const Color* lo = temporal->row_min;
+    const Color* hi = temporal->row_max;
+    Color box_lo = {min_f(min_f(lo[up].r, lo[i].r), lo[down].r), min_f(min_f(lo[up].g, lo[i].g), lo[down].g),
+                    min_f(min_f(lo[up].b, lo[i].b), lo[down].b)};
+    Color box_hi = {max_f(max_f(hi[up].r, hi[i].r), hi[down].r), max_f(max_f(hi[up].g, hi[i].g), hi[down].g),
+                    max_f(max_f(hi[up].b, hi[i].b), hi[down].b)};
+    return (Color){min_f(max_f(c.r, box_lo.r), box_hi.r), min_f(max_f(c.g, box_lo.g), box_hi.g),
+                   min_f(max_f(c.b, box_lo.b), box_hi.b)};
+}
+
+static void keep_dynamic(TemporalBuffer* temporal, Scene* scene) {
+    int count = scene->dynamic->count;
+    if (count > temporal->dynamic_capacity) {
+        temporal->dynamic_capacity = count * 2;
+        temporal->dynamic = (Sphere*)realloc(temporal->dynamic, temporal->dynamic_capacity * sizeof(Sphere));
+    }
+    memcpy(temporal->dynamic, scene->dynamic->spheres, count * sizeof(Sphere));
+    temporal->dynamic_count = count;
+}
+
+void temporal_begin_frame(TemporalBuffer* temporal) {
+    RayHit* swap = temporal->previous_hits;
+    temporal->previous_hits = temporal->hits;
+    temporal->hits = swap;
+}
+
+void temporal_resolve(TemporalBuffer* temporal, Scene* scene, Camera* camera, Image* image) {
+    int width = temporal->width;
+    int height = temporal->height;
+    int reused = 0;
+    CameraProjection previous = camera_projection(&temporal->camera);
+    row_boxes(temporal);
+    
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int i = y * width + x;
+            const RayHit* hit = &temporal->hits[i];
+            Color current = temporal->color[i];
+            Color history = current;
+            float length = 0.0f;
+            float* motion = &temporal->motion[i * 2];
+            motion[0] = 0.0f;
+            motion[1] = 0.0f;
+            
+            Vec3 point;
+            float u, v;
+            if (hit->hit && temporal->frame > 0 && previous_point(temporal, scene, hit, &point) &&
+                camera_project(&previous, point, &u, &v)) {
+                float px = u * width - 0.5f;
+                float py = (1.0f - v) * height - 0.5f;
+                motion[0] = px - x;
+                motion[1] = py - y;
+                float dx = point.x - previous.origin.x;
+                float dy = point.y - previous.origin.y;
+                float dz = point.z - previous.origin.z;
+                float depth = sqrtf(dx * dx + dy * dy + dz * dz);
+                if (fetch_history(temporal, hit, depth, px, py, &history, &length) <= 0.0f) length = 0.0f;
+            }
+            
+            Color out = current;
+            if (length > 0.0f) {
+                if (length > TEMPORAL_MAX_HISTORY - 1) length = TEMPORAL_MAX_HISTORY - 1;
+                history = clamp_to_neighbourhood(temporal, i, y, history);
+                float alpha = 1.0f / (length + 1.0f);
+                out.r = history.r + (current.r - history.r) * alpha;
+                out.g = history.g + (current.g - history.g) * alpha;
+                out.b = history.b + (current.b - history.b) * alpha;
+                reused++;
+            }
+            image->pixels[i] = out;
+            temporal->next_history[i] = out;
+            // Sky is exact at any spp and needs no history
+            temporal->next_length[i] = hit->hit ? length + 1.0f : 0.0f;
+        }
+    }
+    
+    // This frame becomes the history
+    Color* swap_color = temporal->history;
+    temporal->history = temporal->next_history;
+    temporal->next_history = swap_color;
+    float* swap_length = temporal->history_length;
+    temporal->history_length = temporal->next_length;
+    temporal->next_length = swap_length;
+    temporal->camera = *camera;
+    keep_dynamic(temporal, scene);
+    temporal->reused = reused;
+    temporal->frame++;
+}
@@ -0,0 +1,70 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include "raytracer.h"
+#include "camera.h"
+#include "image.h"
+
+// Temporal accumulation for real-time frames of only a sample or two per
+// pixel. Primary rays go through pixel centres and their first hits make a
+// G-buffer; each pixel's new colour is blended into its history, found by
+// reprojecting its first hit into the previous frame. History is clamped to
+// the colours around the pixel this frame so stale history cannot ghost,
+// and dropped where the surface found there is not the same one (a
+// disocclusion). While the camera stands still the static objects' first
+// hits are kept from frame to frame and only the dynamic objects are traced.
+
+#define TEMPORAL_MAX_HISTORY 16          // Frames a pixel's history averages at most
+#define TEMPORAL_DEPTH_TOLERANCE 0.05f   // Relative depth change still the same surface
+#define TEMPORAL_NORMAL_TOLERANCE 0.9f   // Smallest cosine between normals still the same surface
+
+typedef struct {
+    int width;
+    int height;
+    
+    // This frame, filled in by render_temporal and valid until the next one
+    RayHit* hits;          // First hit per pixel; t is its depth, hit == 0 is sky
+    Color* color;          // Traced colour
+    float* motion;         // Per pixel (dx, dy): its surface's offset in pixels to where it was last frame
+    
+    // The static objects' first hits, reused while the camera stands still
+    RayHit* static_hits;
+    int static_revision;   // Scene revision static_hits were traced at, -1 = none
+    
+    // Last frame
+    RayHit* previous_hits;
+    Color* history;
+    float* history_length; // Frames averaged into history, 0 = none
+    Camera camera;
+    Sphere* dynamic;       // The scene's dynamic objects as they were
+    int dynamic_count;
+    int dynamic_capacity;
+    int frame;             // Frames so far, 0 = no history at all
+    
+    // Scratch for temporal_resolve
+    Color* next_history;
+    float* next_length;
+    Color* row_min;        // Of each pixel's row neighbours' colours
+    Color* row_max;
+    
+    int reused;            // Pixels blended with history last frame
+} TemporalBuffer;
+
+TemporalBuffer* temporal_create(int width, int height);
+void temporal_free(TemporalBuffer* temporal);
+
+// Forget all history, e.g. on a cut
+void temporal_reset(TemporalBuffer* temporal);
+
+// 1 when the static first hits of the last frame hold for this camera
+int temporal_static_valid(TemporalBuffer* temporal, Scene* scene, Camera* camera);
+
+// Keep the last frame's hits as previous_hits before hits is traced again
+void temporal_begin_frame(TemporalBuffer* temporal);
+
+// Blend this frame's hits and colours with the history into image (same
+// size), then keep the result, the camera and the dynamic objects for the
+// next frame
+void temporal_resolve(TemporalBuffer* temporal, Scene* scene, Camera* camera, Image* image);
+
+#endif
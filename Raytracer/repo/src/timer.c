@@ -0,0 +1,23 @@
+#define _POSIX_C_SOURCE 200809L
+#include "timer.h"
+
+#ifdef _WIN32
+#include <windows.h>
+
+double timer_seconds() {
+    LARGE_INTEGER frequency, count;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+}
+
+#else
+#include <time.h>
+
+double timer_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
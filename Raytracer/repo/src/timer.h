@@ -0,0 +1,7 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+// Monotonic wall-clock time in seconds from an arbitrary origin
+double timer_seconds();
+
+#endif
@@ -0,0 +1,212 @@
+#include "wavefront.h"
+#include <stdlib.h>
+
+// Shading buckets: misses first, then one per MaterialType
+#define BUCKET_MISS 0
+#define BUCKET_COUNT (MAT_EMISSIVE + 2)
+
+PathQueue* path_queue_create(int capacity) {
+    if (capacity < 1) capacity = 1;
+
+    PathQueue* queue = (PathQueue*)malloc(sizeof(PathQueue));
+    queue->paths = (PathState*)malloc((size_t)capacity * sizeof(PathState));
+    queue->hits = (RayHit*)malloc((size_t)capacity * sizeof(RayHit));
+    queue->order = (int*)malloc((size_t)capacity * sizeof(int));
+    queue->count = 0;
+    queue->capacity = capacity;
+    queue->rays_traced = 0;
+    queue->paths_killed = 0;
+    return queue;
+}
+
+void path_queue_free(PathQueue* queue) {
+    if (queue) {
+        free(queue->paths);
+        free(queue->hits);
+        free(queue->order);
+        free(queue);
+    }
+}
+
+int path_queue_push(PathQueue* queue, Ray ray, int pixel, const Rng* rng) {
+    if (queue->count >= queue->capacity) {
+        return 0;
+    }
+    PathState* path = &queue->paths[queue->count++];
+    path->ray = ray;
+    path->throughput = (Color){1.0f, 1.0f, 1.0f};
+    path->pixel = pixel;
+    path->depth = 0;
+    path->rng = *rng;
+    path->bsdf_pdf = 0.0f;
+    return 1;
+}
+
+static void film_add(Color* film, PathState* path, Color c) {
+    Color* dst = &film[path->pixel];
+    dst->r += path->throughput.r * c.r;
+    dst->g += path->throughput.g * c.g;
+    dst->b += path->throughput.b * c.b;
+}
+
+static void shade_miss(Scene* scene, PathQueue* queue, const int* order, int n, Color* film) {
+    for (int k = 0; k < n; k++) {
+        PathState* path = &queue->paths[order[k]];
+        Color sky = sky_color(path->ray.direction);
+        film_add(film, path, (Color){sky.r * scene->sky_intensity, sky.g * scene->sky_intensity,
+                                     sky.b * scene->sky_intensity});
+        path->depth = -1;
+    }
+}
+
+static void shade_diffuse(Scene* scene, PathQueue* queue, const int* order, int n, int max_depth, Color* film) {
+    for (int k = 0; k < n; k++) {
+        PathState* path = &queue->paths[order[k]];
+        RayHit* hit = &queue->hits[order[k]];
+        Vec3 albedo = scene->materials[hit->material_id].albedo;
+        path->throughput.r *= albedo.x * DIFFUSE_ATTENUATION;
+        path->throughput.g *= albedo.y * DIFFUSE_ATTENUATION;
+        path->throughput.b *= albedo.z * DIFFUSE_ATTENUATION;
+
+        // Light sampled directly, the bounce carries on for the rest
+        film_add(film, path, scene_direct_light(scene, hit, path->depth + 1 < max_depth, &path->rng));
+
+        float u, v;
+        rng_sample_2d(&path->rng, &u, &v);
+        path->ray = (Ray){hit->point, vec3_cosine_direction(hit->normal, u, v)};
+        path->bsdf_pdf = scene->light_count > 0 ? diffuse_pdf(hit->normal, path->ray.direction) : 0.0f;
+        path->depth++;
+    }
+}
+
+static void shade_metal(Scene* scene, PathQueue* queue, const int* order, int n) {
+    for (int k = 0; k < n; k++) {
+        PathState* path = &queue->paths[order[k]];
+        RayHit* hit = &queue->hits[order[k]];
+        Material* mat = &scene->materials[hit->material_id];
+        Vec3 dir = path->ray.direction;
+
+        Vec3 reflected = vec3_sub(dir, vec3_mul(hit->normal, 2.0f * vec3_dot(dir, hit->normal)));
+        float u, v;
+        rng_sample_2d(&path->rng, &u, &v);
+        Vec3 fuzz = vec3_mul(vec3_in_unit_sphere(u, v, rng_float(&path->rng)), mat->roughness);
+        reflected = vec3_normalize(vec3_add(reflected, fuzz));
+
+        if (vec3_dot(reflected, hit->normal) > 0) {
+            path->ray = ray_create(hit->point, reflected);
+            path->throughput.r *= mat->albedo.x;
+            path->throughput.g *= mat->albedo.y;
+            path->throughput.b *= mat->albedo.z;
+            path->bsdf_pdf = 0.0f;
+            path->depth++;
+        } else {
+            // Absorbed
+            path->depth = -1;
+        }
+    }
+}
+
+static void shade_emissive(Scene* scene, PathQueue* queue, const int* order, int n, Color* film) {
+    for (int k = 0; k < n; k++) {
+        PathState* path = &queue->paths[order[k]];
+        RayHit* hit = &queue->hits[order[k]];
+        Vec3 emission = scene->materials[hit->material_id].emission;
+        float weight = path->bsdf_pdf > 0.0f
+                           ? mis_weight(path->bsdf_pdf, scene_light_pdf(scene, path->ray.origin, hit)) : 1.0f;
+        film_add(film, path, (Color){emission.x * weight, emission.y * weight, emission.z * weight});
+        path->depth = -1;
+    }
+}
+
+static void shade_fallback(PathQueue* queue, const int* order, int n, Color* film) {
+    // Same normal-colour stand-in trace_ray_shade uses for unsupported materials
+    for (int k = 0; k < n; k++) {
+        PathState* path = &queue->paths[order[k]];
+        Vec3 normal = queue->hits[order[k]].normal;
+        Color c = {(normal.x + 1.0f) / 2.0f, (normal.y + 1.0f) / 2.0f, (normal.z + 1.0f) / 2.0f};
+        film_add(film, path, c);
+        path->depth = -1;
+    }
+}
+
+// Drop finished paths and play Russian roulette with the deep ones. Survivors
+// are reweighted by 1/p so the estimate stays unbiased. Keeps path order, so
+// results do not depend on how the buckets were laid out.
+static void compact_paths(PathQueue* queue, int max_depth) {
+    int live = 0;
+    for (int i = 0; i < queue->count; i++) {
+        PathState path = queue->paths[i];
+        if (path.depth < 0 || path.depth >= max_depth) continue;
+
+        if (path.depth >= WAVEFRONT_ROULETTE_DEPTH) {
+            float p = fmaxf(path.throughput.r, fmaxf(path.throughput.g, path.throughput.b));
+            if (p < 1.0f) {
+                if (rng_float(&path.rng) >= p) {
+                    queue->paths_killed++;
+                    continue;
+                }
+                path.throughput.r /= p;
+                path.throughput.g /= p;
+                path.throughput.b /= p;
+            }
+        }
+        queue->paths[live++] = path;
+    }
+    queue->count = live;
+}
+
+void wavefront_trace(Scene* scene, PathQueue* queue, int max_depth, Color* film) {
+    if (max_depth <= 0) {
+        queue->count = 0;
+        return;
+    }
+
+    while (queue->count > 0) {
+        int n = queue->count;
+        int bucket_start[BUCKET_COUNT + 1] = {0};
+
+        // Intersect every live path and count bucket sizes
+        for (int i = 0; i < n; i++) {
+            RayHit* hit = &queue->hits[i];
+            hit->hit = 0;
+            scene_hit(scene, queue->paths[i].ray, 0.001f, 1e6f, hit);
+            int bucket = hit->hit ? 1 + (int)scene->materials[hit->material_id].type : BUCKET_MISS;
+            bucket_start[bucket + 1]++;
+        }
+        queue->rays_traced += n;
+
+        // Counting sort by bucket so each material is shaded in one tight loop
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        int fill[BUCKET_COUNT];
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            fill[b] = bucket_start[b];
+        }
+        for (int i = 0; i < n; i++) {
+            RayHit* hit = &queue->hits[i];
+            int bucket = hit->hit ? 1 + (int)scene->materials[hit->material_id].type : BUCKET_MISS;
+            queue->order[fill[bucket]++] = i;
+        }
+
+        for (int b = 0; b < BUCKET_COUNT; b++) {
+            const int* order = &queue->order[bucket_start[b]];
+            int count = bucket_start[b + 1] - bucket_start[b];
+            if (count == 0) continue;
+
+            if (b == BUCKET_MISS) {
+                shade_miss(scene, queue, order, count, film);
+            } else if (b == 1 + MAT_DIFFUSE) {
+                shade_diffuse(scene, queue, order, count, max_depth, film);
+            } else if (b == 1 + MAT_METAL) {
+                shade_metal(scene, queue, order, count);
+            } else if (b == 1 + MAT_EMISSIVE) {
+                shade_emissive(scene, queue, order, count, film);
+            } else {
+                shade_fallback(queue, order, count, film);
+            }
+        }
+
+        compact_paths(queue, max_depth);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "raytracer.h"
+
+// Paths that survive this many bounces are thinned out by Russian roulette
+#define WAVEFRONT_ROULETTE_DEPTH 3
+
+typedef struct {
+    Ray ray;
+    Color throughput;
+    int pixel;   // Index into the film the path adds its radiance to
+    int depth;   // Bounces taken so far, negative once the path is done
+    Rng rng;     // Owned by the path, so shading order does not change results
+    float bsdf_pdf;  // Of the diffuse bounce that made ray, 0 when no light sample competes
+} PathState;
+
+// Live paths of one wavefront plus per-pass scratch. Paths are traced a
+// bounce at a time: intersect everything, group by material, shade each
+// group in its own loop, then compact away the paths that died.
+typedef struct {
+    PathState* paths;
+    RayHit* hits;
+    int* order;  // Path indices grouped by shading bucket
+    int count;
+    int capacity;
+
+    // Totals since the queue was created
+    long long rays_traced;
+    long long paths_killed;  // By Russian roulette
+} PathQueue;
+
+PathQueue* path_queue_create(int capacity);
+void path_queue_free(PathQueue* queue);
+
+// Start a new path at pixel drawing from rng. Returns 0 when the queue is full.
+int path_queue_push(PathQueue* queue, Ray ray, int pixel, const Rng* rng);
+
+// Run every queued path to completion, adding its radiance into film. Paths
+// are cut off after max_depth hits, like trace_ray. Leaves the queue empty.
+void wavefront_trace(Scene* scene, PathQueue* queue, int max_depth, Color* film);
+
+#endif
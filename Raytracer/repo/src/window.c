@@ -1,3 +1,5 @@
+// Win32 window, used through the platform layer (platform_win32.c)
+#ifdef _WIN32
 #include "window.h"
 #include <stdlib.h>
 #include <string.h>
@@ -139,3 +141,5 @@ void window_clear(GameWindow* window, uint32_t color) {
         window->framebuffer[i] = color;
     }
 }
+
+#endif